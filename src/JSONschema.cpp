@@ -29,6 +29,11 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "JSONschema.h"
 #include "decodeJSON.h"
 #include <iostream>
+#include <math.h>
+#include <stdio.h>
+#ifndef _WIN32
+#include <pthread.h>
+#endif
 
 using namespace std;
 
@@ -75,18 +80,208 @@ namespace JSONSchema {
     return true;
   }
 
-  template<> std::string Array<bool>::encode(void *obj) {
-    std::string ret("[");
-    int i;
+  template<> bool Array<bool>::read(JSON::Reader *r, void *ret,
+				    JSON::ErrFunc *err, void *errData) {
+    std::vector<bool> *o=(std::vector<bool> *)ret;
+    JSON::Value::type type;
+    size_t i;
+    bool more;
+    bool b;
+    if (!r->startArray())
+      return false;
+    for (i=0; ; i++) {
+      if (!r->nextElement(&more))
+        return false;
+      if (!more)
+        break;
+      if (!r->peek(&type))
+        return false;
+      if (type!=JSON::Value::boolean) {
+        schemaerror(r->lineno(), err, errData);
+        return false;
+      }
+      if (!r->readBoolean(&b))
+        return false;
+      if (i>=o->size())
+        o->resize(i+1);
+      (*o)[i]=b;
+    }
+    o->resize(i);
+    return true;
+  }
+
+  template<> void Array<bool>::encode(void *obj, Writer &w) {
+    size_t i;
     std::vector<bool> *o=(std::vector<bool> *)obj;
+    w.put('[');
     for (i=0; i<o->size(); i++) {
       bool tmp=((*o)[i]);
-      ret+=encodeJSON(Bool, &tmp);
-      if (i<o->size()-1)
-        ret+=",";
+      if (i)
+        w.put(',');
+      encodeJSON(Bool, &tmp, w);
     }
-    ret+=std::string("]");
-    return ret;
+    w.put(']');
+  }
+
+  bool readNumbers(JSON::Reader *r, std::vector<double> *o,
+		   JSON::ErrFunc *err, void *errData) {
+    bool more;
+    if (!r->startArray())
+      return false;
+    o->clear();
+    if (!r->readNumbers(o, &more))
+      return false;
+    if (more) {
+      // An element that is not a number
+      checkType(r, JSON::Value::number, err, errData);
+      return false;
+    }
+    return true;
+  }
+
+  bool fillNumbers(JSON::Value *v, std::vector<double> *o,
+		   JSON::ErrFunc *err, void *errData) {
+    JSON::Array *a=(JSON::Array *)v;
+    size_t i;
+    o->resize(a->value.size());
+    for (i=0; i<a->value.size(); i++) {
+      if (a->value[i]->getType()!=JSON::Value::number) {
+        schemaerror(a->value[i], err, errData);
+        return false;
+      }
+      (*o)[i]=((JSON::Number *)a->value[i])->value;
+    }
+    return true;
+  }
+
+  template<> bool Array<double>::fill(JSON::Value *v, void *ret,
+				      JSON::ErrFunc *err, void *errData) {
+    JSON::Array *a=(JSON::Array *)v;
+    std::vector<double> *o=(std::vector<double> *)ret;
+    size_t i;
+    if (elementType()==Number)
+      return fillNumbers(v, o, err, errData);
+    o->resize(a->value.size());
+    for (i=0; i<a->value.size(); i++) {
+      if (!convertJSON(a->value[i], elementType(), &((*o)[i]),
+		       err, errData))
+        return false;
+    }
+    return true;
+  }
+
+  template<> bool Array<double>::read(JSON::Reader *r, void *ret,
+				      JSON::ErrFunc *err, void *errData) {
+    std::vector<double> *o=(std::vector<double> *)ret;
+    size_t i;
+    bool more;
+    if (elementType()==Number)
+      return readNumbers(r, o, err, errData);
+    if (!r->startArray())
+      return false;
+    for (i=0; ; i++) {
+      if (!r->nextElement(&more))
+        return false;
+      if (!more)
+        break;
+      if (i>=o->size())
+        o->resize(i+1);
+      if (!readJSON(r, elementType(), &((*o)[i]), err, errData))
+        return false;
+    }
+    o->resize(i);
+    return true;
+  }
+
+  template<> void Array<double>::encode(void *obj, Writer &w) {
+    size_t i;
+    std::vector<double> *o=(std::vector<double> *)obj;
+    char buf[32];
+    w.put('[');
+    for (i=0; i<o->size(); i++) {
+      if (i)
+        w.put(',');
+      // Numbers are formatted here rather than through the element type
+      if (elementType()==Number)
+        w.write(buf, JSON::formatNumber(buf, (*o)[i]));
+      else
+        encodeJSON(elementType(), &(*o)[i], w);
+    }
+    w.put(']');
+  }
+
+  template<> bool Array<bool>::unpack(Unpacker *u, void *ret,
+				      JSON::ErrFunc *err, void *errData) {
+    std::vector<bool> *o=(std::vector<bool> *)ret;
+    size_t i, n;
+    bool b;
+    if (!u->readArray(&n))
+      return false;
+    o->resize(n);
+    for (i=0; i<n; i++) {
+      if (!checkType(u, JSON::Value::boolean, err, errData) ||
+	  !u->readBoolean(&b))
+        return false;
+      (*o)[i]=b;
+    }
+    return true;
+  }
+
+  template<> void Array<bool>::pack(void *obj, Writer &w) {
+    size_t i;
+    std::vector<bool> *o=(std::vector<bool> *)obj;
+    packArray(w, o->size());
+    for (i=0; i<o->size(); i++)
+      packBoolean(w, (*o)[i]);
+  }
+
+  bool unpackNumbers(Unpacker *u, std::vector<double> *o,
+		     JSON::ErrFunc *err, void *errData) {
+    size_t i, n;
+    if (!u->readArray(&n))
+      return false;
+    o->resize(n);
+    for (i=0; i<n; i++) {
+      if (!checkType(u, JSON::Value::number, err, errData) ||
+	  !u->readNumber(&(*o)[i]))
+        return false;
+    }
+    return true;
+  }
+
+  void packNumbers(Writer &w, const std::vector<double> &o) {
+    size_t i;
+    packArray(w, o.size());
+    for (i=0; i<o.size(); i++)
+      packNumber(w, o[i]);
+  }
+
+  template<> bool Array<double>::unpack(Unpacker *u, void *ret,
+					JSON::ErrFunc *err, void *errData) {
+    std::vector<double> *o=(std::vector<double> *)ret;
+    size_t i, n;
+    if (elementType()==Number)
+      return unpackNumbers(u, o, err, errData);
+    if (!u->readArray(&n))
+      return false;
+    o->resize(n);
+    for (i=0; i<n; i++) {
+      if (!unpackJSON(u, elementType(), &(*o)[i], err, errData))
+        return false;
+    }
+    return true;
+  }
+
+  template<> void Array<double>::pack(void *obj, Writer &w) {
+    size_t i;
+    std::vector<double> *o=(std::vector<double> *)obj;
+    if (elementType()==Number) {
+      packNumbers(w, *o);
+      return;
+    }
+    packArray(w, o->size());
+    for (i=0; i<o->size(); i++)
+      elementType()->pack(&(*o)[i], w);
   }
 
   static void defaultError(void *dummy, string msg) {
@@ -95,33 +290,617 @@ namespace JSONSchema {
 
   void schemaerror(JSON::Value *v,
 		   JSON::ErrFunc *err, void *errData) {
+    schemaerror(v->lineno, err, errData);
+  }
+
+  void schemaerror(int lineno,
+		   JSON::ErrFunc *err, void *errData) {
     char buf[80];
-    sprintf(buf, "JSONSchema: Type error at line no %d", v->lineno);
+    sprintf(buf, "JSONSchema: Type error at line no %d", lineno);
+    if (!err)
+      err=defaultError;
     err(errData, buf);
   }
   
-  bool decodeJSON(std::string str, Type *t, void *ret,
-		  JSON::ErrFunc *err, void *errData) {
-    JSON::Value *v=JSON::decodeJSON(str);
-    if (!v)
-      return false;
-    bool ok=convertJSON(v, t, ret, err, errData);
-    delete v;
+  bool decodeJSON(const std::string &str, Type *t, void *ret,
+		  JSON::ErrFunc *err, void *errData, JSON::Stats *stats) {
+    return decodeJSON(str.data(), str.size(), t, ret, err, errData, stats);
+  }
+  
+  bool decodeJSON(const char *str, size_t len, Type *t, void *ret,
+		  JSON::ErrFunc *err, void *errData, JSON::Stats *stats) {
+    if (!JSON::Stats::enabled || !stats) {
+      JSON::Reader r(str, len, err, errData);
+      return readJSON(&r, t, ret, err, errData);
+    }
+    double start=JSON::Stats::clock();
+    bool ok;
+    {
+      JSON::Reader r(str, len, err, errData, 1, stats);
+      ok=readJSON(&r, t, ret, err, errData);
+    }
+    stats->convertTime+=JSON::Stats::clock()-start;
     return ok;
   }
   
+  bool decodeJSONInPlace(char *str, size_t len, Type *t, void *ret,
+			 JSON::ErrFunc *err, void *errData) {
+    // Reading straight into the target copies each string once
+    // anyway, so there is nothing to gain from decoding in place
+    return decodeJSON(str, len, t, ret, err, errData);
+  }
+  
   bool convertJSON(JSON::Value *v, Type *t, void *ret,
-		   JSON::ErrFunc *err, void *errData) {
+		   JSON::ErrFunc *err, void *errData, JSON::Stats *stats) {
     if (v->getType()!=t->getType()) {
       schemaerror(v, err, errData);
       return false;
     }
-    return t->fill(v, ret, err, errData);
+    if (!JSON::Stats::enabled || !stats)
+      return t->fill(v, ret, err, errData);
+    double start=JSON::Stats::clock();
+    bool ok=t->fill(v, ret, err, errData);
+    stats->convertTime+=JSON::Stats::clock()-start;
+    return ok;
+  }
+
+  bool decodeJSONFile(const std::string &path, Type *t, void *ret,
+		      JSON::ErrFunc *err, void *errData) {
+    JSON::MappedFile f;
+    if (!f.open(path, err, errData))
+      return false;
+    return decodeJSON(f.data, f.size, t, ret, err, errData);
+  }
+  
+  void decodeRecord(void *data, size_t index, JSON::Record *record) {
+    RecordTarget *target=(RecordTarget *)data;
+    JSON::Reader r(record->data, record->size, JSON::recordError, record,
+		   record->lineno);
+    if (readJSON(&r, target->t, target->base+index*target->stride,
+		 JSON::recordError, record))
+      r.end();
+  }
+  
+  void decodeElements(void *data, size_t index, JSON::Record *record) {
+    ElementTarget *target=(ElementTarget *)data;
+    JSON::Reader r(record->data, record->size, JSON::recordError, record,
+		   record->lineno);
+    size_t i=(*target->first)[index];
+    size_t e=(*target->first)[index+1];
+    bool more=true;
+    r.startElements();
+    for (; more && i<e; i++) {
+      if (!readJSON(&r, target->t, target->base+i*target->stride,
+		    JSON::recordError, record))
+        return;
+      if (!r.nextElement(&more))
+        return;
+    }
+    if (more || i!=e)
+      JSON::recordError(record, "JSONSchema: Element count mismatch");
+  }
+  
+  void reportError(const std::string &msg, JSON::ErrFunc *err, void *errData) {
+    if (!err)
+      err=defaultError;
+    err(errData, msg);
+  }
+  
+  bool readJSON(JSON::Reader *r, Type *t, void *ret,
+		JSON::ErrFunc *err, void *errData) {
+    JSON::Value::type type;
+    if (!r->peek(&type))
+      return false;
+    if (type!=t->getType()) {
+      schemaerror(r->lineno(), err, errData);
+      return false;
+    }
+    return t->read(r, ret, err, errData);
+  }
+
+#ifndef _WIN32
+  static pthread_mutex_t indexLock=PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+  bool MemberIndex::ready() const {
+#ifdef __GNUC__
+    return __atomic_load_n(&built, __ATOMIC_ACQUIRE);
+#else
+    return built;
+#endif
+  }
+
+  void MemberIndex::build(const std::vector<std::string> &anames) {
+#ifndef _WIN32
+    pthread_mutex_lock(&indexLock);
+#endif
+    if (!built) {
+      size_t size=1;
+      size_t i;
+      unsigned s;
+      while (size<2*anames.size())
+        size*=2;
+      for (s=0; ; s++) {
+        if (s==64) {
+          // Too crowded for a seed to be found quickly
+          s=0;
+          size*=2;
+        }
+        slots.assign(size, -1);
+        for (i=0; i<anames.size(); i++) {
+          int &slot=slots[hash(anames[i].data(), anames[i].size(), s)&(size-1)];
+          if (slot<0)
+            slot=(int)i;
+          else if (anames[slot]!=anames[i])
+            break;
+        }
+        if (i==anames.size())
+          break;
+      }
+      names=anames;
+      seed=s;
+      mask=(unsigned)size-1;
+#ifdef __GNUC__
+      __atomic_store_n(&built, 1, __ATOMIC_RELEASE);
+#else
+      built=1;
+#endif
+    }
+#ifndef _WIN32
+    pthread_mutex_unlock(&indexLock);
+#endif
+  }
+
+  bool checkType(JSON::Reader *r, JSON::Value::type type,
+		 JSON::ErrFunc *err, void *errData) {
+    JSON::Value::type t;
+    if (!r->peek(&t))
+      return false;
+    if (t!=type) {
+      schemaerror(r->lineno(), err, errData);
+      return false;
+    }
+    return true;
+  }
+
+  void Writer::writeString(const char *s, size_t n) {
+    static const char hex[]="0123456789abcdef";
+    const char *end=s+n;
+    const char *q;
+    char esc[6]={'\\', 'u', '0', '0'};
+    put('"');
+    for (;;) {
+      q=JSON::findEscape(s, end);
+      write(s, q-s);
+      if (q==end)
+        break;
+      esc[1]=*q;
+      switch (*q) {
+        case '"':
+        case '\\':
+          break;
+        case '\b':
+          esc[1]='b';
+          break;
+        case '\f':
+          esc[1]='f';
+          break;
+        case '\n':
+          esc[1]='n';
+          break;
+        case '\r':
+          esc[1]='r';
+          break;
+        case '\t':
+          esc[1]='t';
+          break;
+        default:
+          esc[1]='u';
+          esc[4]=hex[(unsigned char)*q>>4];
+          esc[5]=hex[*q&15];
+          write(esc, 6);
+          s=q+1;
+          continue;
+      }
+      write(esc, 2);
+      s=q+1;
+    }
+    put('"');
+  }
+
+  bool Type::read(JSON::Reader *r, void *ret,
+		  JSON::ErrFunc *err, void *errData) {
+    JSON::Document doc;
+    JSON::Value *v=r->readValue(&doc.arena);
+    return v && fill(v, ret, err, errData);
+  }
+
+  std::string Type::encode(void *obj) {
+    std::string ret;
+    Writer w(&ret);
+    encode(obj, w);
+    return ret;
+  }
+
+  void Type::encode(void *obj, Writer &w) {
+    w.write(encode(obj));
+  }
+
+  bool Type::unpack(Unpacker *u, void *,
+		    JSON::ErrFunc *err, void *errData) {
+    typeerror(u->offset(), err, errData);
+    return false;
+  }
+
+  void Type::pack(void *, Writer &w) {
+    reportError("JSONSchema: Type cannot be packed as MessagePack", NULL, NULL);
+    packNull(w);
   }
 
   std::string encodeJSON(Type *t, void *obj) {
     return t->encode(obj);
   }
 
+  void encodeJSON(Type *t, void *obj, Writer &w) {
+    t->encode(obj, w);
+  }
+
+  void encodeJSON(Type *t, void *obj, std::string *out) {
+    Writer w(out);
+    t->encode(obj, w);
+  }
+
+  size_t encodeJSON(Type *t, void *obj, char *buf, size_t size) {
+    Writer w(buf, size);
+    t->encode(obj, w);
+    if (size)
+      buf[w.length()<size ? w.length() : size-1]=0;
+    return w.length();
+  }
+
+  /*
+    MessagePack
+  */
+
+  // Writes tag and the low width bytes of v, most significant first
+  static void packTag(Writer &w, unsigned char tag, unsigned long long v,
+		      int width) {
+    char buf[9];
+    int i;
+    buf[0]=tag;
+    for (i=width; i>0; i--) {
+      buf[i]=(char)(v&0xff);
+      v>>=8;
+    }
+    w.write(buf, width+1);
+  }
+
+  // Writes the header of an array, map or string of n items, in the
+  // one-byte form if n fits in bits bits, with 16 bits or else 32
+  static void packHeader(Writer &w, unsigned char fix, int bits,
+			 unsigned char c16, unsigned char c32, size_t n) {
+    if (n<((size_t)1<<bits))
+      w.put(fix|n);
+    else if (n<=0xffff)
+      packTag(w, c16, n, 2);
+    else
+      packTag(w, c32, n, 4);
+  }
+
+  void packArray(Writer &w, size_t n) {
+    packHeader(w, 0x90, 4, 0xdc, 0xdd, n);
+  }
+
+  void packMap(Writer &w, size_t n) {
+    packHeader(w, 0x80, 4, 0xde, 0xdf, n);
+  }
+
+  void packString(Writer &w, const char *s, size_t n) {
+    if (n>=32 && n<=0xff)
+      packTag(w, 0xd9, n, 1);
+    else
+      packHeader(w, 0xa0, 5, 0xda, 0xdb, n);
+    w.write(s, n);
+  }
+
+  void packNumber(Writer &w, double d) {
+    // A number that is an integer is packed as the smallest integer
+    // that holds it, except -0, which only a float tells from 0
+    if (d>=-9007199254740992.0 && d<=9007199254740992.0 &&
+	d==(double)(long long)d && (d!=0 || !signbit(d))) {
+      long long i=(long long)d;
+      if (i>=0) {
+        if (i<0x80)
+          w.put((char)i);
+        else if (i<=0xff)
+          packTag(w, 0xcc, i, 1);
+        else if (i<=0xffff)
+          packTag(w, 0xcd, i, 2);
+        else if (i<=0xffffffffLL)
+          packTag(w, 0xce, i, 4);
+        else
+          packTag(w, 0xcf, i, 8);
+      } else {
+        if (i>=-32)
+          w.put((char)i);
+        else if (i>=-0x80)
+          packTag(w, 0xd0, i, 1);
+        else if (i>=-0x8000)
+          packTag(w, 0xd1, i, 2);
+        else if (i>=-0x80000000LL)
+          packTag(w, 0xd2, i, 4);
+        else
+          packTag(w, 0xd3, i, 8);
+      }
+      return;
+    }
+    float f=(float)d;
+    if (f==d || d!=d) {
+      unsigned b;
+      memcpy(&b, &f, 4);
+      packTag(w, 0xca, b, 4);
+    } else {
+      unsigned long long b;
+      memcpy(&b, &d, 8);
+      packTag(w, 0xcb, b, 8);
+    }
+  }
+
+  Unpacker::Unpacker(const char *data, size_t size,
+		     JSON::ErrFunc *aerr, void *aerrData):
+  start((const unsigned char *)data), p(start), end(start+size),
+  err(aerr), errData(aerrData) {}
+
+  // The width bytes at p, most significant first
+  static unsigned long long bigEndian(const unsigned char *p, size_t width) {
+    unsigned long long v=0;
+    size_t i;
+    for (i=0; i<width; i++)
+      v=v<<8|p[i];
+    return v;
+  }
+
+  bool Unpacker::error() {
+    char buf[80];
+    sprintf(buf, "JSONSchema: MessagePack error at offset %lu",
+	    (unsigned long)offset());
+    reportError(buf, err, errData);
+    return false;
+  }
+
+  bool Unpacker::peek(JSON::Value::type *type) {
+    if (p>=end)
+      return error();
+    unsigned char c=*p;
+    if (c<0x80 || c>=0xe0 || (c>=0xca && c<=0xd3))
+      *type=JSON::Value::number;
+    else if (c<0x90 || c==0xde || c==0xdf)
+      *type=JSON::Value::object;
+    else if (c<0xa0 || c==0xdc || c==0xdd)
+      *type=JSON::Value::array;
+    else if (c<0xc0 || (c>=0xc4 && c<=0xc6) || (c>=0xd9 && c<=0xdb))
+      *type=JSON::Value::string;
+    else if (c==0xc0)
+      *type=JSON::Value::null;
+    else if (c==0xc2 || c==0xc3)
+      *type=JSON::Value::boolean;
+    else
+      return error(); // An extension type, or unused
+    return true;
+  }
+
+  bool Unpacker::readNumber(double *d) {
+    if (p>=end)
+      return error();
+    unsigned char c=*p;
+    size_t width;
+    if (c<0x80) {
+      *d=c;
+      p++;
+      return true;
+    }
+    if (c>=0xe0) {
+      *d=(signed char)c;
+      p++;
+      return true;
+    }
+    switch (c) {
+    case 0xcc: case 0xd0:
+      width=1;
+      break;
+    case 0xcd: case 0xd1:
+      width=2;
+      break;
+    case 0xca: case 0xce: case 0xd2:
+      width=4;
+      break;
+    case 0xcb: case 0xcf: case 0xd3:
+      width=8;
+      break;
+    default:
+      return error();
+    }
+    if ((size_t)(end-p)<=width)
+      return error();
+    unsigned long long v=bigEndian(p+1, width);
+    p+=1+width;
+    switch (c) {
+    case 0xca: {
+      unsigned b=(unsigned)v;
+      float f;
+      memcpy(&f, &b, 4);
+      *d=f;
+      break;
+    }
+    case 0xcb:
+      memcpy(d, &v, 8);
+      break;
+    case 0xd0:
+      *d=(signed char)v;
+      break;
+    case 0xd1:
+      *d=(short)v;
+      break;
+    case 0xd2:
+      *d=(int)v;
+      break;
+    case 0xd3:
+      *d=(double)(long long)v;
+      break;
+    default:
+      *d=(double)v;
+    }
+    return true;
+  }
+
+  bool Unpacker::readString(JSON::Str *s) {
+    if (p>=end)
+      return error();
+    unsigned char c=*p;
+    size_t width, n;
+    if (c>=0xa0 && c<0xc0)
+      width=0;
+    else if (c==0xd9 || c==0xc4)
+      width=1;
+    else if (c==0xda || c==0xc5)
+      width=2;
+    else if (c==0xdb || c==0xc6)
+      width=4;
+    else
+      return error();
+    if ((size_t)(end-p)<=width)
+      return error();
+    n=width ? bigEndian(p+1, width) : c&0x1f;
+    if (n>(size_t)(end-p)-1-width)
+      return error();
+    *s=JSON::Str((const char *)p+1+width, n);
+    p+=1+width+n;
+    return true;
+  }
+
+  bool Unpacker::readBoolean(bool *b) {
+    if (p>=end || (*p!=0xc2 && *p!=0xc3))
+      return error();
+    *b=*p++==0xc3;
+    return true;
+  }
+
+  // Reads the header of an array or a map, whose items must each have
+  // at least a byte left for them
+  bool Unpacker::header(size_t *n, unsigned char fix, unsigned char c16,
+			unsigned char c32, size_t items) {
+    if (p>=end)
+      return error();
+    unsigned char c=*p;
+    size_t width;
+    if ((c&0xf0)==fix)
+      width=0;
+    else if (c==c16)
+      width=2;
+    else if (c==c32)
+      width=4;
+    else
+      return error();
+    if ((size_t)(end-p)<=width)
+      return error();
+    *n=width ? bigEndian(p+1, width) : c&0x0f;
+    if (*n>((size_t)(end-p)-1-width)/items)
+      return error();
+    p+=1+width;
+    return true;
+  }
+
+  bool Unpacker::readArray(size_t *n) {
+    return header(n, 0x90, 0xdc, 0xdd, 1);
+  }
+
+  bool Unpacker::readMap(size_t *n) {
+    return header(n, 0x80, 0xde, 0xdf, 2);
+  }
+
+  bool Unpacker::skip() {
+    // The values still to skip, counting those in containers
+    size_t pending=1, n;
+    JSON::Value::type type;
+    JSON::Str s;
+    double d;
+    bool b;
+    while (pending) {
+      if (!peek(&type))
+        return false;
+      pending--;
+      switch (type) {
+      case JSON::Value::number:
+        if (!readNumber(&d))
+          return false;
+        break;
+      case JSON::Value::string:
+        if (!readString(&s))
+          return false;
+        break;
+      case JSON::Value::boolean:
+        if (!readBoolean(&b))
+          return false;
+        break;
+      case JSON::Value::null:
+        p++;
+        break;
+      case JSON::Value::array:
+        if (!readArray(&n))
+          return false;
+        pending+=n;
+        break;
+      case JSON::Value::object:
+        if (!readMap(&n))
+          return false;
+        pending+=2*n;
+        break;
+      }
+    }
+    return true;
+  }
+
+  void typeerror(size_t offset, JSON::ErrFunc *err, void *errData) {
+    char buf[80];
+    sprintf(buf, "JSONSchema: Type error at offset %lu",
+	    (unsigned long)offset);
+    reportError(buf, err, errData);
+  }
+
+  bool checkType(Unpacker *u, JSON::Value::type type,
+		 JSON::ErrFunc *err, void *errData) {
+    JSON::Value::type t;
+    if (!u->peek(&t))
+      return false;
+    if (t!=type) {
+      typeerror(u->offset(), err, errData);
+      return false;
+    }
+    return true;
+  }
+
+  bool unpackJSON(Unpacker *u, Type *t, void *ret,
+		  JSON::ErrFunc *err, void *errData) {
+    return checkType(u, t->getType(), err, errData) &&
+      t->unpack(u, ret, err, errData);
+  }
+
+  std::string encodeMsgPack(Type *t, void *obj) {
+    std::string ret;
+    Writer w(&ret);
+    t->pack(obj, w);
+    return ret;
+  }
+
+  void encodeMsgPack(Type *t, void *obj, Writer &w) {
+    t->pack(obj, w);
+  }
+
+  bool decodeMsgPack(const char *data, size_t size, Type *t, void *ret,
+		     JSON::ErrFunc *err, void *errData) {
+    Unpacker u(data, size, err, errData);
+    return unpackJSON(&u, t, ret, err, errData);
+  }
+
   
 }
@@ -30,14 +30,22 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define __offcourse__JSONschema__
 
 #include <vector>
+#include <map>
 #include <string>
 #include <iostream>
+#include <string.h>
+#include <limits.h>
+#if __cplusplus>=201103L
+#include <array>
+#endif
 
 #include "decodeJSON.h"
 
 namespace JSONSchema {
   void schemaerror(JSON::Value *v,
 		   JSON::ErrFunc *err, void *errData);
+  void schemaerror(int lineno,
+		   JSON::ErrFunc *err, void *errData);
   class Type;
 
   /**
@@ -45,6 +53,8 @@ namespace JSONSchema {
      
      @t The type of the object, given as a Type object.
      @obj A pointer to the object
+     @stats If not NULL, what is read is added to it. The data are
+     read and converted in one pass, which counts as convertTime.
 
      @return true if the conversion was successful, false otherwise.
 
@@ -52,8 +62,78 @@ namespace JSONSchema {
 
    */
 
-  bool decodeJSON(std::string str, Type *t, void *ret,
-		  JSON::ErrFunc *err=NULL, void *errData=NULL);
+  bool decodeJSON(const std::string &str, Type *t, void *ret,
+		  JSON::ErrFunc *err=NULL, void *errData=NULL,
+		  JSON::Stats *stats=NULL);
+
+  /**
+     Like decodeJSON(const std::string &, ...), but reads len bytes of
+     JSON data at str in place. The buffer need not be NUL-terminated.
+   */
+
+  bool decodeJSON(const char *str, size_t len, Type *t, void *ret,
+		  JSON::ErrFunc *err=NULL, void *errData=NULL,
+		  JSON::Stats *stats=NULL);
+
+  /**
+     Like decodeJSON(const char *, size_t, ...), but escape sequences
+     in strings are decoded in place. The contents of the buffer are
+     undefined afterwards.
+   */
+
+  bool decodeJSONInPlace(char *str, size_t len, Type *t, void *ret,
+			 JSON::ErrFunc *err=NULL, void *errData=NULL);
+
+  /**
+     Like decodeJSON(const char *, size_t, ...), but reads the JSON
+     data from a file, which is mapped into memory rather than copied.
+   */
+
+  bool decodeJSONFile(const std::string &path, Type *t, void *ret,
+		      JSON::ErrFunc *err=NULL, void *errData=NULL);
+
+  /**
+     Where decodeJSONLines puts the records, as an array of objects of
+     the given size.
+   */
+
+  struct RecordTarget {
+    Type *t;
+    char *base;
+    size_t stride;
+  };
+
+  void decodeRecord(void *target, size_t index, JSON::Record *record);
+
+  /**
+     Decodes newline-delimited JSON, one value of type t per line, into
+     ret, with the records spread over a number of threads. The errors
+     are returned per record, as for JSON::decodeJSONLines.
+
+     @threads The number of threads to use, or 0 for one per processor
+     @return true if every record was decoded
+   */
+
+  template<class T> bool decodeJSONLines(const char *str, size_t len, Type *t,
+					 std::vector<T> *ret,
+					 std::vector<JSON::Record> *records,
+					 int threads=0) {
+    JSON::splitLines(str, len, records);
+    ret->clear();
+    ret->resize(records->size());
+    if (ret->empty())
+      return true;
+    RecordTarget target;
+    target.t=t;
+    target.base=(char *)&(*ret)[0];
+    target.stride=sizeof(T);
+    JSON::forEachRecord(records, decodeRecord, &target, threads);
+    size_t i;
+    for (i=0; i<records->size(); i++)
+      if (!(*records)[i].error.empty())
+        return false;
+    return true;
+  }
 
   /**
      Converts a C++ object with JSON hooks into a string.
@@ -68,8 +148,296 @@ namespace JSONSchema {
 
   std::string encodeJSON(Type *t, void *obj);
 
+  class Writer;
+
+  /**
+     Like encodeJSON(Type *, void *), but appends the JSON string to w.
+   */
+
+  void encodeJSON(Type *t, void *obj, Writer &w);
+
+  /**
+     Like encodeJSON(Type *, void *), but appends the JSON string to
+     *out. A string that is reused keeps its storage, so encoding into
+     it again does not allocate once it is large enough.
+   */
+
+  void encodeJSON(Type *t, void *obj, std::string *out);
+
+  /**
+     Like encodeJSON(Type *, void *), but writes the JSON string into
+     size bytes at buf, NUL-terminated and truncated to fit, as
+     snprintf does.
+
+     @return The length of the JSON string. If it is size or more, the
+     string was truncated.
+   */
+
+  size_t encodeJSON(Type *t, void *obj, char *buf, size_t size);
+
+  /**
+     Converts a JSON::Value into a C++ object with JSON hooks.
+
+     @stats If not NULL, the time taken is added to its convertTime
+   */
+
   bool convertJSON(JSON::Value *v, Type *t, void *ret,
-		   JSON::ErrFunc *err, void *errData);
+		   JSON::ErrFunc *err, void *errData,
+		   JSON::Stats *stats=NULL);
+
+  /**
+     Like convertJSON, but reads the value straight from r, without a
+     JSON::Value tree being built.
+   */
+
+  bool readJSON(JSON::Reader *r, Type *t, void *ret,
+		JSON::ErrFunc *err, void *errData);
+
+  /**
+     The output of an encoder: a string that it appends to, or an
+     array of fixed size that it fills.
+   */
+
+  class Writer {
+  public:
+    /**
+       Writes into a buffer of the writer's own, which keeps its
+       storage when cleared.
+     */
+
+    Writer():
+    str(&own), buf(NULL), size(0), len(0) {}
+
+    /**
+       Appends to *out.
+     */
+
+    Writer(std::string *out):
+    str(out), buf(NULL), size(0), len(0) {}
+
+    /**
+       Writes into asize bytes at abuf. What does not fit is counted
+       but not written.
+     */
+
+    Writer(char *abuf, size_t asize):
+    str(NULL), buf(abuf), size(asize), len(0) {}
+
+    void put(char c) {
+      if (str)
+        str->push_back(c);
+      else if (len++<size)
+        buf[len-1]=c;
+    }
+
+    void write(const char *s, size_t n) {
+      if (str) {
+        str->append(s, n);
+      } else {
+        if (len<size)
+          memcpy(buf+len, s, n<size-len ? n : size-len);
+        len+=n;
+      }
+    }
+
+    void write(const char *s) {
+      write(s, strlen(s));
+    }
+
+    void write(const std::string &s) {
+      write(s.data(), s.size());
+    }
+
+    /**
+       Writes n characters at s as a JSON string, in quotes, with the
+       characters that need it escaped. Runs that need no escaping are
+       found with JSON::findEscape and copied whole.
+     */
+
+    void writeString(const char *s, size_t n);
+
+    void writeString(const char *s) {
+      writeString(s, strlen(s));
+    }
+
+    void writeString(const std::string &s) {
+      writeString(s.data(), s.size());
+    }
+
+    /**
+       @return What has been written. For a fixed buffer, at most its
+       size is kept.
+     */
+
+    const char *data() const {
+      return str ? str->data() : buf;
+    }
+
+    /**
+       @return The number of characters written, including those that
+       did not fit in a fixed buffer
+     */
+
+    size_t length() const {
+      return str ? str->size() : len;
+    }
+
+    void clear() {
+      if (str)
+        str->clear();
+      len=0;
+    }
+
+  private:
+    std::string *str;
+    std::string own;
+    char *buf;
+    size_t size;
+    size_t len;
+
+    Writer(const Writer &);
+    Writer &operator=(const Writer &);
+  };
+
+  /*
+    MessagePack. The same Types that describe an object's JSON encoding
+    also pack it into MessagePack (http://msgpack.org), a binary
+    encoding with the same structure: objects become maps keyed by the
+    member names, lists and arrays become arrays, and numbers are
+    written as the shortest integer or float that holds them exactly,
+    so no number is ever formatted or parsed as text.
+  */
+
+  /**
+     Writes the header of an array of n elements, which are to follow.
+   */
+
+  void packArray(Writer &w, size_t n);
+
+  /**
+     Writes the header of a map of n keys and values, which are to
+     follow, each key before its value.
+   */
+
+  void packMap(Writer &w, size_t n);
+
+  void packString(Writer &w, const char *s, size_t n);
+
+  inline void packString(Writer &w, const char *s) {
+    packString(w, s, strlen(s));
+  }
+
+  inline void packString(Writer &w, const std::string &s) {
+    packString(w, s.data(), s.size());
+  }
+
+  void packNumber(Writer &w, double d);
+
+  inline void packBoolean(Writer &w, bool b) {
+    w.put(b ? '\xc3' : '\xc2');
+  }
+
+  inline void packNull(Writer &w) {
+    w.put('\xc0');
+  }
+
+  /**
+     Reads MessagePack data, a value at a time. Like JSON::Reader, the
+     read functions expect a value of their own type, which peek tells.
+     Strings are returned as Strs into the data. The errors in the data
+     are reported with their offset.
+   */
+
+  class Unpacker {
+  public:
+    Unpacker(const char *data, size_t size,
+	     JSON::ErrFunc *err=NULL, void *errData=NULL);
+
+    /**
+       Finds the type of the next value. Binary data counts as a string.
+     */
+
+    bool peek(JSON::Value::type *type);
+
+    bool readNumber(double *d);
+    bool readString(JSON::Str *s);
+    bool readBoolean(bool *b);
+
+    /**
+       Reads the header of an array, whose n elements follow.
+     */
+
+    bool readArray(size_t *n);
+
+    /**
+       Reads the header of a map, whose n keys and values follow.
+     */
+
+    bool readMap(size_t *n);
+
+    /**
+       Skips the next value, with what it contains.
+     */
+
+    bool skip();
+
+    /**
+       @return The offset of the next value in the data
+     */
+
+    size_t offset() const {
+      return p-start;
+    }
+
+  private:
+    const unsigned char *start;
+    const unsigned char *p;
+    const unsigned char *end;
+    JSON::ErrFunc *err;
+    void *errData;
+
+    bool header(size_t *n, unsigned char fix, unsigned char c16,
+		unsigned char c32, size_t items);
+    bool error();
+  };
+
+  /**
+     Reports a type error at the given offset of MessagePack data.
+   */
+
+  void typeerror(size_t offset, JSON::ErrFunc *err, void *errData);
+
+  /**
+     Converts a C++ object with JSON hooks into MessagePack.
+
+     @return The MessagePack data, as a string of bytes.
+   */
+
+  std::string encodeMsgPack(Type *t, void *obj);
+
+  /**
+     Like encodeMsgPack(Type *, void *), but appends the data to w.
+   */
+
+  void encodeMsgPack(Type *t, void *obj, Writer &w);
+
+  /**
+     Converts size bytes of MessagePack data at data into a C++ object
+     with JSON hooks, as decodeJSON does JSON. Like decodeJSON, it stops
+     after the first value.
+
+     @return true if the conversion was successful, false otherwise.
+   */
+
+  bool decodeMsgPack(const char *data, size_t size, Type *t, void *ret,
+		     JSON::ErrFunc *err=NULL, void *errData=NULL);
+
+  /**
+     Like readJSON, but from MessagePack data.
+   */
+
+  bool unpackJSON(Unpacker *u, Type *t, void *ret,
+		  JSON::ErrFunc *err, void *errData);
 
   /**
      Describes the type of the C++ object that a JSON string
@@ -84,7 +452,32 @@ namespace JSONSchema {
 //    virtual void *create()=0;
     virtual bool fill(JSON::Value *v, void *ret,
 		      JSON::ErrFunc *err, void *errData)=0;
-    virtual std::string encode(void *obj)=0;
+
+    /**
+       Reads the value from r, which readJSON has found to be of this
+       type. Unless overridden, the value is parsed into a tree and
+       given to fill.
+     */
+
+    virtual bool read(JSON::Reader *r, void *ret,
+		      JSON::ErrFunc *err, void *errData);
+
+    /**
+       Encodes obj as JSON. A Type overrides at least one of the two
+       forms, each of which by default goes through the other.
+     */
+
+    virtual std::string encode(void *obj);
+    virtual void encode(void *obj, Writer &w);
+
+    /**
+       Reads and writes MessagePack. Unless overridden, unpack reports
+       a type error, and pack reports an error and writes a nil.
+     */
+
+    virtual bool unpack(Unpacker *u, void *ret,
+			JSON::ErrFunc *err, void *errData);
+    virtual void pack(void *obj, Writer &w);
   };
 
   template<class T> class Array : public Type {
@@ -114,17 +507,61 @@ namespace JSONSchema {
       return true;
     }
     
-    std::string encode(void *obj) {
-      std::string ret("[");
-      int i;
+    bool read(JSON::Reader *r, void *ret,
+	      JSON::ErrFunc *err, void *errData) {
+      std::vector<T> *o=(std::vector<T> *)ret;
+      size_t i;
+      bool more;
+      if (!r->startArray())
+        return false;
+      for (i=0; ; i++) {
+        if (!r->nextElement(&more))
+          return false;
+        if (!more)
+          break;
+        if (i>=o->size())
+          o->resize(i+1);
+        if (!readJSON(r, elementType(), &((*o)[i]),
+		      err, errData))
+          return false;
+      }
+      o->resize(i);
+      return true;
+    }
+    
+    using Type::encode;
+    void encode(void *obj, Writer &w) {
+      size_t i;
       std::vector<T> *o=(std::vector<T> *)obj;
+      w.put('[');
       for (i=0; i<o->size(); i++) {
-        ret+=encodeJSON(elementType(), &((*o)[i]));
-        if (i<o->size()-1)
-          ret+=",";
+        if (i)
+          w.put(',');
+        encodeJSON(elementType(), &((*o)[i]), w);
+      }
+      w.put(']');
+    }
+    
+    bool unpack(Unpacker *u, void *ret,
+		JSON::ErrFunc *err, void *errData) {
+      std::vector<T> *o=(std::vector<T> *)ret;
+      size_t i, n;
+      if (!u->readArray(&n))
+        return false;
+      o->resize(n);
+      for (i=0; i<n; i++) {
+        if (!unpackJSON(u, elementType(), &((*o)[i]), err, errData))
+          return false;
       }
-      ret+=std::string("]");
-      return ret;
+      return true;
+    }
+
+    void pack(void *obj, Writer &w) {
+      size_t i;
+      std::vector<T> *o=(std::vector<T> *)obj;
+      packArray(w, o->size());
+      for (i=0; i<o->size(); i++)
+        elementType()->pack(&((*o)[i]), w);
     }
     
     Type *t;
@@ -133,7 +570,20 @@ namespace JSONSchema {
   
   template<> bool Array<bool>::fill(JSON::Value *v, void *ret,
 				    JSON::ErrFunc *err, void *errData);
-  template<> std::string Array<bool>::encode(void *obj);
+  template<> bool Array<bool>::read(JSON::Reader *r, void *ret,
+				    JSON::ErrFunc *err, void *errData);
+  template<> void Array<bool>::encode(void *obj, Writer &w);
+  template<> bool Array<bool>::unpack(Unpacker *u, void *ret,
+				      JSON::ErrFunc *err, void *errData);
+  template<> void Array<bool>::pack(void *obj, Writer &w);
+  template<> bool Array<double>::fill(JSON::Value *v, void *ret,
+				      JSON::ErrFunc *err, void *errData);
+  template<> bool Array<double>::read(JSON::Reader *r, void *ret,
+				      JSON::ErrFunc *err, void *errData);
+  template<> void Array<double>::encode(void *obj, Writer &w);
+  template<> bool Array<double>::unpack(Unpacker *u, void *ret,
+					JSON::ErrFunc *err, void *errData);
+  template<> void Array<double>::pack(void *obj, Writer &w);
 
   template<class T> class Map : public Type {
   public:
@@ -152,31 +602,84 @@ namespace JSONSchema {
 	      JSON::ErrFunc *err, void *errData) {
       JSON::Object *a=(JSON::Object *)v;
       std::map<std::string, T> *o=(std::map<std::string, T> *)ret;
-      std::map<std::string, JSON::Value *>::iterator I;
+      JSON::Object::Members::iterator I;
       for (I=a->value.begin(); I!=a->value.end(); ++I) {
-        std::pair<std::string, T> e;
-        if (!convertJSON(I->second, elementType(), &e.second,
+        // As in read and unpack, a key already in the map is replaced
+        T &e=(*o)[std::string(I->first.data(), I->first.size())];
+        if (!convertJSON(I->second, elementType(), &e,
 			 err, errData))
           return false;
-        e.first=I->first;
-        o->insert(e);
       }
       return true;
     }
     
-    std::string encode(void *obj) {
-      std::string ret("{");
+    bool read(JSON::Reader *r, void *ret,
+	      JSON::ErrFunc *err, void *errData) {
+      std::map<std::string, T> *o=(std::map<std::string, T> *)ret;
+      JSON::Str key;
+      bool more;
+      if (!r->startObject())
+        return false;
+      for (;;) {
+        if (!r->nextMember(&key, &more))
+          return false;
+        if (!more)
+          return true;
+        // The key is only valid until the value is read. A key
+        // already in the map is replaced, as in fill and unpack
+        T &e=(*o)[std::string(key.data(), key.size())];
+        if (!readJSON(r, elementType(), &e, err, errData))
+          return false;
+      }
+    }
+    
+    using Type::encode;
+    void encode(void *obj, Writer &w) {
+      std::map<std::string, T> *o=(std::map<std::string, T> *)obj;
+      typename std::map<std::string, T>::iterator I;
+      w.put('{');
+      for (I=o->begin(); I!=o->end(); ++I) {
+        if (I!=o->begin())
+          w.put(',');
+        w.writeString(I->first);
+        w.put(':');
+        encodeJSON(elementType(), &I->second, w);
+      }
+      w.put('}');
+    }
+
+    bool unpack(Unpacker *u, void *ret,
+		JSON::ErrFunc *err, void *errData) {
+      std::map<std::string, T> *o=(std::map<std::string, T> *)ret;
+      JSON::Value::type type;
+      JSON::Str key;
+      size_t i, n;
+      if (!u->readMap(&n))
+        return false;
+      for (i=0; i<n; i++) {
+        if (!u->peek(&type))
+          return false;
+        if (type!=JSON::Value::string) {
+          typeerror(u->offset(), err, errData);
+          return false;
+        }
+        if (!u->readString(&key))
+          return false;
+        T &e=(*o)[std::string(key.data(), key.size())];
+        if (!unpackJSON(u, elementType(), &e, err, errData))
+          return false;
+      }
+      return true;
+    }
+
+    void pack(void *obj, Writer &w) {
       std::map<std::string, T> *o=(std::map<std::string, T> *)obj;
       typename std::map<std::string, T>::iterator I;
-      for (I=o->begin(); I!=o->end();) {
-        ret+=std::string("\"")+I->first+std::string("\":");
-        ret+=encodeJSON(elementType(), &I->second);
-        ++I;
-        if (I!=o->end())
-          ret+=",";
+      packMap(w, o->size());
+      for (I=o->begin(); I!=o->end(); ++I) {
+        packString(w, I->first);
+        elementType()->pack(&I->second, w);
       }
-      ret+=std::string("}");
-      return ret;
     }
 
     Type *t;
@@ -193,10 +696,21 @@ namespace JSONSchema {
       *(double *)ret=((JSON::Number *)v)->value;
       return true;
     }
-    std::string encode(void *obj) {
-      char buf[80];
-      sprintf(buf, "%g", *(double *)obj);
-      return std::string(buf);
+    bool read(JSON::Reader *r, void *ret,
+	      JSON::ErrFunc *err, void *errData) {
+      return r->readNumber((double *)ret);
+    }
+    using Type::encode;
+    void encode(void *obj, Writer &w) {
+      char buf[32];
+      w.write(buf, JSON::formatNumber(buf, *(double *)obj));
+    }
+    bool unpack(Unpacker *u, void *ret,
+		JSON::ErrFunc *err, void *errData) {
+      return u->readNumber((double *)ret);
+    }
+    void pack(void *obj, Writer &w) {
+      packNumber(w, *(double *)obj);
     }
   };
 
@@ -207,11 +721,32 @@ namespace JSONSchema {
     }
     bool fill(JSON::Value *v, void *ret,
 	      JSON::ErrFunc *err, void *errData) {
-      *(std::string *)ret=((JSON::String *)v)->value;
+      JSON::Str &s=((JSON::String *)v)->value;
+      ((std::string *)ret)->assign(s.data(), s.size());
+      return true;
+    }
+    bool read(JSON::Reader *r, void *ret,
+	      JSON::ErrFunc *err, void *errData) {
+      JSON::Str s;
+      if (!r->readString(&s))
+        return false;
+      ((std::string *)ret)->assign(s.data(), s.size());
+      return true;
+    }
+    using Type::encode;
+    void encode(void *obj, Writer &w) {
+      w.writeString(*(std::string *)obj);
+    }
+    bool unpack(Unpacker *u, void *ret,
+		JSON::ErrFunc *err, void *errData) {
+      JSON::Str s;
+      if (!u->readString(&s))
+        return false;
+      ((std::string *)ret)->assign(s.data(), s.size());
       return true;
     }
-    std::string encode(void *obj) {
-      return std::string("\"")+*(std::string *)obj+std::string("\"");
+    void pack(void *obj, Writer &w) {
+      packString(w, *(std::string *)obj);
     }
   };
 
@@ -225,11 +760,107 @@ namespace JSONSchema {
       *(bool *)ret=((JSON::Boolean *)v)->value;
       return true;
     }
-    std::string encode(void *obj) {
-      return *(bool *)obj?"true":"false";
+    bool read(JSON::Reader *r, void *ret,
+	      JSON::ErrFunc *err, void *errData) {
+      return r->readBoolean((bool *)ret);
+    }
+    using Type::encode;
+    void encode(void *obj, Writer &w) {
+      if (*(bool *)obj)
+        w.write("true", 4);
+      else
+        w.write("false", 5);
+    }
+    bool unpack(Unpacker *u, void *ret,
+		JSON::ErrFunc *err, void *errData) {
+      return u->readBoolean((bool *)ret);
+    }
+    void pack(void *obj, Writer &w) {
+      packBoolean(w, *(bool *)obj);
     }
   };
   
+  /**
+     Maps the member names of a class to their numbers with a perfect
+     hash: the hash is seeded, and seeds are tried until no two names
+     share a slot of the table, so that a lookup is one hash and one
+     compare. It is built on first use rather than with its Type, as
+     the names may be initialized later, and may be used by several
+     threads at once.
+   */
+
+  class MemberIndex {
+  public:
+    MemberIndex():
+    built(0), seed(0), mask(0) {}
+
+    /**
+       @return true once build has been called
+     */
+
+    bool ready() const;
+
+    template<class S> void build(const S *anames, int n) {
+      std::vector<std::string> v(anames, anames+n);
+      build(v);
+    }
+
+    /**
+       Builds the table, unless another thread has done so. If a name
+       occurs more than once, the first wins.
+     */
+
+    void build(const std::vector<std::string> &anames);
+
+    /**
+       @return The number of the member named key, or -1
+     */
+
+    int find(const JSON::Str &key) const {
+      int i=slots[hash(key.data(), key.size(), seed)&mask];
+      return i>=0 && JSON::Str(names[i])==key ? i : -1;
+    }
+
+    /**
+       Hashes eight bytes at a time; the last word of a name longer
+       than eight bytes overlaps the one before it.
+     */
+
+    static unsigned hash(const char *s, size_t n, unsigned seed) {
+      unsigned long long h=mix(seed, n);
+      unsigned long long w=0;
+      size_t i;
+      if (n<8) {
+        for (i=0; i<n; i++)
+          w=w<<8 | (unsigned char)s[i];
+        return finish(mix(h, w));
+      }
+      for (i=0; i+8<n; i+=8) {
+        memcpy(&w, s+i, 8);
+        h=mix(h, w);
+      }
+      memcpy(&w, s+n-8, 8);
+      return finish(mix(h, w));
+    }
+
+    static unsigned long long mix(unsigned long long h, unsigned long long w) {
+      h=(h^w)*0x9e3779b97f4a7c15ull;
+      return h^(h>>32);
+    }
+
+    // A multiplication only carries upwards, so the top half is taken
+    static unsigned finish(unsigned long long h) {
+      return (unsigned)((h*0x9e3779b97f4a7c15ull)>>32);
+    }
+
+  private:
+    int built;
+    unsigned seed;
+    unsigned mask;
+    std::vector<int> slots;
+    std::vector<std::string> names;
+  };
+
   template<class T> class Object : public Type {
   public:
     JSON::Value::type getType() {
@@ -247,34 +878,41 @@ namespace JSONSchema {
     Type *memberType(int n) {
       return T::memberType[n];
     }
+
+    const MemberIndex &memberIndex() {
+      if (!index.ready())
+        index.build(T::memberName, nMembers());
+      return index;
+    }
     
-    std::string encode(void *obj) {
+    using Type::encode;
+    void encode(void *obj, Writer &w) {
       ((T *)obj)->freeze();
-      std::string ret("{");
       int i;
+      w.put('{');
       for (i=0; i<nMembers(); i++) {
-        ret+=std::string("\"")+memberName(i)+std::string("\":");
-        ret+=encodeJSON(memberType(i), ((T *)obj)->member(i));
-        if (i<nMembers()-1)
-          ret+=",";
+        if (i)
+          w.put(',');
+        w.writeString(T::memberName[i]);
+        w.put(':');
+        encodeJSON(memberType(i), ((T *)obj)->member(i), w);
       }
-      ret+=std::string("}");
-      return ret;
+      w.put('}');
     }
     
     bool fill(JSON::Value *v, void *ret,
 	      JSON::ErrFunc *err, void *errData) {
       JSON::Object *o=(JSON::Object *)v;
+      const MemberIndex &members=memberIndex();
+      JSON::Object::Members::iterator I;
       int i;
-      for (i=0; i<nMembers(); i++) {
-        std::map<std::string, JSON::Value *>::iterator F;
-        F=o->value.find(memberName(i));
-        if (F!=o->value.end()) {
-          JSON::Value *v=F->second;
-          void *p=((T *)ret)->member(i);
-          if (!convertJSON(v, memberType(i), p, err, errData)) {
-            return false;
-          }
+      for (I=o->value.begin(); I!=o->value.end(); ++I) {
+        i=members.find(I->first);
+        if (i<0)
+          continue;
+        void *p=((T *)ret)->member(i);
+        if (!convertJSON(I->second, memberType(i), p, err, errData)) {
+          return false;
         }
       }
       if (!((T *)ret)->unfreeze(err, errData)) {
@@ -284,33 +922,111 @@ namespace JSONSchema {
       return true;
     }
     
-  };
-  
-  template<class T> class List : public Type {
-  public:
-    JSON::Value::type getType() {
-      return JSON::Value::array;
-    }
-    
-    int nElements() {
-      return sizeof(T::elementType)/sizeof(T::elementType[0]);
-    }
-    
-    Type *elementType(int n) {
+    bool read(JSON::Reader *r, void *ret,
+	      JSON::ErrFunc *err, void *errData) {
+      int lineno=r->lineno();
+      const MemberIndex &members=memberIndex();
+      JSON::Str key;
+      bool more;
+      int i;
+      if (!r->startObject())
+        return false;
+      for (;;) {
+        if (!r->nextMember(&key, &more))
+          return false;
+        if (!more)
+          break;
+        i=members.find(key);
+        if (i<0) {
+          if (!r->skip())
+            return false;
+        } else {
+          void *p=((T *)ret)->member(i);
+          if (!readJSON(r, memberType(i), p, err, errData))
+            return false;
+        }
+      }
+      if (!((T *)ret)->unfreeze(err, errData)) {
+        schemaerror(lineno, err, errData);
+        return false;
+      }
+      return true;
+    }
+
+    void pack(void *obj, Writer &w) {
+      ((T *)obj)->freeze();
+      int i;
+      packMap(w, nMembers());
+      for (i=0; i<nMembers(); i++) {
+        packString(w, T::memberName[i]);
+        memberType(i)->pack(((T *)obj)->member(i), w);
+      }
+    }
+
+    bool unpack(Unpacker *u, void *ret,
+		JSON::ErrFunc *err, void *errData) {
+      size_t offset=u->offset();
+      const MemberIndex &members=memberIndex();
+      JSON::Value::type type;
+      JSON::Str key;
+      size_t j, n;
+      int i;
+      if (!u->readMap(&n))
+        return false;
+      for (j=0; j<n; j++) {
+        if (!u->peek(&type))
+          return false;
+        if (type!=JSON::Value::string) {
+          typeerror(u->offset(), err, errData);
+          return false;
+        }
+        if (!u->readString(&key))
+          return false;
+        i=members.find(key);
+        if (i<0) {
+          if (!u->skip())
+            return false;
+        } else {
+          void *p=((T *)ret)->member(i);
+          if (!unpackJSON(u, memberType(i), p, err, errData))
+            return false;
+        }
+      }
+      if (!((T *)ret)->unfreeze(err, errData)) {
+        typeerror(offset, err, errData);
+        return false;
+      }
+      return true;
+    }
+
+    MemberIndex index;
+  };
+  
+  template<class T> class List : public Type {
+  public:
+    JSON::Value::type getType() {
+      return JSON::Value::array;
+    }
+    
+    int nElements() {
+      return sizeof(T::elementType)/sizeof(T::elementType[0]);
+    }
+    
+    Type *elementType(int n) {
       return T::elementType[n];
     }
     
-    std::string encode(void *obj) {
+    using Type::encode;
+    void encode(void *obj, Writer &w) {
       ((T *)obj)->freeze();
-      std::string ret("[");
       int i;
+      w.put('[');
       for (i=0; i<nElements(); i++) {
-        ret+=encodeJSON(elementType(i), ((T *)obj)->element(i));
-        if (i<nElements()-1)
-          ret+=",";
+        if (i)
+          w.put(',');
+        encodeJSON(elementType(i), ((T *)obj)->element(i), w);
       }
-      ret+=std::string("]");
-      return ret;
+      w.put(']');
     }
     
     bool fill(JSON::Value *v, void *ret,
@@ -333,8 +1049,1131 @@ namespace JSONSchema {
       return true;
     }
     
+    bool read(JSON::Reader *r, void *ret,
+	      JSON::ErrFunc *err, void *errData) {
+      int lineno=r->lineno();
+      bool more;
+      int i;
+      if (!r->startArray())
+        return false;
+      for (i=0; ; i++) {
+        if (!r->nextElement(&more))
+          return false;
+        if (!more)
+          break;
+        if (i>=nElements()) {
+          if (!r->skip())
+            return false;
+        } else {
+          void *p=((T *)ret)->element(i);
+          if (!readJSON(r, elementType(i), p, err, errData))
+            return false;
+        }
+      }
+      if (!((T *)ret)->unfreeze(err, errData)) {
+        schemaerror(lineno, err, errData);
+        return false;
+      }
+      return true;
+    }
+
+    void pack(void *obj, Writer &w) {
+      ((T *)obj)->freeze();
+      int i;
+      packArray(w, nElements());
+      for (i=0; i<nElements(); i++)
+        elementType(i)->pack(((T *)obj)->element(i), w);
+    }
+
+    bool unpack(Unpacker *u, void *ret,
+		JSON::ErrFunc *err, void *errData) {
+      size_t offset=u->offset();
+      size_t i, n;
+      if (!u->readArray(&n))
+        return false;
+      for (i=0; i<n; i++) {
+        if (i>=(size_t)nElements()) {
+          if (!u->skip())
+            return false;
+        } else {
+          void *p=((T *)ret)->element(i);
+          if (!unpackJSON(u, elementType(i), p, err, errData))
+            return false;
+        }
+      }
+      if (!((T *)ret)->unfreeze(err, errData)) {
+        typeerror(offset, err, errData);
+        return false;
+      }
+      return true;
+    }
+    
   };
   
+  /*
+    Described classes. Instead of the memberName, memberType and member
+    hooks of Object<T>, a class may list its members with a static
+    template, giving each a name and a member pointer:
+
+      template<class D> static void describe(D &d) {
+        d.member("a", &MyClass::a);
+        d.member("b", &MyClass::b);
+      }
+
+    Codec<T> then decodes and encodes T with the types of the members
+    known at compile time, so each member is read and written by code
+    made for it, without going through a Type and a void pointer. A
+    member may be a double, a std::string, a bool, another described
+    class, or a std::vector or std::map<std::string, ...> of those. A
+    numeric member may also be a std::vector of float or int, or a
+    fixed-size array of double, float or int: N[K], or std::array in
+    C++11.
+  */
+
+  /**
+     @return true if the next value of r is of the given type. Reports
+     a type error otherwise.
+   */
+
+  bool checkType(JSON::Reader *r, JSON::Value::type type,
+		 JSON::ErrFunc *err, void *errData);
+
+  inline bool checkType(JSON::Value *v, JSON::Value::type type,
+			JSON::ErrFunc *err, void *errData) {
+    if (v->getType()==type)
+      return true;
+    schemaerror(v, err, errData);
+    return false;
+  }
+
+  bool checkType(Unpacker *u, JSON::Value::type type,
+		 JSON::ErrFunc *err, void *errData);
+
+  /**
+     Reads an array of numbers into o, in one loop over the input.
+   */
+
+  bool readNumbers(JSON::Reader *r, std::vector<double> *o,
+		   JSON::ErrFunc *err, void *errData);
+
+  /**
+     Fills o from an array of numbers.
+   */
+
+  bool fillNumbers(JSON::Value *v, std::vector<double> *o,
+		   JSON::ErrFunc *err, void *errData);
+
+  /**
+     Unpacks an array of numbers into o.
+   */
+
+  bool unpackNumbers(Unpacker *u, std::vector<double> *o,
+		     JSON::ErrFunc *err, void *errData);
+
+  /**
+     Packs o as an array of numbers.
+   */
+
+  void packNumbers(Writer &w, const std::vector<double> &o);
+
+  /*
+    Numeric arrays of other element types. The numbers are read as
+    doubles and converted; an int takes only whole numbers in its
+    range, and anything else is a type error.
+  */
+
+  inline bool toNumber(double d, double *ret) {
+    *ret=d;
+    return true;
+  }
+
+  inline bool toNumber(double d, float *ret) {
+    *ret=(float)d;
+    return true;
+  }
+
+  inline bool toNumber(double d, int *ret) {
+    if (!(d>=INT_MIN && d<=INT_MAX) || d!=(double)(int)d)
+      return false;
+    *ret=(int)d;
+    return true;
+  }
+
+  /**
+     Where Reader::readNumbers puts a block of numbers: straight into a
+     buffer of doubles, and into block for other types.
+   */
+
+  inline double *numberBlock(double *to, double *) {
+    return to;
+  }
+
+  template<class N> double *numberBlock(N *, double *block) {
+    return block;
+  }
+
+  /**
+     Reads an array of numbers into the size elements at buf, setting
+     *n to the number read. An array with more elements is a type
+     error.
+   */
+
+  template<class N> bool readNumbers(JSON::Reader *r, N *buf, size_t size, size_t *n,
+				     JSON::ErrFunc *err, void *errData) {
+    double block[256];
+    size_t i, k, want;
+    bool more=true;
+    if (!r->startArray())
+      return false;
+    *n=0;
+    while (more) {
+      double *to=numberBlock(buf+*n, block);
+      want=size-*n;
+      if (to==block && want>256)
+        want=256;
+      if (!r->readNumbers(to, want, &k, &more))
+        return false;
+      for (i=0; to==block && i<k; i++) {
+        if (!toNumber(block[i], &buf[*n+i])) {
+          schemaerror(r->lineno(), err, errData);
+          return false;
+        }
+      }
+      *n+=k;
+      if (more && k<want) {
+        // An element that is not a number
+        checkType(r, JSON::Value::number, err, errData);
+        return false;
+      }
+      if (more && *n==size) {
+        // Full, so the array has to end here
+        if (!r->nextElement(&more))
+          return false;
+        if (more) {
+          schemaerror(r->lineno(), err, errData);
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+
+  template<class N> bool readNumbers(JSON::Reader *r, std::vector<N> *o,
+				     JSON::ErrFunc *err, void *errData) {
+    double block[256];
+    size_t i, k;
+    bool more=true;
+    N x;
+    if (!r->startArray())
+      return false;
+    o->clear();
+    while (more) {
+      if (!r->readNumbers(block, 256, &k, &more))
+        return false;
+      for (i=0; i<k; i++) {
+        if (!toNumber(block[i], &x)) {
+          schemaerror(r->lineno(), err, errData);
+          return false;
+        }
+        o->push_back(x);
+      }
+      if (more && k<256) {
+        checkType(r, JSON::Value::number, err, errData);
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /**
+     Fills the elements at buf from the numbers of a, which has as many.
+   */
+
+  template<class N> bool fillNumbers(JSON::Array *a, N *buf,
+				     JSON::ErrFunc *err, void *errData) {
+    size_t i;
+    for (i=0; i<a->value.size(); i++) {
+      JSON::Value *v=a->value[i];
+      if (v->getType()!=JSON::Value::number ||
+	  !toNumber(((JSON::Number *)v)->value, &buf[i])) {
+        schemaerror(v, err, errData);
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /**
+     Unpacks n numbers into the elements at buf, after the array header.
+   */
+
+  template<class N> bool unpackNumbers(Unpacker *u, N *buf, size_t n,
+				       JSON::ErrFunc *err, void *errData) {
+    size_t i, offset;
+    double d;
+    for (i=0; i<n; i++) {
+      offset=u->offset();
+      if (!checkType(u, JSON::Value::number, err, errData) ||
+	  !u->readNumber(&d))
+        return false;
+      if (!toNumber(d, &buf[i])) {
+        typeerror(offset, err, errData);
+        return false;
+      }
+    }
+    return true;
+  }
+
+  template<class N> void encodeNumbers(Writer &w, const N *buf, size_t n) {
+    size_t i;
+    char tmp[32];
+    w.put('[');
+    for (i=0; i<n; i++) {
+      if (i)
+        w.put(',');
+      w.write(tmp, JSON::formatNumber(tmp, (double)buf[i]));
+    }
+    w.put(']');
+  }
+
+  template<class N> void packNumbers(Writer &w, const N *buf, size_t n) {
+    size_t i;
+    packArray(w, n);
+    for (i=0; i<n; i++)
+      packNumber(w, (double)buf[i]);
+  }
+
+  template<class T> class MemberNamer;
+  template<class T> class MemberReader;
+  template<class T> class MemberFiller;
+  template<class T> class MemberEncoder;
+  template<class T> class MemberUnpacker;
+  template<class T> class MemberPacker;
+  template<class T> class MemberCounter;
+
+  /**
+     Decodes and encodes a described class. Specialized below for the
+     other types a member may have.
+   */
+
+  template<class T> struct Codec {
+    /**
+       Maps the member names to their places in describe, so that a
+       key is looked up once rather than compared with every name.
+     */
+
+    static const MemberIndex &memberIndex() {
+      static MemberIndex index;
+      if (!index.ready()) {
+        MemberNamer<T> m;
+        T::describe(m);
+        index.build(m.names);
+      }
+      return index;
+    }
+
+    static bool read(JSON::Reader *r, T *obj,
+		     JSON::ErrFunc *err, void *errData) {
+      const MemberIndex &members=memberIndex();
+      JSON::Str key;
+      bool more;
+      int i;
+      if (!checkType(r, JSON::Value::object, err, errData) ||
+	  !r->startObject())
+        return false;
+      for (;;) {
+        if (!r->nextMember(&key, &more))
+          return false;
+        if (!more)
+          return true;
+        i=members.find(key);
+        if (i<0) {
+          if (!r->skip())
+            return false;
+        } else {
+          MemberReader<T> m(obj, r, i, err, errData);
+          T::describe(m);
+          if (!m.ok)
+            return false;
+        }
+      }
+    }
+
+    static bool fill(JSON::Value *v, T *obj,
+		     JSON::ErrFunc *err, void *errData) {
+      if (!checkType(v, JSON::Value::object, err, errData))
+        return false;
+      MemberFiller<T> m(obj, (JSON::Object *)v, err, errData);
+      T::describe(m);
+      return m.ok;
+    }
+
+    static void encode(const T &obj, Writer &w) {
+      MemberEncoder<T> m(&obj, &w);
+      w.put('{');
+      T::describe(m);
+      w.put('}');
+    }
+
+    static bool unpack(Unpacker *u, T *obj,
+		       JSON::ErrFunc *err, void *errData) {
+      const MemberIndex &members=memberIndex();
+      JSON::Str key;
+      size_t j, n;
+      int i;
+      if (!checkType(u, JSON::Value::object, err, errData) ||
+	  !u->readMap(&n))
+        return false;
+      for (j=0; j<n; j++) {
+        if (!checkType(u, JSON::Value::string, err, errData) ||
+	    !u->readString(&key))
+          return false;
+        i=members.find(key);
+        if (i<0) {
+          if (!u->skip())
+            return false;
+        } else {
+          MemberUnpacker<T> m(obj, u, i, err, errData);
+          T::describe(m);
+          if (!m.ok)
+            return false;
+        }
+      }
+      return true;
+    }
+
+    static void pack(const T &obj, Writer &w) {
+      MemberCounter<T> c;
+      T::describe(c);
+      packMap(w, c.n);
+      MemberPacker<T> m(&obj, &w);
+      T::describe(m);
+    }
+  };
+
+  /**
+     Collects the names of the members, for Codec::memberIndex.
+   */
+
+  template<class T> class MemberNamer {
+  public:
+    template<class M> void member(const char *name, M T::*) {
+      names.push_back(name);
+    }
+
+    std::vector<std::string> names;
+  };
+
+  /**
+     Reads the value of a member into member number i. As describe is
+     inlined, the walk comes down to comparing i with each number.
+   */
+
+  template<class T> class MemberReader {
+  public:
+    MemberReader(T *aobj, JSON::Reader *ar, int ai,
+		 JSON::ErrFunc *aerr, void *aerrData):
+    ok(true), obj(aobj), r(ar), i(ai), n(0),
+    err(aerr), errData(aerrData) {}
+
+    template<class M> void member(const char *, M T::*ptr) {
+      if (n++==i)
+        ok=Codec<M>::read(r, &(obj->*ptr), err, errData);
+    }
+
+    bool ok;
+
+  private:
+    T *obj;
+    JSON::Reader *r;
+    int i;
+    int n;
+    JSON::ErrFunc *err;
+    void *errData;
+  };
+
+  /**
+     Fills each member from the member of an object with its name.
+   */
+
+  template<class T> class MemberFiller {
+  public:
+    MemberFiller(T *aobj, JSON::Object *ao,
+		 JSON::ErrFunc *aerr, void *aerrData):
+    ok(true), obj(aobj), o(ao), err(aerr), errData(aerrData) {}
+
+    template<class M> void member(const char *name, M T::*ptr) {
+      if (!ok)
+        return;
+      JSON::Object::Members::iterator F=o->value.find(JSON::Str(name));
+      if (F!=o->value.end())
+        ok=Codec<M>::fill(F->second, &(obj->*ptr), err, errData);
+    }
+
+    bool ok;
+
+  private:
+    T *obj;
+    JSON::Object *o;
+    JSON::ErrFunc *err;
+    void *errData;
+  };
+
+  template<class T> class MemberEncoder {
+  public:
+    MemberEncoder(const T *aobj, Writer *aw):
+    obj(aobj), w(aw), first(true) {}
+
+    template<class M> void member(const char *name, M T::*ptr) {
+      if (!first)
+        w->put(',');
+      first=false;
+      w->writeString(name);
+      w->put(':');
+      Codec<M>::encode(obj->*ptr, *w);
+    }
+
+  private:
+    const T *obj;
+    Writer *w;
+    bool first;
+  };
+
+  /**
+     Unpacks the value of a member into member number i.
+   */
+
+  template<class T> class MemberUnpacker {
+  public:
+    MemberUnpacker(T *aobj, Unpacker *au, int ai,
+		   JSON::ErrFunc *aerr, void *aerrData):
+    ok(true), obj(aobj), u(au), i(ai), n(0),
+    err(aerr), errData(aerrData) {}
+
+    template<class M> void member(const char *, M T::*ptr) {
+      if (n++==i)
+        ok=Codec<M>::unpack(u, &(obj->*ptr), err, errData);
+    }
+
+    bool ok;
+
+  private:
+    T *obj;
+    Unpacker *u;
+    int i;
+    int n;
+    JSON::ErrFunc *err;
+    void *errData;
+  };
+
+  template<class T> class MemberPacker {
+  public:
+    MemberPacker(const T *aobj, Writer *aw):
+    obj(aobj), w(aw) {}
+
+    template<class M> void member(const char *name, M T::*ptr) {
+      packString(*w, name);
+      Codec<M>::pack(obj->*ptr, *w);
+    }
+
+  private:
+    const T *obj;
+    Writer *w;
+  };
+
+  /**
+     Counts the members, for the header of a packed map.
+   */
+
+  template<class T> class MemberCounter {
+  public:
+    MemberCounter():
+    n(0) {}
+
+    template<class M> void member(const char *, M T::*) {
+      n++;
+    }
+
+    size_t n;
+  };
+
+  template<> struct Codec<double> {
+    static bool read(JSON::Reader *r, double *ret,
+		     JSON::ErrFunc *err, void *errData) {
+      return checkType(r, JSON::Value::number, err, errData) &&
+        r->readNumber(ret);
+    }
+    static bool fill(JSON::Value *v, double *ret,
+		     JSON::ErrFunc *err, void *errData) {
+      if (!checkType(v, JSON::Value::number, err, errData))
+        return false;
+      *ret=((JSON::Number *)v)->value;
+      return true;
+    }
+    static void encode(double d, Writer &w) {
+      char buf[32];
+      w.write(buf, JSON::formatNumber(buf, d));
+    }
+    static bool unpack(Unpacker *u, double *ret,
+		       JSON::ErrFunc *err, void *errData) {
+      return checkType(u, JSON::Value::number, err, errData) &&
+        u->readNumber(ret);
+    }
+    static void pack(double d, Writer &w) {
+      packNumber(w, d);
+    }
+  };
+
+  template<> struct Codec<std::string> {
+    static bool read(JSON::Reader *r, std::string *ret,
+		     JSON::ErrFunc *err, void *errData) {
+      JSON::Str s;
+      if (!checkType(r, JSON::Value::string, err, errData) ||
+	  !r->readString(&s))
+        return false;
+      ret->assign(s.data(), s.size());
+      return true;
+    }
+    static bool fill(JSON::Value *v, std::string *ret,
+		     JSON::ErrFunc *err, void *errData) {
+      if (!checkType(v, JSON::Value::string, err, errData))
+        return false;
+      JSON::Str &s=((JSON::String *)v)->value;
+      ret->assign(s.data(), s.size());
+      return true;
+    }
+    static void encode(const std::string &s, Writer &w) {
+      w.writeString(s);
+    }
+    static bool unpack(Unpacker *u, std::string *ret,
+		       JSON::ErrFunc *err, void *errData) {
+      JSON::Str s;
+      if (!checkType(u, JSON::Value::string, err, errData) ||
+	  !u->readString(&s))
+        return false;
+      ret->assign(s.data(), s.size());
+      return true;
+    }
+    static void pack(const std::string &s, Writer &w) {
+      packString(w, s);
+    }
+  };
+
+  template<> struct Codec<bool> {
+    static bool read(JSON::Reader *r, bool *ret,
+		     JSON::ErrFunc *err, void *errData) {
+      return checkType(r, JSON::Value::boolean, err, errData) &&
+        r->readBoolean(ret);
+    }
+    static bool fill(JSON::Value *v, bool *ret,
+		     JSON::ErrFunc *err, void *errData) {
+      if (!checkType(v, JSON::Value::boolean, err, errData))
+        return false;
+      *ret=((JSON::Boolean *)v)->value;
+      return true;
+    }
+    static void encode(bool b, Writer &w) {
+      if (b)
+        w.write("true", 4);
+      else
+        w.write("false", 5);
+    }
+    static bool unpack(Unpacker *u, bool *ret,
+		       JSON::ErrFunc *err, void *errData) {
+      return checkType(u, JSON::Value::boolean, err, errData) &&
+        u->readBoolean(ret);
+    }
+    static void pack(bool b, Writer &w) {
+      packBoolean(w, b);
+    }
+  };
+
+  template<class V> struct Codec<std::vector<V> > {
+    static bool read(JSON::Reader *r, std::vector<V> *o,
+		     JSON::ErrFunc *err, void *errData) {
+      size_t i;
+      bool more;
+      if (!checkType(r, JSON::Value::array, err, errData) ||
+	  !r->startArray())
+        return false;
+      for (i=0; ; i++) {
+        if (!r->nextElement(&more))
+          return false;
+        if (!more)
+          break;
+        if (i>=o->size())
+          o->resize(i+1);
+        if (!Codec<V>::read(r, &(*o)[i], err, errData))
+          return false;
+      }
+      o->resize(i);
+      return true;
+    }
+    static bool fill(JSON::Value *v, std::vector<V> *o,
+		     JSON::ErrFunc *err, void *errData) {
+      if (!checkType(v, JSON::Value::array, err, errData))
+        return false;
+      JSON::Array *a=(JSON::Array *)v;
+      size_t i;
+      o->resize(a->value.size());
+      for (i=0; i<a->value.size(); i++)
+        if (!Codec<V>::fill(a->value[i], &(*o)[i], err, errData))
+          return false;
+      return true;
+    }
+    static void encode(const std::vector<V> &o, Writer &w) {
+      size_t i;
+      w.put('[');
+      for (i=0; i<o.size(); i++) {
+        if (i)
+          w.put(',');
+        Codec<V>::encode(o[i], w);
+      }
+      w.put(']');
+    }
+    static bool unpack(Unpacker *u, std::vector<V> *o,
+		       JSON::ErrFunc *err, void *errData) {
+      size_t i, n;
+      if (!checkType(u, JSON::Value::array, err, errData) ||
+	  !u->readArray(&n))
+        return false;
+      o->resize(n);
+      for (i=0; i<n; i++)
+        if (!Codec<V>::unpack(u, &(*o)[i], err, errData))
+          return false;
+      return true;
+    }
+    static void pack(const std::vector<V> &o, Writer &w) {
+      size_t i;
+      packArray(w, o.size());
+      for (i=0; i<o.size(); i++)
+        Codec<V>::pack(o[i], w);
+    }
+  };
+
+  template<> struct Codec<std::vector<double> > {
+    static bool read(JSON::Reader *r, std::vector<double> *o,
+		     JSON::ErrFunc *err, void *errData) {
+      return checkType(r, JSON::Value::array, err, errData) &&
+        readNumbers(r, o, err, errData);
+    }
+    static bool fill(JSON::Value *v, std::vector<double> *o,
+		     JSON::ErrFunc *err, void *errData) {
+      return checkType(v, JSON::Value::array, err, errData) &&
+        fillNumbers(v, o, err, errData);
+    }
+    static void encode(const std::vector<double> &o, Writer &w) {
+      size_t i;
+      char buf[32];
+      w.put('[');
+      for (i=0; i<o.size(); i++) {
+        if (i)
+          w.put(',');
+        w.write(buf, JSON::formatNumber(buf, o[i]));
+      }
+      w.put(']');
+    }
+    static bool unpack(Unpacker *u, std::vector<double> *o,
+		       JSON::ErrFunc *err, void *errData) {
+      return checkType(u, JSON::Value::array, err, errData) &&
+        unpackNumbers(u, o, err, errData);
+    }
+    static void pack(const std::vector<double> &o, Writer &w) {
+      packNumbers(w, o);
+    }
+  };
+
+  /**
+     Decodes and encodes a std::vector of float or int.
+   */
+
+  template<class N> struct NumberVectorCodec {
+    static bool read(JSON::Reader *r, std::vector<N> *o,
+		     JSON::ErrFunc *err, void *errData) {
+      return checkType(r, JSON::Value::array, err, errData) &&
+        readNumbers(r, o, err, errData);
+    }
+    static bool fill(JSON::Value *v, std::vector<N> *o,
+		     JSON::ErrFunc *err, void *errData) {
+      if (!checkType(v, JSON::Value::array, err, errData))
+        return false;
+      JSON::Array *a=(JSON::Array *)v;
+      o->resize(a->value.size());
+      return o->empty() || fillNumbers(a, &(*o)[0], err, errData);
+    }
+    static void encode(const std::vector<N> &o, Writer &w) {
+      encodeNumbers(w, o.empty() ? (const N *)NULL : &o[0], o.size());
+    }
+    static bool unpack(Unpacker *u, std::vector<N> *o,
+		       JSON::ErrFunc *err, void *errData) {
+      size_t n;
+      if (!checkType(u, JSON::Value::array, err, errData) ||
+	  !u->readArray(&n))
+        return false;
+      o->resize(n);
+      return n==0 || unpackNumbers(u, &(*o)[0], n, err, errData);
+    }
+    static void pack(const std::vector<N> &o, Writer &w) {
+      packNumbers(w, o.empty() ? (const N *)NULL : &o[0], o.size());
+    }
+  };
+
+  template<> struct Codec<std::vector<float> > : NumberVectorCodec<float> {};
+  template<> struct Codec<std::vector<int> > : NumberVectorCodec<int> {};
+
+  /**
+     Decodes and encodes an array A of K numbers of type N, in place.
+     The JSON array must have exactly K elements.
+   */
+
+  template<class N, size_t K, class A> struct NumberArrayCodec {
+    static bool read(JSON::Reader *r, A *o,
+		     JSON::ErrFunc *err, void *errData) {
+      int lineno=r->lineno();
+      size_t n;
+      if (!checkType(r, JSON::Value::array, err, errData) ||
+	  !readNumbers(r, &(*o)[0], K, &n, err, errData))
+        return false;
+      if (n!=K) {
+        schemaerror(lineno, err, errData);
+        return false;
+      }
+      return true;
+    }
+    static bool fill(JSON::Value *v, A *o,
+		     JSON::ErrFunc *err, void *errData) {
+      if (!checkType(v, JSON::Value::array, err, errData))
+        return false;
+      if (((JSON::Array *)v)->value.size()!=K) {
+        schemaerror(v, err, errData);
+        return false;
+      }
+      return fillNumbers((JSON::Array *)v, &(*o)[0], err, errData);
+    }
+    static void encode(const A &o, Writer &w) {
+      encodeNumbers(w, &o[0], K);
+    }
+    static bool unpack(Unpacker *u, A *o,
+		       JSON::ErrFunc *err, void *errData) {
+      size_t offset=u->offset();
+      size_t n;
+      if (!checkType(u, JSON::Value::array, err, errData) ||
+	  !u->readArray(&n))
+        return false;
+      if (n!=K) {
+        typeerror(offset, err, errData);
+        return false;
+      }
+      return unpackNumbers(u, &(*o)[0], K, err, errData);
+    }
+    static void pack(const A &o, Writer &w) {
+      packNumbers(w, &o[0], K);
+    }
+  };
+
+  template<size_t K> struct Codec<double[K]> : NumberArrayCodec<double, K, double[K]> {};
+  template<size_t K> struct Codec<float[K]> : NumberArrayCodec<float, K, float[K]> {};
+  template<size_t K> struct Codec<int[K]> : NumberArrayCodec<int, K, int[K]> {};
+
+#if __cplusplus>=201103L
+  template<size_t K> struct Codec<std::array<double, K> > :
+    NumberArrayCodec<double, K, std::array<double, K> > {};
+  template<size_t K> struct Codec<std::array<float, K> > :
+    NumberArrayCodec<float, K, std::array<float, K> > {};
+  template<size_t K> struct Codec<std::array<int, K> > :
+    NumberArrayCodec<int, K, std::array<int, K> > {};
+#endif
+
+  template<> struct Codec<std::vector<bool> > {
+    static bool read(JSON::Reader *r, std::vector<bool> *o,
+		     JSON::ErrFunc *err, void *errData) {
+      bool more, b;
+      if (!checkType(r, JSON::Value::array, err, errData) ||
+	  !r->startArray())
+        return false;
+      o->clear();
+      for (;;) {
+        if (!r->nextElement(&more))
+          return false;
+        if (!more)
+          return true;
+        if (!Codec<bool>::read(r, &b, err, errData))
+          return false;
+        o->push_back(b);
+      }
+    }
+    static bool fill(JSON::Value *v, std::vector<bool> *o,
+		     JSON::ErrFunc *err, void *errData) {
+      if (!checkType(v, JSON::Value::array, err, errData))
+        return false;
+      JSON::Array *a=(JSON::Array *)v;
+      size_t i;
+      bool b;
+      o->resize(a->value.size());
+      for (i=0; i<a->value.size(); i++) {
+        if (!Codec<bool>::fill(a->value[i], &b, err, errData))
+          return false;
+        (*o)[i]=b;
+      }
+      return true;
+    }
+    static void encode(const std::vector<bool> &o, Writer &w) {
+      size_t i;
+      w.put('[');
+      for (i=0; i<o.size(); i++) {
+        if (i)
+          w.put(',');
+        Codec<bool>::encode(o[i], w);
+      }
+      w.put(']');
+    }
+    static bool unpack(Unpacker *u, std::vector<bool> *o,
+		       JSON::ErrFunc *err, void *errData) {
+      size_t i, n;
+      bool b;
+      if (!checkType(u, JSON::Value::array, err, errData) ||
+	  !u->readArray(&n))
+        return false;
+      o->resize(n);
+      for (i=0; i<n; i++) {
+        if (!Codec<bool>::unpack(u, &b, err, errData))
+          return false;
+        (*o)[i]=b;
+      }
+      return true;
+    }
+    static void pack(const std::vector<bool> &o, Writer &w) {
+      size_t i;
+      packArray(w, o.size());
+      for (i=0; i<o.size(); i++)
+        packBoolean(w, o[i]);
+    }
+  };
+
+  template<class V> struct Codec<std::map<std::string, V> > {
+    static bool read(JSON::Reader *r, std::map<std::string, V> *o,
+		     JSON::ErrFunc *err, void *errData) {
+      JSON::Str key;
+      bool more;
+      if (!checkType(r, JSON::Value::object, err, errData) ||
+	  !r->startObject())
+        return false;
+      for (;;) {
+        if (!r->nextMember(&key, &more))
+          return false;
+        if (!more)
+          return true;
+        V &e=(*o)[std::string(key.data(), key.size())];
+        if (!Codec<V>::read(r, &e, err, errData))
+          return false;
+      }
+    }
+    static bool fill(JSON::Value *v, std::map<std::string, V> *o,
+		     JSON::ErrFunc *err, void *errData) {
+      if (!checkType(v, JSON::Value::object, err, errData))
+        return false;
+      JSON::Object *a=(JSON::Object *)v;
+      JSON::Object::Members::iterator I;
+      for (I=a->value.begin(); I!=a->value.end(); ++I) {
+        V &e=(*o)[std::string(I->first.data(), I->first.size())];
+        if (!Codec<V>::fill(I->second, &e, err, errData))
+          return false;
+      }
+      return true;
+    }
+    static void encode(const std::map<std::string, V> &o, Writer &w) {
+      typename std::map<std::string, V>::const_iterator I;
+      w.put('{');
+      for (I=o.begin(); I!=o.end(); ++I) {
+        if (I!=o.begin())
+          w.put(',');
+        w.writeString(I->first);
+        w.put(':');
+        Codec<V>::encode(I->second, w);
+      }
+      w.put('}');
+    }
+    static bool unpack(Unpacker *u, std::map<std::string, V> *o,
+		       JSON::ErrFunc *err, void *errData) {
+      JSON::Str key;
+      size_t i, n;
+      if (!checkType(u, JSON::Value::object, err, errData) ||
+	  !u->readMap(&n))
+        return false;
+      for (i=0; i<n; i++) {
+        if (!checkType(u, JSON::Value::string, err, errData) ||
+	    !u->readString(&key))
+          return false;
+        V &e=(*o)[std::string(key.data(), key.size())];
+        if (!Codec<V>::unpack(u, &e, err, errData))
+          return false;
+      }
+      return true;
+    }
+    static void pack(const std::map<std::string, V> &o, Writer &w) {
+      typename std::map<std::string, V>::const_iterator I;
+      packMap(w, o.size());
+      for (I=o.begin(); I!=o.end(); ++I) {
+        packString(w, I->first);
+        Codec<V>::pack(I->second, w);
+      }
+    }
+  };
+
+  /**
+     The Type of a described class, for use where a Type is wanted,
+     such as in the memberType of a class with Object<T> hooks.
+   */
+
+  template<class T> class Described : public Type {
+  public:
+    JSON::Value::type getType() {
+      return JSON::Value::object;
+    }
+    bool fill(JSON::Value *v, void *ret,
+	      JSON::ErrFunc *err, void *errData) {
+      return Codec<T>::fill(v, (T *)ret, err, errData);
+    }
+    bool read(JSON::Reader *r, void *ret,
+	      JSON::ErrFunc *err, void *errData) {
+      return Codec<T>::read(r, (T *)ret, err, errData);
+    }
+    using Type::encode;
+    void encode(void *obj, Writer &w) {
+      Codec<T>::encode(*(T *)obj, w);
+    }
+    bool unpack(Unpacker *u, void *ret,
+		JSON::ErrFunc *err, void *errData) {
+      return Codec<T>::unpack(u, (T *)ret, err, errData);
+    }
+    void pack(void *obj, Writer &w) {
+      Codec<T>::pack(*(T *)obj, w);
+    }
+  };
+
+  /**
+     Converts len bytes of JSON data at str into ret, whose type is
+     known to Codec: a described class, or a vector or map of them.
+
+     @return true if the conversion was successful, false otherwise.
+   */
+
+  template<class T> bool decodeJSON(const char *str, size_t len, T *ret,
+				    JSON::ErrFunc *err=NULL, void *errData=NULL) {
+    JSON::Reader r(str, len, err, errData);
+    return Codec<T>::read(&r, ret, err, errData);
+  }
+
+  template<class T> bool decodeJSON(const std::string &str, T *ret,
+				    JSON::ErrFunc *err=NULL, void *errData=NULL) {
+    return decodeJSON(str.data(), str.size(), ret, err, errData);
+  }
+
+  /**
+     Decodes an array of numbers at str into a buffer of the caller's:
+     the size doubles, floats or ints at buf. *n is set to the number
+     decoded. An array with more elements is a type error.
+   */
+
+  template<class N> bool decodeNumbers(const char *str, size_t len, N *buf, size_t size,
+				       size_t *n, JSON::ErrFunc *err=NULL, void *errData=NULL) {
+    JSON::Reader r(str, len, err, errData);
+    return checkType(&r, JSON::Value::array, err, errData) &&
+      readNumbers(&r, buf, size, n, err, errData);
+  }
+
+  /**
+     Appends obj as JSON to w, for a type known to Codec.
+   */
+
+  template<class T> void encodeJSON(const T &obj, Writer &w) {
+    Codec<T>::encode(obj, w);
+  }
+
+  template<class T> std::string encodeJSON(const T &obj) {
+    std::string ret;
+    Writer w(&ret);
+    Codec<T>::encode(obj, w);
+    return ret;
+  }
+
+  /**
+     Converts size bytes of MessagePack data at data into ret, whose
+     type is known to Codec.
+   */
+
+  template<class T> bool decodeMsgPack(const char *data, size_t size, T *ret,
+				       JSON::ErrFunc *err=NULL, void *errData=NULL) {
+    Unpacker u(data, size, err, errData);
+    return Codec<T>::unpack(&u, ret, err, errData);
+  }
+
+  /**
+     Appends obj as MessagePack to w, for a type known to Codec.
+   */
+
+  template<class T> void encodeMsgPack(const T &obj, Writer &w) {
+    Codec<T>::pack(obj, w);
+  }
+
+  template<class T> std::string encodeMsgPack(const T &obj) {
+    std::string ret;
+    Writer w(&ret);
+    Codec<T>::pack(obj, w);
+    return ret;
+  }
+
+  /**
+     Where decodeJSONParallel puts the elements.
+   */
+
+  struct ElementTarget {
+    Type *t;
+    char *base;
+    size_t stride;
+    std::vector<size_t> *first;
+  };
+
+  void decodeElements(void *target, size_t index, JSON::Record *record);
+  void reportError(const std::string &msg, JSON::ErrFunc *err, void *errData);
+
+  /**
+     Like decodeJSON with an Array<T> of element type t, but the
+     elements of a large array are decoded on several threads, straight
+     into their places in ret. T may not be bool.
+
+     @threads The number of threads to use, or 0 for one per processor
+   */
+
+  template<class T> bool decodeJSONParallel(const char *str, size_t len, Type *t,
+					    std::vector<T> *ret,
+					    JSON::ErrFunc *err=NULL, void *errData=NULL,
+					    int threads=0) {
+    std::vector<JSON::Record> chunks;
+    std::vector<size_t> first;
+    if (threads!=1 &&
+	JSON::splitArray(str, len, threads>0 ? 4*threads : 0, &chunks, &first) &&
+	chunks.size()>1) {
+      ret->clear();
+      ret->resize(first.back());
+      ElementTarget target;
+      target.t=t;
+      target.base=(char *)&(*ret)[0];
+      target.stride=sizeof(T);
+      target.first=&first;
+      JSON::forEachRecord(&chunks, decodeElements, &target, threads);
+      size_t i;
+      for (i=0; i<chunks.size(); i++)
+	if (!chunks[i].error.empty()) {
+	  reportError(chunks[i].error, err, errData);
+	  return false;
+	}
+      return true;
+    }
+    Array<T> a(t);
+    return decodeJSON(str, len, &a, ret, err, errData);
+  }
+
   extern NumberClass *Number;
   extern StringClass *String;
   extern BoolClass *Bool;
@@ -0,0 +1,742 @@
+/*
+
+Copyright (c) 2013, Svein Berge
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL SVEIN BERGE BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+  Measures the throughput of JSON::decodeJSON, JSONSchema::decodeJSON
+  and JSONSchema::encodeJSON on generated corpora. The corpora are the
+  same on every run, so that the numbers of two versions compare.
+
+  Usage: jsonbench [seconds per measurement] [corpus...]
+         jsonbench -a [corpus...]
+
+  With -a, the decoders are not timed. Instead every allocation they
+  make is counted, with the function that made it, and the allocations
+  per document, the bytes live at the peak, and the functions that
+  allocate the most are reported. -a needs glibc's backtrace and
+  addr2line, and is only built on Linux.
+*/
+
+#include "JSONschema.h"
+#include <algorithm>
+#include <iostream>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef __linux__
+#define ALLOC_TRACKING
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <unistd.h>
+#endif
+
+using namespace JSONSchema;
+using namespace std;
+
+#ifdef ALLOC_TRACKING
+
+/*
+  Allocation tracking. operator new is replaced with one that, while
+  tracking is on, records the stack of each allocation in a table of
+  its own, so that the tracking itself does not allocate, and keeps
+  count of the bytes live. The stacks are turned into function names
+  only for the report.
+
+  The blocks that were counted are kept in a table of their own too,
+  so that only they are taken off the live bytes when they are freed:
+  not what was allocated before tracking started, nor what the
+  tracking allocated itself.
+*/
+
+#define STACK_DEPTH 10
+#define SITES 4096
+#define BLOCKS (1<<20)
+
+struct Site {
+  void *frames[STACK_DEPTH];
+  int depth;
+  size_t count;
+  size_t bytes;
+};
+
+struct Block {
+  void *p;
+  size_t n;
+};
+
+static Site sites[SITES];
+static Block blocks[BLOCKS];
+static size_t nblocks;
+static bool tracking;
+static bool inTracker;
+static bool overflow;
+static size_t allocations, allocatedBytes;
+static long long live, peak;
+
+static size_t blockSlot(void *p) {
+  return ((size_t)p>>4)*2654435761u & (BLOCKS-1);
+}
+
+// Linear probing, kept at most half full
+static void addBlock(void *p, size_t n) {
+  if (nblocks>=BLOCKS/2) {
+    overflow=true;
+    return;
+  }
+  size_t i=blockSlot(p);
+  while (blocks[i].p)
+    i=(i+1)&(BLOCKS-1);
+  blocks[i].p=p;
+  blocks[i].n=n;
+  nblocks++;
+  live+=n;
+  if (live>peak)
+    peak=live;
+}
+
+static void removeBlock(void *p) {
+  size_t i, j, k;
+  for (i=blockSlot(p); blocks[i].p!=p; i=(i+1)&(BLOCKS-1))
+    if (!blocks[i].p)
+      return;
+  live-=blocks[i].n;
+  nblocks--;
+  // Move back the entries that probed past the hole
+  for (j=i; ; ) {
+    j=(j+1)&(BLOCKS-1);
+    if (!blocks[j].p)
+      break;
+    k=blockSlot(blocks[j].p);
+    if (i<=j ? i<k && k<=j : i<k || k<=j)
+      continue;
+    blocks[i]=blocks[j];
+    i=j;
+  }
+  blocks[i].p=NULL;
+}
+
+static void trackAlloc(void *p, size_t n) {
+  if (!tracking || inTracker)
+    return;
+  inTracker=true;
+  void *frames[STACK_DEPTH];
+  int depth=backtrace(frames, STACK_DEPTH);
+  unsigned h=2166136261u;
+  int i;
+  for (i=0; i<depth; i++)
+    h=(h^(unsigned)(size_t)frames[i])*16777619u;
+  // Open addressing; a full table lumps the rest into the last slot
+  unsigned j=h%SITES, tries;
+  for (tries=0; tries<SITES; tries++, j=(j+1)%SITES) {
+    Site &site=sites[j];
+    if (!site.depth) {
+      memcpy(site.frames, frames, depth*sizeof(void *));
+      site.depth=depth;
+      break;
+    }
+    if (site.depth==depth && !memcmp(site.frames, frames, depth*sizeof(void *)))
+      break;
+  }
+  sites[j].count++;
+  sites[j].bytes+=n;
+  allocations++;
+  allocatedBytes+=n;
+  addBlock(p, n);
+  inTracker=false;
+}
+
+void *operator new(size_t n) {
+  void *p=malloc(n ? n : 1);
+  if (!p)
+    throw std::bad_alloc();
+  trackAlloc(p, n);
+  return p;
+}
+
+void *operator new[](size_t n) {
+  return operator new(n);
+}
+
+void operator delete(void *p) throw() {
+  if (tracking && p && !inTracker)
+    removeBlock(p);
+  free(p);
+}
+
+void operator delete[](void *p) throw() {
+  operator delete(p);
+}
+
+static void startTracking() {
+  memset(sites, 0, sizeof(sites));
+  if (nblocks)
+    memset(blocks, 0, sizeof(blocks));
+  nblocks=0;
+  overflow=false;
+  allocations=allocatedBytes=0;
+  live=peak=0;
+  tracking=true;
+}
+
+// The name of the function each address is in
+static void symbolize(const vector<void *> &addrs, map<void *, string> *names) {
+  char exe[1024];
+  ssize_t n=readlink("/proc/self/exe", exe, sizeof(exe)-1);
+  exe[n>0 ? n : 0]=0;
+  string cmd="addr2line -f -C -e ";
+  cmd+=exe;
+  vector<void *> local;
+  size_t i;
+  char buf[4096];
+  for (i=0; i<addrs.size(); i++) {
+    Dl_info info;
+    if (!dladdr(addrs[i], &info)) {
+      (*names)[addrs[i]]="?";
+    } else if ((info.dli_fname && !strcmp(info.dli_fname, exe)) || !info.dli_sname) {
+      // Static functions are only in the symbol table of the file.
+      // The return address is after the call, so look one back
+      sprintf(buf, " %#lx", (unsigned long)((char *)addrs[i]-(char *)info.dli_fbase-1));
+      cmd+=buf;
+      local.push_back(addrs[i]);
+    } else {
+      int status;
+      char *d=abi::__cxa_demangle(info.dli_sname, NULL, NULL, &status);
+      (*names)[addrs[i]]=d ? d : info.dli_sname;
+      free(d);
+    }
+  }
+  if (local.empty())
+    return;
+  FILE *f=popen(cmd.c_str(), "r");
+  for (i=0; i<local.size(); i++) {
+    string name="?";
+    if (f && fgets(buf, sizeof(buf), f)) {
+      buf[strcspn(buf, "\n")]=0;
+      name=buf;
+      if (!fgets(buf, sizeof(buf), f)) // file:line
+        break;
+    }
+    (*names)[local[i]]=name;
+  }
+  if (f)
+    pclose(f);
+}
+
+// The allocator, the standard library and the tracking itself are
+// passed through to the function that called them
+static bool passThrough(const string &name) {
+  static const char *prefixes[]={
+    "operator new", "trackAlloc", "std::", "void std::", "__gnu_cxx::",
+    "JSON::Allocator", "?"
+  };
+  size_t i;
+  for (i=0; i<sizeof(prefixes)/sizeof(prefixes[0]); i++)
+    if (!name.compare(0, strlen(prefixes[i]), prefixes[i]))
+      return true;
+  return false;
+}
+
+struct SiteTotal {
+  string name;
+  size_t count;
+  size_t bytes;
+
+  SiteTotal(): count(0), bytes(0) {}
+
+  bool operator<(const SiteTotal &o) const {
+    return count>o.count;
+  }
+};
+
+// Prints the functions that allocated the most, per document
+static void reportSites(size_t docs) {
+  vector<void *> addrs;
+  map<void *, string> names;
+  map<string, SiteTotal> totals;
+  size_t i;
+  int j;
+  for (i=0; i<SITES; i++)
+    for (j=0; j<sites[i].depth; j++)
+      addrs.push_back(sites[i].frames[j]);
+  sort(addrs.begin(), addrs.end());
+  addrs.erase(unique(addrs.begin(), addrs.end()), addrs.end());
+  symbolize(addrs, &names);
+  for (i=0; i<SITES; i++) {
+    if (!sites[i].depth)
+      continue;
+    string name="?";
+    for (j=0; j<sites[i].depth; j++) {
+      if (!passThrough(names[sites[i].frames[j]])) {
+        name=names[sites[i].frames[j]];
+        break;
+      }
+    }
+    // The parameters make the names too long to read
+    size_t paren=name.find('(');
+    if (paren!=string::npos && paren>0)
+      name.resize(paren);
+    SiteTotal &t=totals[name];
+    t.name=name;
+    t.count+=sites[i].count;
+    t.bytes+=sites[i].bytes;
+  }
+  vector<SiteTotal> sorted;
+  map<string, SiteTotal>::iterator I;
+  for (I=totals.begin(); I!=totals.end(); ++I)
+    sorted.push_back(I->second);
+  sort(sorted.begin(), sorted.end());
+  for (i=0; i<sorted.size() && i<8; i++) {
+    string name=sorted[i].name;
+    if (name.size()>60)
+      name=name.substr(0, 57)+"...";
+    printf("    %8.1f allocs %10.0f bytes  %s\n",
+	   (double)sorted[i].count/docs, (double)sorted[i].bytes/docs,
+	   name.c_str());
+  }
+}
+
+#endif
+
+// A fixed generator, so that the corpora do not depend on the C library
+static unsigned long long state=1;
+
+static unsigned rnd(unsigned n) {
+  state=state*6364136223846793005ULL+1442695040888963407ULL;
+  return (unsigned)(state>>33)%n;
+}
+
+static double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec+ts.tv_nsec*1e-9;
+}
+
+static void appendNumber(string &s, double d) {
+  char buf[32];
+  s.append(buf, JSON::formatNumber(buf, d));
+}
+
+static double randomNumber() {
+  switch (rnd(4)) {
+  case 0: return rnd(100000);
+  case 1: return rnd(2000000)/1000.0-1000;
+  case 2: return (rnd(1000000)+1)*1e-9*rnd(1000);
+  default: return (double)rnd(1000000)*rnd(1000000)*1e7;
+  }
+}
+
+static const char *words[]={
+  "alpha", "bravo", "charlie", "delta", "echo", "foxtrot", "golf",
+  "hotel", "india", "juliett", "kilo", "lima", "mike", "november"
+};
+
+static const char *escapes[]={
+  "\\\"", "\\\\", "\\n", "\\t", "\\/", "\\u00e9", "\\ud83d\\ude00"
+};
+
+static void appendText(string &s, int nwords, bool escaped) {
+  int i;
+  s+='"';
+  for (i=0; i<nwords; i++) {
+    if (i)
+      s+=' ';
+    s+=words[rnd(sizeof(words)/sizeof(words[0]))];
+    if (escaped && !rnd(3))
+      s+=escapes[rnd(sizeof(escapes)/sizeof(escapes[0]))];
+  }
+  s+='"';
+}
+
+/*
+  The schemas. Numbers is used for both the numeric and the relaxed
+  corpus.
+*/
+
+class Numbers {
+public:
+  static string memberName[];
+  static Type *memberType[];
+  void *member(int n) {
+    switch (n) {
+    case 0: return &id;
+    case 1: return &x;
+    case 2: return &y;
+    default: return &values;
+    }
+  }
+  bool unfreeze(JSON::ErrFunc *err, void *errData) {return true;}
+  void freeze() {}
+
+  double id, x, y;
+  vector<double> values;
+};
+
+string Numbers::memberName[]={"id", "x", "y", "values"};
+Type *Numbers::memberType[]={Number, Number, Number, NumberArray};
+
+class Strings {
+public:
+  static string memberName[];
+  static Type *memberType[];
+  void *member(int n) {
+    switch (n) {
+    case 0: return &name;
+    case 1: return &text;
+    default: return &tags;
+    }
+  }
+  bool unfreeze(JSON::ErrFunc *err, void *errData) {return true;}
+  void freeze() {}
+
+  string name, text;
+  vector<string> tags;
+};
+
+string Strings::memberName[]={"name", "text", "tags"};
+Type *Strings::memberType[]={String, String, StringArray};
+
+class Node {
+public:
+  static string memberName[];
+  static Type *memberType[];
+  void *member(int n) {
+    return n ? (void *)&children : (void *)&value;
+  }
+  bool unfreeze(JSON::ErrFunc *err, void *errData) {return true;}
+  void freeze() {}
+
+  double value;
+  vector<Node> children;
+};
+
+string Node::memberName[]={"value", "children"};
+Type *Node::memberType[]={Number, ObjectArray(Node)};
+
+#define WIDE 100
+
+// WIDE numbers, then WIDE strings, named at startup
+class Wide {
+public:
+  static string memberName[2*WIDE];
+  static Type *memberType[2*WIDE];
+  void *member(int n) {
+    return n<WIDE ? (void *)&number[n] : (void *)&text[n-WIDE];
+  }
+  bool unfreeze(JSON::ErrFunc *err, void *errData) {return true;}
+  void freeze() {}
+
+  double number[WIDE];
+  string text[WIDE];
+};
+
+string Wide::memberName[2*WIDE];
+Type *Wide::memberType[2*WIDE];
+
+/*
+  The corpora, of about the same size each.
+*/
+
+#define CORPUS_BYTES (4<<20)
+
+struct Corpus {
+  const char *name;
+  vector<string> docs;
+  size_t bytes;
+};
+
+static void add(Corpus *c, const string &doc) {
+  c->docs.push_back(doc);
+  c->bytes+=doc.size();
+}
+
+static void numeric(Corpus *c) {
+  int i;
+  while (c->bytes<CORPUS_BYTES) {
+    string s="{\"id\":";
+    appendNumber(s, c->docs.size());
+    s+=",\"x\":";
+    appendNumber(s, randomNumber());
+    s+=",\"y\":";
+    appendNumber(s, randomNumber());
+    s+=",\"values\":[";
+    for (i=0; i<64; i++) {
+      if (i)
+        s+=',';
+      appendNumber(s, randomNumber());
+    }
+    s+="]}";
+    add(c, s);
+  }
+}
+
+static void strings(Corpus *c) {
+  int i;
+  while (c->bytes<CORPUS_BYTES) {
+    string s="{\"name\":";
+    appendText(s, 2, false);
+    s+=",\"text\":";
+    appendText(s, 40+rnd(40), true);
+    s+=",\"tags\":[";
+    for (i=0; i<16; i++) {
+      if (i)
+        s+=',';
+      appendText(s, 1, i%4==0);
+    }
+    s+="]}";
+    add(c, s);
+  }
+}
+
+static void nested(Corpus *c) {
+  int i, depth;
+  while (c->bytes<CORPUS_BYTES) {
+    string s;
+    depth=50+rnd(50);
+    for (i=0; i<depth; i++) {
+      s+="{\"value\":";
+      appendNumber(s, i);
+      s+=",\"children\":[";
+    }
+    s+="{\"value\":0,\"children\":[]}";
+    for (i=0; i<depth; i++)
+      s+="]}";
+    add(c, s);
+  }
+}
+
+static void wide(Corpus *c) {
+  int i;
+  while (c->bytes<CORPUS_BYTES) {
+    string s="{";
+    for (i=0; i<2*WIDE; i++) {
+      // The members come in an order of their own
+      int n=(i*37)%(2*WIDE);
+      if (i)
+        s+=',';
+      s+='"'+Wide::memberName[n]+"\":";
+      if (n<WIDE)
+        appendNumber(s, randomNumber());
+      else
+        appendText(s, 1+rnd(3), false);
+    }
+    s+='}';
+    add(c, s);
+  }
+}
+
+static void relaxed(Corpus *c) {
+  int i;
+  while (c->bytes<CORPUS_BYTES) {
+    string s="// record\n{\n  id: ";
+    appendNumber(s, c->docs.size());
+    s+=",  # the key\n  x: ";
+    appendNumber(s, randomNumber());
+    s+=", /* and the position */ y: ";
+    appendNumber(s, randomNumber());
+    s+=",\n  values: [ // samples\n";
+    for (i=0; i<64; i++) {
+      s+="    ";
+      appendNumber(s, randomNumber());
+      s+=i<63 ? ",\n" : "\n";
+    }
+    s+="  ]\n}\n";
+    add(c, s);
+  }
+}
+
+/*
+  The measurements
+*/
+
+static size_t sink;
+
+template<class T> class Suite {
+public:
+  Suite(Corpus *ac, Type *at, double aminTime):
+  c(ac), t(at), minTime(aminTime) {}
+
+  void run() {
+    printf("%s: %lu documents, %.1f MB\n", c->name,
+	   (unsigned long)c->docs.size(), c->bytes/1e6);
+#ifdef ALLOC_TRACKING
+    if (minTime<0) {
+      count("JSON::decodeJSON", &Suite::domDoc);
+      count("JSONSchema::decodeJSON", &Suite::decodeDoc);
+      return;
+    }
+#endif
+    measure("JSON::decodeJSON", &Suite::dom, c->bytes);
+    measure("JSONSchema::decodeJSON", &Suite::decode, c->bytes);
+    objs.resize(c->docs.size());
+    size_t i;
+    for (i=0; i<c->docs.size(); i++)
+      decodeJSON(c->docs[i].data(), c->docs[i].size(), t, &objs[i]);
+    measure("JSONSchema::encodeJSON", &Suite::encode, encode());
+  }
+
+private:
+  Corpus *c;
+  Type *t;
+  double minTime;
+  vector<T> objs;
+  Writer w;
+
+  // Runs f over the corpus until minTime has passed
+  void measure(const char *what, size_t (Suite::*f)(), size_t bytes) {
+    double start=now(), elapsed;
+    long passes=0;
+    do {
+      (this->*f)();
+      passes++;
+      elapsed=now()-start;
+    } while (elapsed<minTime);
+    printf("  %-24s %8.1f MB/s %10.0f ns/doc\n", what,
+	   bytes*passes/elapsed/1e6, elapsed/passes/c->docs.size()*1e9);
+  }
+
+#ifdef ALLOC_TRACKING
+  // Decodes each document with f, counting what is allocated
+  void count(const char *what, void (Suite::*f)(size_t)) {
+    size_t i;
+    long long most=0;
+    // Leave out what is built once, on first use of a schema
+    (this->*f)(0);
+    startTracking();
+    for (i=0; i<c->docs.size(); i++) {
+      long long before=live;
+      peak=live;
+      (this->*f)(i);
+      if (peak-before>most)
+        most=peak-before;
+    }
+    tracking=false;
+    sink+=allocations;
+    printf("  %-24s %8.1f allocs/doc %10.0f bytes/doc %10lld peak bytes\n", what,
+	   (double)allocations/c->docs.size(),
+	   (double)allocatedBytes/c->docs.size(), most);
+    if (overflow)
+      printf("  (too many blocks live to follow; the peak is low)\n");
+    reportSites(c->docs.size());
+  }
+#endif
+
+  void domDoc(size_t i) {
+    JSON::Value *v=JSON::decodeJSON(c->docs[i].data(), c->docs[i].size());
+    if (!v)
+      exit(1);
+    sink+=v->getType();
+    delete v;
+  }
+
+  void decodeDoc(size_t i) {
+    T obj;
+    if (!decodeJSON(c->docs[i].data(), c->docs[i].size(), t, &obj))
+      exit(1);
+  }
+
+  size_t dom() {
+    size_t i;
+    for (i=0; i<c->docs.size(); i++)
+      domDoc(i);
+    return c->bytes;
+  }
+
+  size_t decode() {
+    size_t i;
+    for (i=0; i<c->docs.size(); i++)
+      decodeDoc(i);
+    return c->bytes;
+  }
+
+  size_t encode() {
+    size_t i, bytes=0;
+    for (i=0; i<objs.size(); i++) {
+      w.clear();
+      encodeJSON(t, &objs[i], w);
+      bytes+=w.length();
+    }
+    sink+=bytes;
+    return bytes;
+  }
+};
+
+static bool selected(int argc, char **argv, const char *name) {
+  int i;
+  if (argc<3)
+    return true;
+  for (i=2; i<argc; i++)
+    if (!strcmp(argv[i], name))
+      return true;
+  return false;
+}
+
+int main(int argc, char **argv) {
+  // A negative time selects counting
+  double minTime=argc>1 ? (strcmp(argv[1], "-a") ? atof(argv[1]) : -1) : 0.5;
+  int i;
+#ifndef ALLOC_TRACKING
+  if (minTime<0) {
+    fprintf(stderr, "jsonbench: -a is only supported on Linux\n");
+    return 1;
+  }
+#endif
+  char buf[32];
+  for (i=0; i<WIDE; i++) {
+    sprintf(buf, "number_%d", i);
+    Wide::memberName[i]=buf;
+    Wide::memberType[i]=Number;
+    sprintf(buf, "text_%d", i);
+    Wide::memberName[WIDE+i]=buf;
+    Wide::memberType[WIDE+i]=String;
+  }
+
+  Corpus c[5]={
+    {"numeric"}, {"strings"}, {"nested"}, {"wide"}, {"relaxed"}
+  };
+  numeric(&c[0]);
+  strings(&c[1]);
+  nested(&c[2]);
+  wide(&c[3]);
+  relaxed(&c[4]);
+
+  if (selected(argc, argv, c[0].name))
+    Suite<Numbers>(&c[0], new Object<Numbers>, minTime).run();
+  if (selected(argc, argv, c[1].name))
+    Suite<Strings>(&c[1], new Object<Strings>, minTime).run();
+  if (selected(argc, argv, c[2].name))
+    Suite<Node>(&c[2], new Object<Node>, minTime).run();
+  if (selected(argc, argv, c[3].name))
+    Suite<Wide>(&c[3], new Object<Wide>, minTime).run();
+  if (selected(argc, argv, c[4].name))
+    Suite<Numbers>(&c[4], new Object<Numbers>, minTime).run();
+
+  return sink==0;
+}
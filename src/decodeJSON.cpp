@@ -26,21 +26,134 @@ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
 SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
+#include <errno.h>
+#include <locale.h>
 #include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include <unistd.h>
+#endif
 #include "decodeJSON.h"
 #include <iomanip>
 #include <iostream>
+#include <new>
+
+#if !defined(JSON_NO_SIMD) && defined(__GNUC__) && defined(__SSE2__) && \
+  (defined(__x86_64__) || defined(__i386__))
+#define JSON_SIMD
+#include <immintrin.h>
+#endif
 
 using namespace std;
 
 namespace JSON {
   
+  Arena::Arena(size_t achunksize):
+  chunks(NULL),
+  p(NULL),
+  end(NULL),
+  chunksize(achunksize) {
+  }
+  
+  Arena::~Arena() {
+    clear();
+  }
+  
+  void Arena::clear() {
+    while (chunks) {
+      Chunk *next=chunks->next;
+      ::operator delete(chunks);
+      chunks=next;
+    }
+    p=end=NULL;
+  }
+  
+  void Arena::reset() {
+    // Without a current chunk there is nothing worth keeping
+    if (!p) {
+      clear();
+      return;
+    }
+    while (chunks->next) {
+      Chunk *next=chunks->next->next;
+      ::operator delete(chunks->next);
+      chunks->next=next;
+    }
+    p=(char *)(chunks+1);
+  }
+  
+  void Arena::adopt(Arena *other) {
+    Chunk *last=other->chunks;
+    if (!last)
+      return;
+    while (last->next)
+      last=last->next;
+    // Behind the current chunk, which is still being allocated from
+    if (chunks) {
+      last->next=chunks->next;
+      chunks->next=other->chunks;
+    } else {
+      chunks=other->chunks;
+    }
+    other->chunks=NULL;
+    other->p=other->end=NULL;
+  }
+  
+  void *Arena::grow(size_t n) {
+    static const size_t maxchunk=16<<20;
+    Chunk *c;
+    
+    if (n>chunksize/4) {
+      // Large blocks get a chunk of their own, so that the rest of the
+      // current chunk is not wasted
+      c=(Chunk *)::operator new(sizeof(Chunk)+n);
+      if (chunks) {
+        c->next=chunks->next;
+        chunks->next=c;
+      } else {
+        c->next=NULL;
+        chunks=c;
+      }
+      return c+1;
+    }
+    
+    c=(Chunk *)::operator new(sizeof(Chunk)+chunksize);
+    c->next=chunks;
+    chunks=c;
+    p=(char *)(c+1);
+    end=p+chunksize;
+    if (chunksize<maxchunk)
+      chunksize*=2;
+    
+    void *ret=p;
+    p+=n;
+    return ret;
+  }
+  
+  static void print_string(ostream &o, const jschar *s, size_t len) {
+    o << '"';
+    size_t i;
+    for (i=0; i<len; i++) {
+      if (s[i]>=' ' && s[i]<128 && s[i]!='"')
+        o << s[i];
+      else
+        o << "\\x" << hex << setw(2) << (int)s[i];
+    }
+    o << '"';
+  }
+  
   void Object::print(ostream &o) {
     o << "{";
-    map<std::string, Value *>::iterator I;
+    Members::iterator I;
     for (I=value.begin(); I!=value.end(); ) {
-      String s(I->first, 0);
-      s.print(o);
+      print_string(o, I->first.data(), I->first.size());
       o << ":";
       I->second->print(o);
       ++I;
@@ -62,20 +175,50 @@ namespace JSON {
     o << "]";
   }
   
+  Number::Number(unsigned long long amagnitude, bool anegative, int lineno):
+  Value(lineno),
+  integer(true),
+  negative(anegative),
+  magnitude(amagnitude) {
+    value=negative ? -(double)magnitude : (double)magnitude;
+  }
+  
+  bool Number::getInt64(long long *ret) {
+    if (!integer)
+      return false;
+    if (negative) {
+      if (magnitude>(1ULL<<63))
+        return false;
+      *ret=(long long)(0-magnitude);
+    } else {
+      if (magnitude>(~0ULL>>1))
+        return false;
+      *ret=(long long)magnitude;
+    }
+    return true;
+  }
+  
+  bool Number::getUInt64(unsigned long long *ret) {
+    if (!integer || (negative && magnitude))
+      return false;
+    *ret=magnitude;
+    return true;
+  }
+  
   void Number::print(ostream &o) {
-    o << number;
+    char buf[32];
+    if (integer) {
+      if (negative)
+        o << '-';
+      o << magnitude;
+      return;
+    }
+    formatNumber(buf, value);
+    o << buf;
   }
   
   void String::print(ostream &o) {
-    o << '"';
-    int i;
-    for (i=0; i<value.size(); i++) {
-      if (value[i]>=' ' && value[i]<128 && value[i]!='"')
-        o << value[i];
-      else
-        o << "\\x" << hex << setw(2) << (int)value[i];
-    }
-    o << '"';
+    print_string(o, value.data(), value.size());
   }
   
   void Boolean::print(ostream &o) {
@@ -90,20 +233,564 @@ namespace JSON {
   }
   
   Object::~Object() {
-    map<std::string, Value *>::iterator I;
+    Members::iterator I;
     for (I=value.begin(); I!=value.end(); ++I) {
       delete I->second;
     }
   }
   
-  struct JSON {
+  Members::~Members() {
+    if (arena)
+      return;
+    delete[] (char *)data;
+    delete[] index;
+    while (keys) {
+      jschar *next;
+      memcpy(&next, keys, sizeof(next));
+      delete[] keys;
+      keys=next;
+    }
+  }
+  
+  unsigned Members::hash(const Str &key) {
+    // FNV-1a
+    unsigned h=2166136261u;
+    size_t i;
+    for (i=0; i<key.size(); i++)
+      h=(h^(unsigned char)key[i])*16777619u;
+    return h;
+  }
+  
+  void Members::addToIndex(size_t i) {
+    size_t mask=indexsize-1;
+    size_t j=hash(data[i].first)&mask;
+    while (index[j])
+      j=(j+1)&mask;
+    index[j]=(unsigned)i+1;
+  }
+  
+  void Members::buildIndex() {
+    size_t size=16;
+    while (size<capacity*2)
+      size*=2;
+    if (!arena)
+      delete[] index;
+    if (arena)
+      index=(unsigned *)arena->alloc(size*sizeof(unsigned));
+    else
+      index=new unsigned[size];
+    memset(index, 0, size*sizeof(unsigned));
+    indexsize=size;
+    size_t i;
+    for (i=0; i<n; i++)
+      addToIndex(i);
+  }
+  
+  void Members::reserve(size_t size) {
+    if (size<=capacity)
+      return;
+    value_type *d;
+    if (arena)
+      d=(value_type *)arena->alloc(size*sizeof(value_type));
+    else
+      d=(value_type *)new char[size*sizeof(value_type)];
+    // Str and Value * are trivially copyable
+    if (n)
+      memcpy((void *)d, data, n*sizeof(value_type));
+    if (!arena)
+      delete[] (char *)data;
+    data=d;
+    capacity=size;
+    if (index && indexsize<capacity*2)
+      buildIndex();
+  }
+  
+  Members::iterator Members::find(const Str &key) {
+    size_t i;
+    
+    if (n<=indexThreshold) {
+      for (i=0; i<n; i++) {
+        if (data[i].first==key)
+          return data+i;
+      }
+      return end();
+    }
+    
+    if (!index)
+      buildIndex();
+    size_t mask=indexsize-1;
+    for (i=hash(key)&mask; index[i]; i=(i+1)&mask) {
+      if (data[index[i]-1].first==key)
+        return data+index[i]-1;
+    }
+    return end();
+  }
+  
+  std::pair<Members::iterator, bool> Members::insert(const value_type &v) {
+    iterator I=find(v.first);
+    if (I!=end())
+      return std::make_pair(I, false);
+    if (n==capacity)
+      reserve(capacity ? capacity*2 : 4);
+    new (data+n) value_type(v);
+    n++;
+    if (index)
+      addToIndex(n-1);
+    return std::make_pair(data+n-1, true);
+  }
+  
+  Value *&Members::operator[](const Str &key) {
+    iterator I=find(key);
+    if (I!=end())
+      return I->second;
+    return insert(value_type(copyKey(key.data(), key.size()), NULL)).first->second;
+  }
+  
+  Str Members::copyKey(const jschar *s, size_t len) {
     jschar *p;
-    jschar *start;
+    
+    if (arena) {
+      p=(jschar *)arena->alloc(len+1);
+    } else {
+      jschar *block=new jschar[sizeof(jschar *)+len+1];
+      memcpy(block, &keys, sizeof(keys));
+      keys=block;
+      p=block+sizeof(jschar *);
+    }
+    memcpy(p, s, len);
+    p[len]=0;
+    return Str(p, len);
+  }
+  
+  String::String(std::string s, int lineno):
+  Value(lineno),
+  copy(new jschar[s.size()+1]) {
+    memcpy(copy, s.c_str(), s.size()+1);
+    value=Str(copy, s.size());
+  }
+  
+  String::String(const jschar *s, size_t len, int lineno, Arena *arena):
+  Value(lineno),
+  copy(NULL) {
+    jschar *p;
+    if (arena)
+      p=(jschar *)arena->alloc(len+1);
+    else
+      p=copy=new jschar[len+1];
+    memcpy(p, s, len);
+    p[len]=0;
+    value=Str(p, len);
+  }
+  
+  String::~String() {
+    delete[] copy;
+  }
+  
+  /*
+    Scanning kernels. Each comes in a scalar version and, on x86, in
+    SSE2, AVX2 and AVX-512 versions that look at 16, 32 or 64 bytes at
+    a time. The widest one the CPU supports is chosen at run time.
+    Newlines that are skipped are counted with popcount, so that line
+    numbers stay exact.
+  */
+  
+  struct Kernels {
+    // First '"', '\\' or NUL in [p, end), or end
+    const jschar *(*string)(const jschar *p, const jschar *end);
+    // First non-whitespace character in [p, end), or end
+    const jschar *(*space)(const jschar *p, const jschar *end, int *lines);
+    // First c in [p, end), or end
+    const jschar *(*find)(const jschar *p, const jschar *end, jschar c, int *lines);
+    // First '"', '\\' or control character in [p, end), or end
+    const jschar *(*escape)(const jschar *p, const jschar *end);
+  };
+  
+  static const jschar *scan_string_scalar(const jschar *p, const jschar *end) {
+    while (p<end && *p!='"' && *p!='\\' && *p)
+      p++;
+    return p;
+  }
+  
+  static const jschar *scan_space_scalar(const jschar *p, const jschar *end, int *lines) {
+    for (; p<end; p++) {
+      switch (*p) {
+        case '\n':
+          (*lines)++; // fall through
+        case ' ':
+        case '\t':
+        case '\r':
+          break;
+        default:
+          return p;
+      }
+    }
+    return p;
+  }
+  
+  static const jschar *scan_find_scalar(const jschar *p, const jschar *end, jschar c, int *lines) {
+    for (; p<end && *p!=c; p++) {
+      if (*p=='\n')
+        (*lines)++;
+    }
+    return p;
+  }
+  
+  static const jschar *scan_escape_scalar(const jschar *p, const jschar *end) {
+    while (p<end && *p!='"' && *p!='\\' && (unsigned char)*p>=0x20)
+      p++;
+    return p;
+  }
+  
+#ifdef JSON_SIMD
+  
+  static const jschar *scan_string_sse2(const jschar *p, const jschar *end) {
+    const __m128i quote=_mm_set1_epi8('"');
+    const __m128i backslash=_mm_set1_epi8('\\');
+    const __m128i zero=_mm_setzero_si128();
+    for (; p+16<=end; p+=16) {
+      __m128i v=_mm_loadu_si128((const __m128i *)p);
+      unsigned m=_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, quote),
+                                                              _mm_cmpeq_epi8(v, backslash)),
+                                                 _mm_cmpeq_epi8(v, zero)));
+      if (m)
+        return p+__builtin_ctz(m);
+    }
+    return scan_string_scalar(p, end);
+  }
+  
+  static const jschar *scan_space_sse2(const jschar *p, const jschar *end, int *lines) {
+    const __m128i space=_mm_set1_epi8(' ');
+    const __m128i tab=_mm_set1_epi8('\t');
+    const __m128i cr=_mm_set1_epi8('\r');
+    const __m128i nl=_mm_set1_epi8('\n');
+    for (; p+16<=end; p+=16) {
+      __m128i v=_mm_loadu_si128((const __m128i *)p);
+      __m128i n=_mm_cmpeq_epi8(v, nl);
+      unsigned ws=_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, space),
+                                                               _mm_cmpeq_epi8(v, tab)),
+                                                  _mm_or_si128(_mm_cmpeq_epi8(v, cr), n)));
+      unsigned newlines=_mm_movemask_epi8(n);
+      if (ws!=0xffff) {
+        int i=__builtin_ctz(~ws);
+        *lines+=__builtin_popcount(newlines & ((1u<<i)-1));
+        return p+i;
+      }
+      *lines+=__builtin_popcount(newlines);
+    }
+    return scan_space_scalar(p, end, lines);
+  }
+  
+  static const jschar *scan_find_sse2(const jschar *p, const jschar *end, jschar c, int *lines) {
+    const __m128i ch=_mm_set1_epi8(c);
+    const __m128i nl=_mm_set1_epi8('\n');
+    for (; p+16<=end; p+=16) {
+      __m128i v=_mm_loadu_si128((const __m128i *)p);
+      unsigned m=_mm_movemask_epi8(_mm_cmpeq_epi8(v, ch));
+      unsigned newlines=_mm_movemask_epi8(_mm_cmpeq_epi8(v, nl));
+      if (m) {
+        int i=__builtin_ctz(m);
+        *lines+=__builtin_popcount(newlines & ((1u<<i)-1));
+        return p+i;
+      }
+      *lines+=__builtin_popcount(newlines);
+    }
+    return scan_find_scalar(p, end, c, lines);
+  }
+  
+  static const jschar *scan_escape_sse2(const jschar *p, const jschar *end) {
+    const __m128i quote=_mm_set1_epi8('"');
+    const __m128i backslash=_mm_set1_epi8('\\');
+    const __m128i control=_mm_set1_epi8(0x1f);
+    for (; p+16<=end; p+=16) {
+      __m128i v=_mm_loadu_si128((const __m128i *)p);
+      // v<=0x1f, unsigned
+      __m128i c=_mm_cmpeq_epi8(_mm_max_epu8(v, control), control);
+      unsigned m=_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, quote),
+                                                              _mm_cmpeq_epi8(v, backslash)), c));
+      if (m)
+        return p+__builtin_ctz(m);
+    }
+    return scan_escape_scalar(p, end);
+  }
+  
+  __attribute__((target("avx2,popcnt,bmi")))
+  static const jschar *scan_string_avx2(const jschar *p, const jschar *end) {
+    const __m256i quote=_mm256_set1_epi8('"');
+    const __m256i backslash=_mm256_set1_epi8('\\');
+    const __m256i zero=_mm256_setzero_si256();
+    for (; p+32<=end; p+=32) {
+      __m256i v=_mm256_loadu_si256((const __m256i *)p);
+      unsigned m=_mm256_movemask_epi8(_mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, quote),
+                                                                       _mm256_cmpeq_epi8(v, backslash)),
+                                                      _mm256_cmpeq_epi8(v, zero)));
+      if (m)
+        return p+__builtin_ctz(m);
+    }
+    // The SSE2 code would stall on the dirty upper halves
+    _mm256_zeroupper();
+    return scan_string_sse2(p, end);
+  }
+  
+  __attribute__((target("avx2,popcnt,bmi")))
+  static const jschar *scan_space_avx2(const jschar *p, const jschar *end, int *lines) {
+    const __m256i space=_mm256_set1_epi8(' ');
+    const __m256i tab=_mm256_set1_epi8('\t');
+    const __m256i cr=_mm256_set1_epi8('\r');
+    const __m256i nl=_mm256_set1_epi8('\n');
+    for (; p+32<=end; p+=32) {
+      __m256i v=_mm256_loadu_si256((const __m256i *)p);
+      __m256i n=_mm256_cmpeq_epi8(v, nl);
+      unsigned ws=_mm256_movemask_epi8(_mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, space),
+                                                                        _mm256_cmpeq_epi8(v, tab)),
+                                                       _mm256_or_si256(_mm256_cmpeq_epi8(v, cr), n)));
+      unsigned newlines=_mm256_movemask_epi8(n);
+      if (ws!=0xffffffffu) {
+        int i=__builtin_ctz(~ws);
+        *lines+=__builtin_popcount(newlines & ((1u<<i)-1));
+        return p+i;
+      }
+      *lines+=__builtin_popcount(newlines);
+    }
+    _mm256_zeroupper();
+    return scan_space_sse2(p, end, lines);
+  }
+  
+  __attribute__((target("avx2,popcnt,bmi")))
+  static const jschar *scan_find_avx2(const jschar *p, const jschar *end, jschar c, int *lines) {
+    const __m256i ch=_mm256_set1_epi8(c);
+    const __m256i nl=_mm256_set1_epi8('\n');
+    for (; p+32<=end; p+=32) {
+      __m256i v=_mm256_loadu_si256((const __m256i *)p);
+      unsigned m=_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, ch));
+      unsigned newlines=_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, nl));
+      if (m) {
+        int i=__builtin_ctz(m);
+        *lines+=__builtin_popcount(newlines & ((1u<<i)-1));
+        return p+i;
+      }
+      *lines+=__builtin_popcount(newlines);
+    }
+    _mm256_zeroupper();
+    return scan_find_sse2(p, end, c, lines);
+  }
+  
+  __attribute__((target("avx2,popcnt,bmi")))
+  static const jschar *scan_escape_avx2(const jschar *p, const jschar *end) {
+    const __m256i quote=_mm256_set1_epi8('"');
+    const __m256i backslash=_mm256_set1_epi8('\\');
+    const __m256i control=_mm256_set1_epi8(0x1f);
+    for (; p+32<=end; p+=32) {
+      __m256i v=_mm256_loadu_si256((const __m256i *)p);
+      __m256i c=_mm256_cmpeq_epi8(_mm256_max_epu8(v, control), control);
+      unsigned m=_mm256_movemask_epi8(_mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, quote),
+                                                                       _mm256_cmpeq_epi8(v, backslash)), c));
+      if (m)
+        return p+__builtin_ctz(m);
+    }
+    _mm256_zeroupper();
+    return scan_escape_sse2(p, end);
+  }
+  
+  __attribute__((target("avx512f,avx512bw,popcnt,bmi")))
+  static const jschar *scan_string_avx512(const jschar *p, const jschar *end) {
+    const __m512i quote=_mm512_set1_epi8('"');
+    const __m512i backslash=_mm512_set1_epi8('\\');
+    const __m512i zero=_mm512_setzero_si512();
+    for (; p+64<=end; p+=64) {
+      __m512i v=_mm512_loadu_si512((const void *)p);
+      unsigned long long m=_mm512_cmpeq_epi8_mask(v, quote) |
+        _mm512_cmpeq_epi8_mask(v, backslash) |
+        _mm512_cmpeq_epi8_mask(v, zero);
+      if (m)
+        return p+__builtin_ctzll(m);
+    }
+    return scan_string_avx2(p, end);
+  }
+  
+  __attribute__((target("avx512f,avx512bw,popcnt,bmi")))
+  static const jschar *scan_space_avx512(const jschar *p, const jschar *end, int *lines) {
+    const __m512i space=_mm512_set1_epi8(' ');
+    const __m512i tab=_mm512_set1_epi8('\t');
+    const __m512i cr=_mm512_set1_epi8('\r');
+    const __m512i nl=_mm512_set1_epi8('\n');
+    for (; p+64<=end; p+=64) {
+      __m512i v=_mm512_loadu_si512((const void *)p);
+      unsigned long long newlines=_mm512_cmpeq_epi8_mask(v, nl);
+      unsigned long long ws=_mm512_cmpeq_epi8_mask(v, space) |
+        _mm512_cmpeq_epi8_mask(v, tab) |
+        _mm512_cmpeq_epi8_mask(v, cr) | newlines;
+      if (~ws) {
+        int i=__builtin_ctzll(~ws);
+        *lines+=__builtin_popcountll(newlines & ((1ull<<i)-1));
+        return p+i;
+      }
+      *lines+=__builtin_popcountll(newlines);
+    }
+    return scan_space_avx2(p, end, lines);
+  }
+  
+  __attribute__((target("avx512f,avx512bw,popcnt,bmi")))
+  static const jschar *scan_find_avx512(const jschar *p, const jschar *end, jschar c, int *lines) {
+    const __m512i ch=_mm512_set1_epi8(c);
+    const __m512i nl=_mm512_set1_epi8('\n');
+    for (; p+64<=end; p+=64) {
+      __m512i v=_mm512_loadu_si512((const void *)p);
+      unsigned long long m=_mm512_cmpeq_epi8_mask(v, ch);
+      unsigned long long newlines=_mm512_cmpeq_epi8_mask(v, nl);
+      if (m) {
+        int i=__builtin_ctzll(m);
+        *lines+=__builtin_popcountll(newlines & ((1ull<<i)-1));
+        return p+i;
+      }
+      *lines+=__builtin_popcountll(newlines);
+    }
+    return scan_find_avx2(p, end, c, lines);
+  }
+  
+  __attribute__((target("avx512f,avx512bw,popcnt,bmi")))
+  static const jschar *scan_escape_avx512(const jschar *p, const jschar *end) {
+    const __m512i quote=_mm512_set1_epi8('"');
+    const __m512i backslash=_mm512_set1_epi8('\\');
+    const __m512i space=_mm512_set1_epi8(' ');
+    for (; p+64<=end; p+=64) {
+      __m512i v=_mm512_loadu_si512((const void *)p);
+      unsigned long long m=_mm512_cmpeq_epi8_mask(v, quote) |
+        _mm512_cmpeq_epi8_mask(v, backslash) |
+        _mm512_cmplt_epu8_mask(v, space);
+      if (m)
+        return p+__builtin_ctzll(m);
+    }
+    return scan_escape_avx2(p, end);
+  }
+  
+#endif
+  
+  static Kernels select_kernels() {
+    Kernels k;
+#ifdef JSON_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512bw")) {
+      k.string=scan_string_avx512;
+      k.space=scan_space_avx512;
+      k.find=scan_find_avx512;
+      k.escape=scan_escape_avx512;
+    } else if (__builtin_cpu_supports("avx2")) {
+      k.string=scan_string_avx2;
+      k.space=scan_space_avx2;
+      k.find=scan_find_avx2;
+      k.escape=scan_escape_avx2;
+    } else {
+      k.string=scan_string_sse2;
+      k.space=scan_space_sse2;
+      k.find=scan_find_sse2;
+      k.escape=scan_escape_sse2;
+    }
+#else
+    k.string=scan_string_scalar;
+    k.space=scan_space_scalar;
+    k.find=scan_find_scalar;
+    k.escape=scan_escape_scalar;
+#endif
+    return k;
+  }
+  
+  static const Kernels *kernels() {
+    static const Kernels k=select_kernels();
+    return &k;
+  }
+  
+  const jschar *findEscape(const jschar *p, const jschar *end) {
+    return kernels()->escape(p, end);
+  }
+  
+  struct JSON {
+    const jschar *p;
+    const jschar *start;
+    const jschar *end;
+    jschar *buf;              // writable alias of start, or NULL
     int line_no;
     ErrFunc *err;
     void *errData;
+    Arena *arena;             // NULL: values are allocated with new
+    bool insitu;              // strings refer to buf
+    std::vector<Value *> stack; // elements of the arrays being parsed
+    std::vector<Members::value_type> members; // and of the objects
+    std::vector<jschar> scratch; // unescaped strings from read-only input
+    const Kernels *k;
+#ifdef JSON_STATS
+    Stats *stats;             // NULL if nothing is counted
+    int depth;                // of the containers being parsed
+#endif
   };
   
+  /*
+    Statistics. Without JSON_STATS the macros expand to nothing, and
+    the state has no fields for them.
+  */
+  
+#ifdef JSON_STATS
+#define JSON_COUNT(s, field, n) \
+  do { if ((s)->stats) (s)->stats->field+=(n); } while (0)
+#define JSON_ALLOC(s, size) \
+  do { if ((s)->stats) { (s)->stats->allocations++; (s)->stats->allocatedBytes+=(size); } } while (0)
+#define JSON_DEPTH(s, d) \
+  do { if ((s)->stats && (d)>(s)->stats->maxDepth) (s)->stats->maxDepth=(d); } while (0)
+#define JSON_OPEN(s) do { (s)->depth++; JSON_DEPTH(s, (s)->depth); } while (0)
+#define JSON_CLOSE(s) ((s)->depth--)
+#else
+#define JSON_COUNT(s, field, n) do {} while (0)
+#define JSON_ALLOC(s, size) do {} while (0)
+#define JSON_DEPTH(s, d) do {} while (0)
+#define JSON_OPEN(s) do {} while (0)
+#define JSON_CLOSE(s) ((void)0)
+#endif
+  
+  // A value built by the parser, of the given type and size
+#define JSON_NODE(s, type, size) \
+  do { JSON_COUNT(s, nodes[Value::type], 1); JSON_ALLOC(s, size); } while (0)
+  
+  double Stats::clock() {
+#ifndef _WIN32
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec+ts.tv_nsec*1e-9;
+#else
+    return (double)::clock()/CLOCKS_PER_SEC;
+#endif
+  }
+  
+  /**
+     Returns the character at s->p+n, or 0 at the end of the input.
+   */
+  
+  static inline jschar peek(struct JSON *s, int n=0) {
+    return s->p+n<s->end ? s->p[n] : 0;
+  }
+  
+  /**
+     Skips the whitespace at s->p. Single characters between tokens
+     are the common case; longer runs are left to the kernel.
+   */
+  
+  static inline void skip_space(struct JSON *s) {
+    if (*s->p=='\n')
+      s->line_no++;
+    s->p++;
+    jschar c=peek(s);
+    if (c==' ' || c=='\t' || c=='\r' || c=='\n')
+      s->p=s->k->space(s->p, s->end, &s->line_no);
+  }
+  
+  /**
+     Disposes of a partially built value after an error. Values in an
+     arena are reclaimed with the arena.
+   */
+  
+  static inline void release(struct JSON *s, Value *v) {
+    if (!s->arena)
+      delete v;
+  }
+  
   static void defaultError(void *dummy, string msg) {
     cerr << msg << "\n";
   }
@@ -117,10 +804,11 @@ namespace JSON {
   
   static Array *parse_array(struct JSON *s);
   static inline Value *parse_value(struct JSON *s, jschar end);
+  static inline bool sax_space(struct JSON *s);
   
   static inline int parse_barename(struct JSON *s) {
-    char *start=s->p;
-    char f=*start;
+    const jschar *start=s->p;
+    char f=peek(s);
     
     if (!(f>='A' && f<='Z') &&
         !(f>='a' && f<='z') &&
@@ -128,7 +816,7 @@ namespace JSON {
       return -1;
     
     s->p++;
-    while ((f=*s->p)) {
+    while ((f=peek(s))) {
       if (!(f>='A' && f<='Z') &&
           !(f>='a' && f<='z') &&
           !(f>='0' && f<='9') &&
@@ -139,18 +827,58 @@ namespace JSON {
     return (int)(s->p-start);
   }
   
-  static inline int parse_unescape(struct JSON *s) {
+  /**
+     Decodes the quoted string at s->p and points *str at the
+     result. Strings without escapes are returned as they are in the
+     input. Strings with escapes are decoded in place if the input may
+     be modified, and into s->scratch otherwise.
+
+     @return The length of the decoded string, or -1 on syntax error.
+   */
+  
+  static inline int parse_unescape(struct JSON *s, const jschar **str) {
     int val=0;
     int i;
-    jschar *p=s->p;
-    jschar *start=p;
+    const jschar *q;
+    jschar *p;
+    jschar *start;
     
     s->p++; // "
+    
+    q=s->k->string(s->p, s->end);
+    if (q>=s->end || *q==0)
+      return -1;
+    if (*q=='\"') {
+      *str=s->p;
+      s->p=q+1;
+      JSON_COUNT(s, strings, 1);
+      JSON_COUNT(s, stringBytes, q-*str);
+      return (int)(q-*str);
+    }
+    
+    if (s->buf) {
+      start=s->buf+(s->p-s->start);
+    } else {
+      // The decoded string is never longer than the escaped one
+      while (q<s->end && *q=='\\')
+        q=s->k->string(q+2<s->end ? q+2 : s->end, s->end);
+      s->scratch.resize(q-s->p+1);
+      start=&s->scratch[0];
+    }
+    p=start;
+    
     for (;;) {
-      switch (*s->p) {
+      // Copy the run up to the next quote or backslash
+      q=s->k->string(s->p, s->end);
+      memmove(p, s->p, q-s->p);
+      p+=q-s->p;
+      s->p=q;
+      
+      switch (peek(s)) {
         case '\\':
+          JSON_COUNT(s, escapes, 1);
           s->p++;
-          switch(*(s->p++)) {
+          switch(peek(s)) {
             case '\"':
               *(p++)='\"';
               break;
@@ -158,9 +886,11 @@ namespace JSON {
               *(p++)='\\';
               break;
             case '/':
-            case 'b':
               *(p++)='/';
               break;
+            case 'b':
+              *(p++)='\b';
+              break;
             case 'f':
               *(p++)='\f';
               break;
@@ -175,8 +905,9 @@ namespace JSON {
               break;
             case 'u':
               val=0;
-              for (i=4; --i;) {
-                switch(*s->p) {
+              for (i=0; i<4; i++) {
+                s->p++;
+                switch(peek(s)) {
                   case '0':
                   case '1':
                   case '2':
@@ -188,7 +919,6 @@ namespace JSON {
                   case '8':
                   case '9':
                     val = val<<4 | (*(s->p)-'0');
-                    s->p++;
                     break;
                   case 'a':
                   case 'b':
@@ -197,7 +927,6 @@ namespace JSON {
                   case 'e':
                   case 'f':
                     val = val<<4 | (*(s->p)-'a'+10);
-                    s->p++;
                     break;
                   case 'A':
                   case 'B':
@@ -206,7 +935,6 @@ namespace JSON {
                   case 'E':
                   case 'F':
                     val = val<<4 | (*(s->p)-'A'+10);
-                    s->p++;
                     break;
                   default:
                     return -1;
@@ -215,157 +943,221 @@ namespace JSON {
               *(p++)=val;
               break;
               
+            case 0:
+              return -1;
+              
             default:
-              *(p++)=s->p[-1];
+              *(p++)=*s->p;
           }
+          s->p++;
           break;
           
-        case 0:
-          return -1;
-          
         case '\"':
           s->p++;
+          *str=start;
+          JSON_COUNT(s, strings, 1);
+          JSON_COUNT(s, stringBytes, p-start);
           return (int)(p-start);
           
         default:
-          *(p++)=*(s->p++);
+          return -1;
       }
     }
   }
   
   static inline String *parse_string(struct JSON *s) {
-    jschar *start=s->p;
-    int len=parse_unescape(s);
+    const jschar *start;
+    int len=parse_unescape(s, &start);
     
     if (len==-1)
       return (String *)syntaxerror(s);
     
-    return new String(string(start,len),s->line_no);
+    JSON_NODE(s, string, sizeof(String));
+    if (s->insitu) {
+      // The closing quote has been consumed, so the NUL can go there
+      s->buf[start+len-s->start]=0;
+      return new (s->arena) String(Str(start, len), s->line_no);
+    }
+    JSON_ALLOC(s, len+1);
+    return new (s->arena) String(start, len, s->line_no, s->arena);
   }
   
   
   static inline int ignore_line_comment(struct JSON *s) {
-    while (s->p[1]) {
-      if (s->p[1] == '\n')
-        break;
-      s->p++;
-    }
+    const jschar *nl=(const jschar *)memchr(s->p, '\n', s->end-s->p);
+    // Stop before the newline, so that it gets counted
+    s->p=(nl ? nl : s->end)-1;
+    JSON_COUNT(s, comments, 1);
     return 1;
   }
   
   static inline int ignore_block_comment(struct JSON *s) {
     s->p+=2;
-    while (s->p[0]) {
-      if (s->p[-1] == '*' && s->p[0] == '/')
+    for (;;) {
+      s->p=s->k->find(s->p, s->end, '/', &s->line_no);
+      if (s->p>=s->end)
+        return 0;
+      if (s->p[-1] == '*') {
+        JSON_COUNT(s, comments, 1);
         return 1;
-      if (s->p[0]=='\n')
-        s->line_no++;
+      }
       s->p++;
     }
-    return 0;
   }
   
   static inline int ignore_comment(struct JSON *s) {
-    if (s->p[0]=='#' || (s->p[0]=='/' &&
-                         s->p[1]=='/')) return ignore_line_comment(s);
-    else if (s->p[0]=='/' &&
-             s->p[1]=='*') return ignore_block_comment(s);
+    if (peek(s)=='#' || (peek(s)=='/' &&
+                         peek(s, 1)=='/')) return ignore_line_comment(s);
+    else if (peek(s)=='/' &&
+             peek(s, 1)=='*') return ignore_block_comment(s);
     else return 0;
   }
   
+  /**
+     Moves the members parsed so far from the stack into the object,
+     which is allocated once at its final size. If a key occurs more
+     than once, the last value wins.
+   */
+  
+  static Object *finish_object(struct JSON *s, Object *object, size_t base) {
+    size_t i;
+    JSON_CLOSE(s);
+    if (s->members.size()>base)
+      JSON_ALLOC(s, (s->members.size()-base)*sizeof(Members::value_type));
+    object->value.reserve(s->members.size()-base);
+    for (i=base; i<s->members.size(); i++) {
+      std::pair<Members::iterator, bool> r=object->value.insert(s->members[i]);
+      if (!r.second) {
+        release(s, r.first->second);
+        r.first->second=s->members[i].second;
+      }
+    }
+    s->members.resize(base);
+    return object;
+  }
+  
+  static Object *abort_object(struct JSON *s, Object *object, size_t base) {
+    size_t i;
+    JSON_CLOSE(s);
+    for (i=base; i<s->members.size(); i++)
+      release(s, s->members[i].second);
+    s->members.resize(base);
+    release(s, object);
+    return NULL;
+  }
+  
   static Object *parse_object(struct JSON *s) {
-    Object *object=new Object(s->line_no);
+    Object *object=new (s->arena) Object(s->line_no, s->arena);
+    size_t base=s->members.size();
     Value *v;
-    jschar *name;
+    const jschar *name;
     int namelen;
     
+    JSON_NODE(s, object, sizeof(Object));
+    JSON_OPEN(s);
     //  s->vp=object;
     
     s->p++; // {
     
     for (;;) {
-      switch(*s->p) {
+      switch(peek(s)) {
         case '\n':
-          s->line_no++; // fall through
         case ' ':
         case '\t':
         case '\r':
-          s->p++;
+          skip_space(s);
           break;
         case '#':
         case '/':
-          if (!ignore_comment(s))
-            return (Object *)syntaxerror(s);
+          if (!ignore_comment(s)) {
+            syntaxerror(s);
+            return abort_object(s, object, base);
+          }
           s->p++;
           break;
           
         case '}':
           s->p++;
-          return object;
+          return finish_object(s, object, base);
           
         default:
-          if (*s->p=='"') {
-            name=s->p;
-            namelen=parse_unescape(s);
+          if (peek(s)=='"') {
+            namelen=parse_unescape(s, &name);
           } else {
             name=s->p;
             namelen=parse_barename(s);
           }
           
           if (namelen==-1) {
-            delete object;
-            return (Object *)syntaxerror(s);
+            syntaxerror(s);
+            return abort_object(s, object, base);
+          }
+          
+          Str key;
+          if (s->insitu) {
+            key=Str(name, namelen);
+          } else {
+            // The name may be in s->scratch, which the value can overwrite
+            key=object->value.copyKey(name, namelen);
+            JSON_ALLOC(s, namelen+1);
           }
           
           // scan for colon
-          while (*s->p!=':') {
-            switch(*(s->p++)) {
+          while (peek(s)!=':') {
+            switch(peek(s)) {
               case '\n':
-                s->line_no++; // fall through
               case ' ':
               case '\t':
               case '\r':
+                skip_space(s);
                 break;
               case '#':
               case '/':
-                if (!ignore_comment(s))
-                  return (Object *)syntaxerror(s);
+                if (!ignore_comment(s)) {
+                  syntaxerror(s);
+                  return abort_object(s, object, base);
+                }
+                s->p++;
                 break;
                 
               default:
-                delete object;
-                return (Object *)syntaxerror(s);
+                syntaxerror(s);
+                return abort_object(s, object, base);
             }
           }
           s->p++;
+          if (s->insitu)
+            s->buf[name+namelen-s->start]=0;
           
           v=parse_value(s, '}');
-          if (!v) {
-            delete object;
-            return NULL;
-          }
-          object->value[string(name, namelen)]=v;
+          if (!v)
+            return abort_object(s, object, base);
+          s->members.push_back(Members::value_type(key, v));
           
           // Scan for comma
           
-          while (*s->p!=',') {
-            switch(*(s->p++)) {
+          while (peek(s)!=',') {
+            switch(peek(s)) {
               case '}':
-                return object;
+                s->p++;
+                return finish_object(s, object, base);
               case '\n':
-                s->line_no++; // fall through
               case ' ':
               case '\t':
               case '\r':
+                skip_space(s);
                 break;
               case '#':
               case '/':
-                if (!ignore_comment(s))
-                  return (Object *)syntaxerror(s);
+                if (!ignore_comment(s)) {
+                  syntaxerror(s);
+                  return abort_object(s, object, base);
+                }
+                s->p++;
                 break;
               default:
-                delete object;
-                return (Object *)syntaxerror(s);
+                syntaxerror(s);
+                return abort_object(s, object, base);
             }
           }
           s->p++;
@@ -378,170 +1170,1126 @@ namespace JSON {
     }
     
     // not reached
-    delete object;
-    return false;
+    return abort_object(s, object, base);
   }
   
   static inline Boolean *parse_true(struct JSON *s) {
-    s->p++; //t
-    if (*(s->p++)!='r')
-      return (Boolean *)syntaxerror(s);
-    if (*(s->p++)!='u')
-      return (Boolean *)syntaxerror(s);
-    if (*(s->p++)!='e')
+    if (peek(s, 1)!='r' ||
+        peek(s, 2)!='u' ||
+        peek(s, 3)!='e')
       return (Boolean *)syntaxerror(s);
-    
-    return new Boolean(true, s->line_no);
+    s->p+=4;
+    JSON_NODE(s, boolean, sizeof(Boolean));
+    return new (s->arena) Boolean(true, s->line_no);
   }
   
   static inline Boolean *parse_false(struct JSON *s) {
-    s->p++; //f
-    if (*(s->p++)!='a')
-      return (Boolean *)syntaxerror(s);
-    if (*(s->p++)!='l')
-      return (Boolean *)syntaxerror(s);
-    if (*(s->p++)!='s')
-      return (Boolean *)syntaxerror(s);
-    if (*(s->p++)!='e')
+    if (peek(s, 1)!='a' ||
+        peek(s, 2)!='l' ||
+        peek(s, 3)!='s' ||
+        peek(s, 4)!='e')
       return (Boolean *)syntaxerror(s);
-    return new Boolean(false, s->line_no);
+    s->p+=5;
+    JSON_NODE(s, boolean, sizeof(Boolean));
+    return new (s->arena) Boolean(false, s->line_no);
   }
   
   static inline Null *parse_null(struct JSON *s) {
-    s->p++; //n
-    if (*(s->p++)!='u')
+    if (peek(s, 1)!='u' ||
+        peek(s, 2)!='l' ||
+        peek(s, 3)!='l')
       return (Null *)syntaxerror(s);
-    if (*(s->p++)!='l')
-      return (Null *)syntaxerror(s);
-    if (*(s->p++)!='l')
-      return (Null *)syntaxerror(s);
-    return new Null(s->line_no);
+    s->p+=4;
+    JSON_NODE(s, null, sizeof(Null));
+    return new (s->arena) Null(s->line_no);
   }
   
-  static inline Number *parse_number(struct JSON *s) {
-    double n=0.;
-    int sgn=-1;
-    int expsgn=1;
-    //  int exp=0;
-    double mul;
-    int expn=0;
+  /*
+    Number parsing. The digits are accumulated into a 64-bit integer,
+    eight at a time where possible (SWAR), so that integers of up to
+    64 bits are kept exactly. Other numbers are converted with
+    Clinger's fast path when the mantissa and the power of ten are both
+    exact doubles, and else with the Eisel-Lemire algorithm. The few
+    cases neither can decide correctly go to strtod.
+  */
+  
+  /**
+     A number as read by scan_number.
+   */
+  
+  struct NumberToken {
+    double value;
+    unsigned long long magnitude; // if integer
+    bool integer;     // written as an integer, and fits in 64 bits
+    bool negative;
+  };
+  
+  static const double exact_powers_of_ten[]={
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+  };
+  
+  // 128-bit approximations, rounded down, of the powers of ten from
+  // 1e-348 to 1e347, as {low 64 bits, high 64 bits}, normalized so that
+  // the top bit is set
+  static const unsigned long long powers_of_ten[][2]={
+    {0x1732c869cd60e453ULL, 0xfa8fd5a0081c0288ULL},
+    {0x0e7fbd42205c8eb4ULL, 0x9c99e58405118195ULL},
+    {0x521fac92a873b261ULL, 0xc3c05ee50655e1faULL},
+    {0xe6a797b752909ef9ULL, 0xf4b0769e47eb5a78ULL},
+    {0x9028bed2939a635cULL, 0x98ee4a22ecf3188bULL},
+    {0x7432ee873880fc33ULL, 0xbf29dcaba82fdeaeULL},
+    {0x113faa2906a13b3fULL, 0xeef453d6923bd65aULL},
+    {0x4ac7ca59a424c507ULL, 0x9558b4661b6565f8ULL},
+    {0x5d79bcf00d2df649ULL, 0xbaaee17fa23ebf76ULL},
+    {0xf4d82c2c107973dcULL, 0xe95a99df8ace6f53ULL},
+    {0x79071b9b8a4be869ULL, 0x91d8a02bb6c10594ULL},
+    {0x9748e2826cdee284ULL, 0xb64ec836a47146f9ULL},
+    {0xfd1b1b2308169b25ULL, 0xe3e27a444d8d98b7ULL},
+    {0xfe30f0f5e50e20f7ULL, 0x8e6d8c6ab0787f72ULL},
+    {0xbdbd2d335e51a935ULL, 0xb208ef855c969f4fULL},
+    {0xad2c788035e61382ULL, 0xde8b2b66b3bc4723ULL},
+    {0x4c3bcb5021afcc31ULL, 0x8b16fb203055ac76ULL},
+    {0xdf4abe242a1bbf3dULL, 0xaddcb9e83c6b1793ULL},
+    {0xd71d6dad34a2af0dULL, 0xd953e8624b85dd78ULL},
+    {0x8672648c40e5ad68ULL, 0x87d4713d6f33aa6bULL},
+    {0x680efdaf511f18c2ULL, 0xa9c98d8ccb009506ULL},
+    {0x0212bd1b2566def2ULL, 0xd43bf0effdc0ba48ULL},
+    {0x014bb630f7604b57ULL, 0x84a57695fe98746dULL},
+    {0x419ea3bd35385e2dULL, 0xa5ced43b7e3e9188ULL},
+    {0x52064cac828675b9ULL, 0xcf42894a5dce35eaULL},
+    {0x7343efebd1940993ULL, 0x818995ce7aa0e1b2ULL},
+    {0x1014ebe6c5f90bf8ULL, 0xa1ebfb4219491a1fULL},
+    {0xd41a26e077774ef6ULL, 0xca66fa129f9b60a6ULL},
+    {0x8920b098955522b4ULL, 0xfd00b897478238d0ULL},
+    {0x55b46e5f5d5535b0ULL, 0x9e20735e8cb16382ULL},
+    {0xeb2189f734aa831dULL, 0xc5a890362fddbc62ULL},
+    {0xa5e9ec7501d523e4ULL, 0xf712b443bbd52b7bULL},
+    {0x47b233c92125366eULL, 0x9a6bb0aa55653b2dULL},
+    {0x999ec0bb696e840aULL, 0xc1069cd4eabe89f8ULL},
+    {0xc00670ea43ca250dULL, 0xf148440a256e2c76ULL},
+    {0x380406926a5e5728ULL, 0x96cd2a865764dbcaULL},
+    {0xc605083704f5ecf2ULL, 0xbc807527ed3e12bcULL},
+    {0xf7864a44c633682eULL, 0xeba09271e88d976bULL},
+    {0x7ab3ee6afbe0211dULL, 0x93445b8731587ea3ULL},
+    {0x5960ea05bad82964ULL, 0xb8157268fdae9e4cULL},
+    {0x6fb92487298e33bdULL, 0xe61acf033d1a45dfULL},
+    {0xa5d3b6d479f8e056ULL, 0x8fd0c16206306babULL},
+    {0x8f48a4899877186cULL, 0xb3c4f1ba87bc8696ULL},
+    {0x331acdabfe94de87ULL, 0xe0b62e2929aba83cULL},
+    {0x9ff0c08b7f1d0b14ULL, 0x8c71dcd9ba0b4925ULL},
+    {0x07ecf0ae5ee44dd9ULL, 0xaf8e5410288e1b6fULL},
+    {0xc9e82cd9f69d6150ULL, 0xdb71e91432b1a24aULL},
+    {0xbe311c083a225cd2ULL, 0x892731ac9faf056eULL},
+    {0x6dbd630a48aaf406ULL, 0xab70fe17c79ac6caULL},
+    {0x092cbbccdad5b108ULL, 0xd64d3d9db981787dULL},
+    {0x25bbf56008c58ea5ULL, 0x85f0468293f0eb4eULL},
+    {0xaf2af2b80af6f24eULL, 0xa76c582338ed2621ULL},
+    {0x1af5af660db4aee1ULL, 0xd1476e2c07286faaULL},
+    {0x50d98d9fc890ed4dULL, 0x82cca4db847945caULL},
+    {0xe50ff107bab528a0ULL, 0xa37fce126597973cULL},
+    {0x1e53ed49a96272c8ULL, 0xcc5fc196fefd7d0cULL},
+    {0x25e8e89c13bb0f7aULL, 0xff77b1fcbebcdc4fULL},
+    {0x77b191618c54e9acULL, 0x9faacf3df73609b1ULL},
+    {0xd59df5b9ef6a2417ULL, 0xc795830d75038c1dULL},
+    {0x4b0573286b44ad1dULL, 0xf97ae3d0d2446f25ULL},
+    {0x4ee367f9430aec32ULL, 0x9becce62836ac577ULL},
+    {0x229c41f793cda73fULL, 0xc2e801fb244576d5ULL},
+    {0x6b43527578c1110fULL, 0xf3a20279ed56d48aULL},
+    {0x830a13896b78aaa9ULL, 0x9845418c345644d6ULL},
+    {0x23cc986bc656d553ULL, 0xbe5691ef416bd60cULL},
+    {0x2cbfbe86b7ec8aa8ULL, 0xedec366b11c6cb8fULL},
+    {0x7bf7d71432f3d6a9ULL, 0x94b3a202eb1c3f39ULL},
+    {0xdaf5ccd93fb0cc53ULL, 0xb9e08a83a5e34f07ULL},
+    {0xd1b3400f8f9cff68ULL, 0xe858ad248f5c22c9ULL},
+    {0x23100809b9c21fa1ULL, 0x91376c36d99995beULL},
+    {0xabd40a0c2832a78aULL, 0xb58547448ffffb2dULL},
+    {0x16c90c8f323f516cULL, 0xe2e69915b3fff9f9ULL},
+    {0xae3da7d97f6792e3ULL, 0x8dd01fad907ffc3bULL},
+    {0x99cd11cfdf41779cULL, 0xb1442798f49ffb4aULL},
+    {0x40405643d711d583ULL, 0xdd95317f31c7fa1dULL},
+    {0x482835ea666b2572ULL, 0x8a7d3eef7f1cfc52ULL},
+    {0xda3243650005eecfULL, 0xad1c8eab5ee43b66ULL},
+    {0x90bed43e40076a82ULL, 0xd863b256369d4a40ULL},
+    {0x5a7744a6e804a291ULL, 0x873e4f75e2224e68ULL},
+    {0x711515d0a205cb36ULL, 0xa90de3535aaae202ULL},
+    {0x0d5a5b44ca873e03ULL, 0xd3515c2831559a83ULL},
+    {0xe858790afe9486c2ULL, 0x8412d9991ed58091ULL},
+    {0x626e974dbe39a872ULL, 0xa5178fff668ae0b6ULL},
+    {0xfb0a3d212dc8128fULL, 0xce5d73ff402d98e3ULL},
+    {0x7ce66634bc9d0b99ULL, 0x80fa687f881c7f8eULL},
+    {0x1c1fffc1ebc44e80ULL, 0xa139029f6a239f72ULL},
+    {0xa327ffb266b56220ULL, 0xc987434744ac874eULL},
+    {0x4bf1ff9f0062baa8ULL, 0xfbe9141915d7a922ULL},
+    {0x6f773fc3603db4a9ULL, 0x9d71ac8fada6c9b5ULL},
+    {0xcb550fb4384d21d3ULL, 0xc4ce17b399107c22ULL},
+    {0x7e2a53a146606a48ULL, 0xf6019da07f549b2bULL},
+    {0x2eda7444cbfc426dULL, 0x99c102844f94e0fbULL},
+    {0xfa911155fefb5308ULL, 0xc0314325637a1939ULL},
+    {0x793555ab7eba27caULL, 0xf03d93eebc589f88ULL},
+    {0x4bc1558b2f3458deULL, 0x96267c7535b763b5ULL},
+    {0x9eb1aaedfb016f16ULL, 0xbbb01b9283253ca2ULL},
+    {0x465e15a979c1cadcULL, 0xea9c227723ee8bcbULL},
+    {0x0bfacd89ec191ec9ULL, 0x92a1958a7675175fULL},
+    {0xcef980ec671f667bULL, 0xb749faed14125d36ULL},
+    {0x82b7e12780e7401aULL, 0xe51c79a85916f484ULL},
+    {0xd1b2ecb8b0908810ULL, 0x8f31cc0937ae58d2ULL},
+    {0x861fa7e6dcb4aa15ULL, 0xb2fe3f0b8599ef07ULL},
+    {0x67a791e093e1d49aULL, 0xdfbdcece67006ac9ULL},
+    {0xe0c8bb2c5c6d24e0ULL, 0x8bd6a141006042bdULL},
+    {0x58fae9f773886e18ULL, 0xaecc49914078536dULL},
+    {0xaf39a475506a899eULL, 0xda7f5bf590966848ULL},
+    {0x6d8406c952429603ULL, 0x888f99797a5e012dULL},
+    {0xc8e5087ba6d33b83ULL, 0xaab37fd7d8f58178ULL},
+    {0xfb1e4a9a90880a64ULL, 0xd5605fcdcf32e1d6ULL},
+    {0x5cf2eea09a55067fULL, 0x855c3be0a17fcd26ULL},
+    {0xf42faa48c0ea481eULL, 0xa6b34ad8c9dfc06fULL},
+    {0xf13b94daf124da26ULL, 0xd0601d8efc57b08bULL},
+    {0x76c53d08d6b70858ULL, 0x823c12795db6ce57ULL},
+    {0x54768c4b0c64ca6eULL, 0xa2cb1717b52481edULL},
+    {0xa9942f5dcf7dfd09ULL, 0xcb7ddcdda26da268ULL},
+    {0xd3f93b35435d7c4cULL, 0xfe5d54150b090b02ULL},
+    {0xc47bc5014a1a6dafULL, 0x9efa548d26e5a6e1ULL},
+    {0x359ab6419ca1091bULL, 0xc6b8e9b0709f109aULL},
+    {0xc30163d203c94b62ULL, 0xf867241c8cc6d4c0ULL},
+    {0x79e0de63425dcf1dULL, 0x9b407691d7fc44f8ULL},
+    {0x985915fc12f542e4ULL, 0xc21094364dfb5636ULL},
+    {0x3e6f5b7b17b2939dULL, 0xf294b943e17a2bc4ULL},
+    {0xa705992ceecf9c42ULL, 0x979cf3ca6cec5b5aULL},
+    {0x50c6ff782a838353ULL, 0xbd8430bd08277231ULL},
+    {0xa4f8bf5635246428ULL, 0xece53cec4a314ebdULL},
+    {0x871b7795e136be99ULL, 0x940f4613ae5ed136ULL},
+    {0x28e2557b59846e3fULL, 0xb913179899f68584ULL},
+    {0x331aeada2fe589cfULL, 0xe757dd7ec07426e5ULL},
+    {0x3ff0d2c85def7621ULL, 0x9096ea6f3848984fULL},
+    {0x0fed077a756b53a9ULL, 0xb4bca50b065abe63ULL},
+    {0xd3e8495912c62894ULL, 0xe1ebce4dc7f16dfbULL},
+    {0x64712dd7abbbd95cULL, 0x8d3360f09cf6e4bdULL},
+    {0xbd8d794d96aacfb3ULL, 0xb080392cc4349decULL},
+    {0xecf0d7a0fc5583a0ULL, 0xdca04777f541c567ULL},
+    {0xf41686c49db57244ULL, 0x89e42caaf9491b60ULL},
+    {0x311c2875c522ced5ULL, 0xac5d37d5b79b6239ULL},
+    {0x7d633293366b828bULL, 0xd77485cb25823ac7ULL},
+    {0xae5dff9c02033197ULL, 0x86a8d39ef77164bcULL},
+    {0xd9f57f830283fdfcULL, 0xa8530886b54dbdebULL},
+    {0xd072df63c324fd7bULL, 0xd267caa862a12d66ULL},
+    {0x4247cb9e59f71e6dULL, 0x8380dea93da4bc60ULL},
+    {0x52d9be85f074e608ULL, 0xa46116538d0deb78ULL},
+    {0x67902e276c921f8bULL, 0xcd795be870516656ULL},
+    {0x00ba1cd8a3db53b6ULL, 0x806bd9714632dff6ULL},
+    {0x80e8a40eccd228a4ULL, 0xa086cfcd97bf97f3ULL},
+    {0x6122cd128006b2cdULL, 0xc8a883c0fdaf7df0ULL},
+    {0x796b805720085f81ULL, 0xfad2a4b13d1b5d6cULL},
+    {0xcbe3303674053bb0ULL, 0x9cc3a6eec6311a63ULL},
+    {0xbedbfc4411068a9cULL, 0xc3f490aa77bd60fcULL},
+    {0xee92fb5515482d44ULL, 0xf4f1b4d515acb93bULL},
+    {0x751bdd152d4d1c4aULL, 0x991711052d8bf3c5ULL},
+    {0xd262d45a78a0635dULL, 0xbf5cd54678eef0b6ULL},
+    {0x86fb897116c87c34ULL, 0xef340a98172aace4ULL},
+    {0xd45d35e6ae3d4da0ULL, 0x9580869f0e7aac0eULL},
+    {0x8974836059cca109ULL, 0xbae0a846d2195712ULL},
+    {0x2bd1a438703fc94bULL, 0xe998d258869facd7ULL},
+    {0x7b6306a34627ddcfULL, 0x91ff83775423cc06ULL},
+    {0x1a3bc84c17b1d542ULL, 0xb67f6455292cbf08ULL},
+    {0x20caba5f1d9e4a93ULL, 0xe41f3d6a7377eecaULL},
+    {0x547eb47b7282ee9cULL, 0x8e938662882af53eULL},
+    {0xe99e619a4f23aa43ULL, 0xb23867fb2a35b28dULL},
+    {0x6405fa00e2ec94d4ULL, 0xdec681f9f4c31f31ULL},
+    {0xde83bc408dd3dd04ULL, 0x8b3c113c38f9f37eULL},
+    {0x9624ab50b148d445ULL, 0xae0b158b4738705eULL},
+    {0x3badd624dd9b0957ULL, 0xd98ddaee19068c76ULL},
+    {0xe54ca5d70a80e5d6ULL, 0x87f8a8d4cfa417c9ULL},
+    {0x5e9fcf4ccd211f4cULL, 0xa9f6d30a038d1dbcULL},
+    {0x7647c3200069671fULL, 0xd47487cc8470652bULL},
+    {0x29ecd9f40041e073ULL, 0x84c8d4dfd2c63f3bULL},
+    {0xf468107100525890ULL, 0xa5fb0a17c777cf09ULL},
+    {0x7182148d4066eeb4ULL, 0xcf79cc9db955c2ccULL},
+    {0xc6f14cd848405530ULL, 0x81ac1fe293d599bfULL},
+    {0xb8ada00e5a506a7cULL, 0xa21727db38cb002fULL},
+    {0xa6d90811f0e4851cULL, 0xca9cf1d206fdc03bULL},
+    {0x908f4a166d1da663ULL, 0xfd442e4688bd304aULL},
+    {0x9a598e4e043287feULL, 0x9e4a9cec15763e2eULL},
+    {0x40eff1e1853f29fdULL, 0xc5dd44271ad3cdbaULL},
+    {0xd12bee59e68ef47cULL, 0xf7549530e188c128ULL},
+    {0x82bb74f8301958ceULL, 0x9a94dd3e8cf578b9ULL},
+    {0xe36a52363c1faf01ULL, 0xc13a148e3032d6e7ULL},
+    {0xdc44e6c3cb279ac1ULL, 0xf18899b1bc3f8ca1ULL},
+    {0x29ab103a5ef8c0b9ULL, 0x96f5600f15a7b7e5ULL},
+    {0x7415d448f6b6f0e7ULL, 0xbcb2b812db11a5deULL},
+    {0x111b495b3464ad21ULL, 0xebdf661791d60f56ULL},
+    {0xcab10dd900beec34ULL, 0x936b9fcebb25c995ULL},
+    {0x3d5d514f40eea742ULL, 0xb84687c269ef3bfbULL},
+    {0x0cb4a5a3112a5112ULL, 0xe65829b3046b0afaULL},
+    {0x47f0e785eaba72abULL, 0x8ff71a0fe2c2e6dcULL},
+    {0x59ed216765690f56ULL, 0xb3f4e093db73a093ULL},
+    {0x306869c13ec3532cULL, 0xe0f218b8d25088b8ULL},
+    {0x1e414218c73a13fbULL, 0x8c974f7383725573ULL},
+    {0xe5d1929ef90898faULL, 0xafbd2350644eeacfULL},
+    {0xdf45f746b74abf39ULL, 0xdbac6c247d62a583ULL},
+    {0x6b8bba8c328eb783ULL, 0x894bc396ce5da772ULL},
+    {0x066ea92f3f326564ULL, 0xab9eb47c81f5114fULL},
+    {0xc80a537b0efefebdULL, 0xd686619ba27255a2ULL},
+    {0xbd06742ce95f5f36ULL, 0x8613fd0145877585ULL},
+    {0x2c48113823b73704ULL, 0xa798fc4196e952e7ULL},
+    {0xf75a15862ca504c5ULL, 0xd17f3b51fca3a7a0ULL},
+    {0x9a984d73dbe722fbULL, 0x82ef85133de648c4ULL},
+    {0xc13e60d0d2e0ebbaULL, 0xa3ab66580d5fdaf5ULL},
+    {0x318df905079926a8ULL, 0xcc963fee10b7d1b3ULL},
+    {0xfdf17746497f7052ULL, 0xffbbcfe994e5c61fULL},
+    {0xfeb6ea8bedefa633ULL, 0x9fd561f1fd0f9bd3ULL},
+    {0xfe64a52ee96b8fc0ULL, 0xc7caba6e7c5382c8ULL},
+    {0x3dfdce7aa3c673b0ULL, 0xf9bd690a1b68637bULL},
+    {0x06bea10ca65c084eULL, 0x9c1661a651213e2dULL},
+    {0x486e494fcff30a62ULL, 0xc31bfa0fe5698db8ULL},
+    {0x5a89dba3c3efccfaULL, 0xf3e2f893dec3f126ULL},
+    {0xf89629465a75e01cULL, 0x986ddb5c6b3a76b7ULL},
+    {0xf6bbb397f1135823ULL, 0xbe89523386091465ULL},
+    {0x746aa07ded582e2cULL, 0xee2ba6c0678b597fULL},
+    {0xa8c2a44eb4571cdcULL, 0x94db483840b717efULL},
+    {0x92f34d62616ce413ULL, 0xba121a4650e4ddebULL},
+    {0x77b020baf9c81d17ULL, 0xe896a0d7e51e1566ULL},
+    {0x0ace1474dc1d122eULL, 0x915e2486ef32cd60ULL},
+    {0x0d819992132456baULL, 0xb5b5ada8aaff80b8ULL},
+    {0x10e1fff697ed6c69ULL, 0xe3231912d5bf60e6ULL},
+    {0xca8d3ffa1ef463c1ULL, 0x8df5efabc5979c8fULL},
+    {0xbd308ff8a6b17cb2ULL, 0xb1736b96b6fd83b3ULL},
+    {0xac7cb3f6d05ddbdeULL, 0xddd0467c64bce4a0ULL},
+    {0x6bcdf07a423aa96bULL, 0x8aa22c0dbef60ee4ULL},
+    {0x86c16c98d2c953c6ULL, 0xad4ab7112eb3929dULL},
+    {0xe871c7bf077ba8b7ULL, 0xd89d64d57a607744ULL},
+    {0x11471cd764ad4972ULL, 0x87625f056c7c4a8bULL},
+    {0xd598e40d3dd89bcfULL, 0xa93af6c6c79b5d2dULL},
+    {0x4aff1d108d4ec2c3ULL, 0xd389b47879823479ULL},
+    {0xcedf722a585139baULL, 0x843610cb4bf160cbULL},
+    {0xc2974eb4ee658828ULL, 0xa54394fe1eedb8feULL},
+    {0x733d226229feea32ULL, 0xce947a3da6a9273eULL},
+    {0x0806357d5a3f525fULL, 0x811ccc668829b887ULL},
+    {0xca07c2dcb0cf26f7ULL, 0xa163ff802a3426a8ULL},
+    {0xfc89b393dd02f0b5ULL, 0xc9bcff6034c13052ULL},
+    {0xbbac2078d443ace2ULL, 0xfc2c3f3841f17c67ULL},
+    {0xd54b944b84aa4c0dULL, 0x9d9ba7832936edc0ULL},
+    {0x0a9e795e65d4df11ULL, 0xc5029163f384a931ULL},
+    {0x4d4617b5ff4a16d5ULL, 0xf64335bcf065d37dULL},
+    {0x504bced1bf8e4e45ULL, 0x99ea0196163fa42eULL},
+    {0xe45ec2862f71e1d6ULL, 0xc06481fb9bcf8d39ULL},
+    {0x5d767327bb4e5a4cULL, 0xf07da27a82c37088ULL},
+    {0x3a6a07f8d510f86fULL, 0x964e858c91ba2655ULL},
+    {0x890489f70a55368bULL, 0xbbe226efb628afeaULL},
+    {0x2b45ac74ccea842eULL, 0xeadab0aba3b2dbe5ULL},
+    {0x3b0b8bc90012929dULL, 0x92c8ae6b464fc96fULL},
+    {0x09ce6ebb40173744ULL, 0xb77ada0617e3bbcbULL},
+    {0xcc420a6a101d0515ULL, 0xe55990879ddcaabdULL},
+    {0x9fa946824a12232dULL, 0x8f57fa54c2a9eab6ULL},
+    {0x47939822dc96abf9ULL, 0xb32df8e9f3546564ULL},
+    {0x59787e2b93bc56f7ULL, 0xdff9772470297ebdULL},
+    {0x57eb4edb3c55b65aULL, 0x8bfbea76c619ef36ULL},
+    {0xede622920b6b23f1ULL, 0xaefae51477a06b03ULL},
+    {0xe95fab368e45ecedULL, 0xdab99e59958885c4ULL},
+    {0x11dbcb0218ebb414ULL, 0x88b402f7fd75539bULL},
+    {0xd652bdc29f26a119ULL, 0xaae103b5fcd2a881ULL},
+    {0x4be76d3346f0495fULL, 0xd59944a37c0752a2ULL},
+    {0x6f70a4400c562ddbULL, 0x857fcae62d8493a5ULL},
+    {0xcb4ccd500f6bb952ULL, 0xa6dfbd9fb8e5b88eULL},
+    {0x7e2000a41346a7a7ULL, 0xd097ad07a71f26b2ULL},
+    {0x8ed400668c0c28c8ULL, 0x825ecc24c873782fULL},
+    {0x728900802f0f32faULL, 0xa2f67f2dfa90563bULL},
+    {0x4f2b40a03ad2ffb9ULL, 0xcbb41ef979346bcaULL},
+    {0xe2f610c84987bfa8ULL, 0xfea126b7d78186bcULL},
+    {0x0dd9ca7d2df4d7c9ULL, 0x9f24b832e6b0f436ULL},
+    {0x91503d1c79720dbbULL, 0xc6ede63fa05d3143ULL},
+    {0x75a44c6397ce912aULL, 0xf8a95fcf88747d94ULL},
+    {0xc986afbe3ee11abaULL, 0x9b69dbe1b548ce7cULL},
+    {0xfbe85badce996168ULL, 0xc24452da229b021bULL},
+    {0xfae27299423fb9c3ULL, 0xf2d56790ab41c2a2ULL},
+    {0xdccd879fc967d41aULL, 0x97c560ba6b0919a5ULL},
+    {0x5400e987bbc1c920ULL, 0xbdb6b8e905cb600fULL},
+    {0x290123e9aab23b68ULL, 0xed246723473e3813ULL},
+    {0xf9a0b6720aaf6521ULL, 0x9436c0760c86e30bULL},
+    {0xf808e40e8d5b3e69ULL, 0xb94470938fa89bceULL},
+    {0xb60b1d1230b20e04ULL, 0xe7958cb87392c2c2ULL},
+    {0xb1c6f22b5e6f48c2ULL, 0x90bd77f3483bb9b9ULL},
+    {0x1e38aeb6360b1af3ULL, 0xb4ecd5f01a4aa828ULL},
+    {0x25c6da63c38de1b0ULL, 0xe2280b6c20dd5232ULL},
+    {0x579c487e5a38ad0eULL, 0x8d590723948a535fULL},
+    {0x2d835a9df0c6d851ULL, 0xb0af48ec79ace837ULL},
+    {0xf8e431456cf88e65ULL, 0xdcdb1b2798182244ULL},
+    {0x1b8e9ecb641b58ffULL, 0x8a08f0f8bf0f156bULL},
+    {0xe272467e3d222f3fULL, 0xac8b2d36eed2dac5ULL},
+    {0x5b0ed81dcc6abb0fULL, 0xd7adf884aa879177ULL},
+    {0x98e947129fc2b4e9ULL, 0x86ccbb52ea94baeaULL},
+    {0x3f2398d747b36224ULL, 0xa87fea27a539e9a5ULL},
+    {0x8eec7f0d19a03aadULL, 0xd29fe4b18e88640eULL},
+    {0x1953cf68300424acULL, 0x83a3eeeef9153e89ULL},
+    {0x5fa8c3423c052dd7ULL, 0xa48ceaaab75a8e2bULL},
+    {0x3792f412cb06794dULL, 0xcdb02555653131b6ULL},
+    {0xe2bbd88bbee40bd0ULL, 0x808e17555f3ebf11ULL},
+    {0x5b6aceaeae9d0ec4ULL, 0xa0b19d2ab70e6ed6ULL},
+    {0xf245825a5a445275ULL, 0xc8de047564d20a8bULL},
+    {0xeed6e2f0f0d56712ULL, 0xfb158592be068d2eULL},
+    {0x55464dd69685606bULL, 0x9ced737bb6c4183dULL},
+    {0xaa97e14c3c26b886ULL, 0xc428d05aa4751e4cULL},
+    {0xd53dd99f4b3066a8ULL, 0xf53304714d9265dfULL},
+    {0xe546a8038efe4029ULL, 0x993fe2c6d07b7fabULL},
+    {0xde98520472bdd033ULL, 0xbf8fdb78849a5f96ULL},
+    {0x963e66858f6d4440ULL, 0xef73d256a5c0f77cULL},
+    {0xdde7001379a44aa8ULL, 0x95a8637627989aadULL},
+    {0x5560c018580d5d52ULL, 0xbb127c53b17ec159ULL},
+    {0xaab8f01e6e10b4a6ULL, 0xe9d71b689dde71afULL},
+    {0xcab3961304ca70e8ULL, 0x9226712162ab070dULL},
+    {0x3d607b97c5fd0d22ULL, 0xb6b00d69bb55c8d1ULL},
+    {0x8cb89a7db77c506aULL, 0xe45c10c42a2b3b05ULL},
+    {0x77f3608e92adb242ULL, 0x8eb98a7a9a5b04e3ULL},
+    {0x55f038b237591ed3ULL, 0xb267ed1940f1c61cULL},
+    {0x6b6c46dec52f6688ULL, 0xdf01e85f912e37a3ULL},
+    {0x2323ac4b3b3da015ULL, 0x8b61313bbabce2c6ULL},
+    {0xabec975e0a0d081aULL, 0xae397d8aa96c1b77ULL},
+    {0x96e7bd358c904a21ULL, 0xd9c7dced53c72255ULL},
+    {0x7e50d64177da2e54ULL, 0x881cea14545c7575ULL},
+    {0xdde50bd1d5d0b9e9ULL, 0xaa242499697392d2ULL},
+    {0x955e4ec64b44e864ULL, 0xd4ad2dbfc3d07787ULL},
+    {0xbd5af13bef0b113eULL, 0x84ec3c97da624ab4ULL},
+    {0xecb1ad8aeacdd58eULL, 0xa6274bbdd0fadd61ULL},
+    {0x67de18eda5814af2ULL, 0xcfb11ead453994baULL},
+    {0x80eacf948770ced7ULL, 0x81ceb32c4b43fcf4ULL},
+    {0xa1258379a94d028dULL, 0xa2425ff75e14fc31ULL},
+    {0x096ee45813a04330ULL, 0xcad2f7f5359a3b3eULL},
+    {0x8bca9d6e188853fcULL, 0xfd87b5f28300ca0dULL},
+    {0x775ea264cf55347dULL, 0x9e74d1b791e07e48ULL},
+    {0x95364afe032a819dULL, 0xc612062576589ddaULL},
+    {0x3a83ddbd83f52204ULL, 0xf79687aed3eec551ULL},
+    {0xc4926a9672793542ULL, 0x9abe14cd44753b52ULL},
+    {0x75b7053c0f178293ULL, 0xc16d9a0095928a27ULL},
+    {0x5324c68b12dd6338ULL, 0xf1c90080baf72cb1ULL},
+    {0xd3f6fc16ebca5e03ULL, 0x971da05074da7beeULL},
+    {0x88f4bb1ca6bcf584ULL, 0xbce5086492111aeaULL},
+    {0x2b31e9e3d06c32e5ULL, 0xec1e4a7db69561a5ULL},
+    {0x3aff322e62439fcfULL, 0x9392ee8e921d5d07ULL},
+    {0x09befeb9fad487c2ULL, 0xb877aa3236a4b449ULL},
+    {0x4c2ebe687989a9b3ULL, 0xe69594bec44de15bULL},
+    {0x0f9d37014bf60a10ULL, 0x901d7cf73ab0acd9ULL},
+    {0x538484c19ef38c94ULL, 0xb424dc35095cd80fULL},
+    {0x2865a5f206b06fb9ULL, 0xe12e13424bb40e13ULL},
+    {0xf93f87b7442e45d3ULL, 0x8cbccc096f5088cbULL},
+    {0xf78f69a51539d748ULL, 0xafebff0bcb24aafeULL},
+    {0xb573440e5a884d1bULL, 0xdbe6fecebdedd5beULL},
+    {0x31680a88f8953030ULL, 0x89705f4136b4a597ULL},
+    {0xfdc20d2b36ba7c3dULL, 0xabcc77118461cefcULL},
+    {0x3d32907604691b4cULL, 0xd6bf94d5e57a42bcULL},
+    {0xa63f9a49c2c1b10fULL, 0x8637bd05af6c69b5ULL},
+    {0x0fcf80dc33721d53ULL, 0xa7c5ac471b478423ULL},
+    {0xd3c36113404ea4a8ULL, 0xd1b71758e219652bULL},
+    {0x645a1cac083126e9ULL, 0x83126e978d4fdf3bULL},
+    {0x3d70a3d70a3d70a3ULL, 0xa3d70a3d70a3d70aULL},
+    {0xccccccccccccccccULL, 0xccccccccccccccccULL},
+    {0x0000000000000000ULL, 0x8000000000000000ULL},
+    {0x0000000000000000ULL, 0xa000000000000000ULL},
+    {0x0000000000000000ULL, 0xc800000000000000ULL},
+    {0x0000000000000000ULL, 0xfa00000000000000ULL},
+    {0x0000000000000000ULL, 0x9c40000000000000ULL},
+    {0x0000000000000000ULL, 0xc350000000000000ULL},
+    {0x0000000000000000ULL, 0xf424000000000000ULL},
+    {0x0000000000000000ULL, 0x9896800000000000ULL},
+    {0x0000000000000000ULL, 0xbebc200000000000ULL},
+    {0x0000000000000000ULL, 0xee6b280000000000ULL},
+    {0x0000000000000000ULL, 0x9502f90000000000ULL},
+    {0x0000000000000000ULL, 0xba43b74000000000ULL},
+    {0x0000000000000000ULL, 0xe8d4a51000000000ULL},
+    {0x0000000000000000ULL, 0x9184e72a00000000ULL},
+    {0x0000000000000000ULL, 0xb5e620f480000000ULL},
+    {0x0000000000000000ULL, 0xe35fa931a0000000ULL},
+    {0x0000000000000000ULL, 0x8e1bc9bf04000000ULL},
+    {0x0000000000000000ULL, 0xb1a2bc2ec5000000ULL},
+    {0x0000000000000000ULL, 0xde0b6b3a76400000ULL},
+    {0x0000000000000000ULL, 0x8ac7230489e80000ULL},
+    {0x0000000000000000ULL, 0xad78ebc5ac620000ULL},
+    {0x0000000000000000ULL, 0xd8d726b7177a8000ULL},
+    {0x0000000000000000ULL, 0x878678326eac9000ULL},
+    {0x0000000000000000ULL, 0xa968163f0a57b400ULL},
+    {0x0000000000000000ULL, 0xd3c21bcecceda100ULL},
+    {0x0000000000000000ULL, 0x84595161401484a0ULL},
+    {0x0000000000000000ULL, 0xa56fa5b99019a5c8ULL},
+    {0x0000000000000000ULL, 0xcecb8f27f4200f3aULL},
+    {0x4000000000000000ULL, 0x813f3978f8940984ULL},
+    {0x5000000000000000ULL, 0xa18f07d736b90be5ULL},
+    {0xa400000000000000ULL, 0xc9f2c9cd04674edeULL},
+    {0x4d00000000000000ULL, 0xfc6f7c4045812296ULL},
+    {0xf020000000000000ULL, 0x9dc5ada82b70b59dULL},
+    {0x6c28000000000000ULL, 0xc5371912364ce305ULL},
+    {0xc732000000000000ULL, 0xf684df56c3e01bc6ULL},
+    {0x3c7f400000000000ULL, 0x9a130b963a6c115cULL},
+    {0x4b9f100000000000ULL, 0xc097ce7bc90715b3ULL},
+    {0x1e86d40000000000ULL, 0xf0bdc21abb48db20ULL},
+    {0x1314448000000000ULL, 0x96769950b50d88f4ULL},
+    {0x17d955a000000000ULL, 0xbc143fa4e250eb31ULL},
+    {0x5dcfab0800000000ULL, 0xeb194f8e1ae525fdULL},
+    {0x5aa1cae500000000ULL, 0x92efd1b8d0cf37beULL},
+    {0xf14a3d9e40000000ULL, 0xb7abc627050305adULL},
+    {0x6d9ccd05d0000000ULL, 0xe596b7b0c643c719ULL},
+    {0xe4820023a2000000ULL, 0x8f7e32ce7bea5c6fULL},
+    {0xdda2802c8a800000ULL, 0xb35dbf821ae4f38bULL},
+    {0xd50b2037ad200000ULL, 0xe0352f62a19e306eULL},
+    {0x4526f422cc340000ULL, 0x8c213d9da502de45ULL},
+    {0x9670b12b7f410000ULL, 0xaf298d050e4395d6ULL},
+    {0x3c0cdd765f114000ULL, 0xdaf3f04651d47b4cULL},
+    {0xa5880a69fb6ac800ULL, 0x88d8762bf324cd0fULL},
+    {0x8eea0d047a457a00ULL, 0xab0e93b6efee0053ULL},
+    {0x72a4904598d6d880ULL, 0xd5d238a4abe98068ULL},
+    {0x47a6da2b7f864750ULL, 0x85a36366eb71f041ULL},
+    {0x999090b65f67d924ULL, 0xa70c3c40a64e6c51ULL},
+    {0xfff4b4e3f741cf6dULL, 0xd0cf4b50cfe20765ULL},
+    {0xbff8f10e7a8921a4ULL, 0x82818f1281ed449fULL},
+    {0xaff72d52192b6a0dULL, 0xa321f2d7226895c7ULL},
+    {0x9bf4f8a69f764490ULL, 0xcbea6f8ceb02bb39ULL},
+    {0x02f236d04753d5b4ULL, 0xfee50b7025c36a08ULL},
+    {0x01d762422c946590ULL, 0x9f4f2726179a2245ULL},
+    {0x424d3ad2b7b97ef5ULL, 0xc722f0ef9d80aad6ULL},
+    {0xd2e0898765a7deb2ULL, 0xf8ebad2b84e0d58bULL},
+    {0x63cc55f49f88eb2fULL, 0x9b934c3b330c8577ULL},
+    {0x3cbf6b71c76b25fbULL, 0xc2781f49ffcfa6d5ULL},
+    {0x8bef464e3945ef7aULL, 0xf316271c7fc3908aULL},
+    {0x97758bf0e3cbb5acULL, 0x97edd871cfda3a56ULL},
+    {0x3d52eeed1cbea317ULL, 0xbde94e8e43d0c8ecULL},
+    {0x4ca7aaa863ee4bddULL, 0xed63a231d4c4fb27ULL},
+    {0x8fe8caa93e74ef6aULL, 0x945e455f24fb1cf8ULL},
+    {0xb3e2fd538e122b44ULL, 0xb975d6b6ee39e436ULL},
+    {0x60dbbca87196b616ULL, 0xe7d34c64a9c85d44ULL},
+    {0xbc8955e946fe31cdULL, 0x90e40fbeea1d3a4aULL},
+    {0x6babab6398bdbe41ULL, 0xb51d13aea4a488ddULL},
+    {0xc696963c7eed2dd1ULL, 0xe264589a4dcdab14ULL},
+    {0xfc1e1de5cf543ca2ULL, 0x8d7eb76070a08aecULL},
+    {0x3b25a55f43294bcbULL, 0xb0de65388cc8ada8ULL},
+    {0x49ef0eb713f39ebeULL, 0xdd15fe86affad912ULL},
+    {0x6e3569326c784337ULL, 0x8a2dbf142dfcc7abULL},
+    {0x49c2c37f07965404ULL, 0xacb92ed9397bf996ULL},
+    {0xdc33745ec97be906ULL, 0xd7e77a8f87daf7fbULL},
+    {0x69a028bb3ded71a3ULL, 0x86f0ac99b4e8dafdULL},
+    {0xc40832ea0d68ce0cULL, 0xa8acd7c0222311bcULL},
+    {0xf50a3fa490c30190ULL, 0xd2d80db02aabd62bULL},
+    {0x792667c6da79e0faULL, 0x83c7088e1aab65dbULL},
+    {0x577001b891185938ULL, 0xa4b8cab1a1563f52ULL},
+    {0xed4c0226b55e6f86ULL, 0xcde6fd5e09abcf26ULL},
+    {0x544f8158315b05b4ULL, 0x80b05e5ac60b6178ULL},
+    {0x696361ae3db1c721ULL, 0xa0dc75f1778e39d6ULL},
+    {0x03bc3a19cd1e38e9ULL, 0xc913936dd571c84cULL},
+    {0x04ab48a04065c723ULL, 0xfb5878494ace3a5fULL},
+    {0x62eb0d64283f9c76ULL, 0x9d174b2dcec0e47bULL},
+    {0x3ba5d0bd324f8394ULL, 0xc45d1df942711d9aULL},
+    {0xca8f44ec7ee36479ULL, 0xf5746577930d6500ULL},
+    {0x7e998b13cf4e1ecbULL, 0x9968bf6abbe85f20ULL},
+    {0x9e3fedd8c321a67eULL, 0xbfc2ef456ae276e8ULL},
+    {0xc5cfe94ef3ea101eULL, 0xefb3ab16c59b14a2ULL},
+    {0xbba1f1d158724a12ULL, 0x95d04aee3b80ece5ULL},
+    {0x2a8a6e45ae8edc97ULL, 0xbb445da9ca61281fULL},
+    {0xf52d09d71a3293bdULL, 0xea1575143cf97226ULL},
+    {0x593c2626705f9c56ULL, 0x924d692ca61be758ULL},
+    {0x6f8b2fb00c77836cULL, 0xb6e0c377cfa2e12eULL},
+    {0x0b6dfb9c0f956447ULL, 0xe498f455c38b997aULL},
+    {0x4724bd4189bd5eacULL, 0x8edf98b59a373fecULL},
+    {0x58edec91ec2cb657ULL, 0xb2977ee300c50fe7ULL},
+    {0x2f2967b66737e3edULL, 0xdf3d5e9bc0f653e1ULL},
+    {0xbd79e0d20082ee74ULL, 0x8b865b215899f46cULL},
+    {0xecd8590680a3aa11ULL, 0xae67f1e9aec07187ULL},
+    {0xe80e6f4820cc9495ULL, 0xda01ee641a708de9ULL},
+    {0x3109058d147fdcddULL, 0x884134fe908658b2ULL},
+    {0xbd4b46f0599fd415ULL, 0xaa51823e34a7eedeULL},
+    {0x6c9e18ac7007c91aULL, 0xd4e5e2cdc1d1ea96ULL},
+    {0x03e2cf6bc604ddb0ULL, 0x850fadc09923329eULL},
+    {0x84db8346b786151cULL, 0xa6539930bf6bff45ULL},
+    {0xe612641865679a63ULL, 0xcfe87f7cef46ff16ULL},
+    {0x4fcb7e8f3f60c07eULL, 0x81f14fae158c5f6eULL},
+    {0xe3be5e330f38f09dULL, 0xa26da3999aef7749ULL},
+    {0x5cadf5bfd3072cc5ULL, 0xcb090c8001ab551cULL},
+    {0x73d9732fc7c8f7f6ULL, 0xfdcb4fa002162a63ULL},
+    {0x2867e7fddcdd9afaULL, 0x9e9f11c4014dda7eULL},
+    {0xb281e1fd541501b8ULL, 0xc646d63501a1511dULL},
+    {0x1f225a7ca91a4226ULL, 0xf7d88bc24209a565ULL},
+    {0x3375788de9b06958ULL, 0x9ae757596946075fULL},
+    {0x0052d6b1641c83aeULL, 0xc1a12d2fc3978937ULL},
+    {0xc0678c5dbd23a49aULL, 0xf209787bb47d6b84ULL},
+    {0xf840b7ba963646e0ULL, 0x9745eb4d50ce6332ULL},
+    {0xb650e5a93bc3d898ULL, 0xbd176620a501fbffULL},
+    {0xa3e51f138ab4cebeULL, 0xec5d3fa8ce427affULL},
+    {0xc66f336c36b10137ULL, 0x93ba47c980e98cdfULL},
+    {0xb80b0047445d4184ULL, 0xb8a8d9bbe123f017ULL},
+    {0xa60dc059157491e5ULL, 0xe6d3102ad96cec1dULL},
+    {0x87c89837ad68db2fULL, 0x9043ea1ac7e41392ULL},
+    {0x29babe4598c311fbULL, 0xb454e4a179dd1877ULL},
+    {0xf4296dd6fef3d67aULL, 0xe16a1dc9d8545e94ULL},
+    {0x1899e4a65f58660cULL, 0x8ce2529e2734bb1dULL},
+    {0x5ec05dcff72e7f8fULL, 0xb01ae745b101e9e4ULL},
+    {0x76707543f4fa1f73ULL, 0xdc21a1171d42645dULL},
+    {0x6a06494a791c53a8ULL, 0x899504ae72497ebaULL},
+    {0x0487db9d17636892ULL, 0xabfa45da0edbde69ULL},
+    {0x45a9d2845d3c42b6ULL, 0xd6f8d7509292d603ULL},
+    {0x0b8a2392ba45a9b2ULL, 0x865b86925b9bc5c2ULL},
+    {0x8e6cac7768d7141eULL, 0xa7f26836f282b732ULL},
+    {0x3207d795430cd926ULL, 0xd1ef0244af2364ffULL},
+    {0x7f44e6bd49e807b8ULL, 0x8335616aed761f1fULL},
+    {0x5f16206c9c6209a6ULL, 0xa402b9c5a8d3a6e7ULL},
+    {0x36dba887c37a8c0fULL, 0xcd036837130890a1ULL},
+    {0xc2494954da2c9789ULL, 0x802221226be55a64ULL},
+    {0xf2db9baa10b7bd6cULL, 0xa02aa96b06deb0fdULL},
+    {0x6f92829494e5acc7ULL, 0xc83553c5c8965d3dULL},
+    {0xcb772339ba1f17f9ULL, 0xfa42a8b73abbf48cULL},
+    {0xff2a760414536efbULL, 0x9c69a97284b578d7ULL},
+    {0xfef5138519684abaULL, 0xc38413cf25e2d70dULL},
+    {0x7eb258665fc25d69ULL, 0xf46518c2ef5b8cd1ULL},
+    {0xef2f773ffbd97a61ULL, 0x98bf2f79d5993802ULL},
+    {0xaafb550ffacfd8faULL, 0xbeeefb584aff8603ULL},
+    {0x95ba2a53f983cf38ULL, 0xeeaaba2e5dbf6784ULL},
+    {0xdd945a747bf26183ULL, 0x952ab45cfa97a0b2ULL},
+    {0x94f971119aeef9e4ULL, 0xba756174393d88dfULL},
+    {0x7a37cd5601aab85dULL, 0xe912b9d1478ceb17ULL},
+    {0xac62e055c10ab33aULL, 0x91abb422ccb812eeULL},
+    {0x577b986b314d6009ULL, 0xb616a12b7fe617aaULL},
+    {0xed5a7e85fda0b80bULL, 0xe39c49765fdf9d94ULL},
+    {0x14588f13be847307ULL, 0x8e41ade9fbebc27dULL},
+    {0x596eb2d8ae258fc8ULL, 0xb1d219647ae6b31cULL},
+    {0x6fca5f8ed9aef3bbULL, 0xde469fbd99a05fe3ULL},
+    {0x25de7bb9480d5854ULL, 0x8aec23d680043beeULL},
+    {0xaf561aa79a10ae6aULL, 0xada72ccc20054ae9ULL},
+    {0x1b2ba1518094da04ULL, 0xd910f7ff28069da4ULL},
+    {0x90fb44d2f05d0842ULL, 0x87aa9aff79042286ULL},
+    {0x353a1607ac744a53ULL, 0xa99541bf57452b28ULL},
+    {0x42889b8997915ce8ULL, 0xd3fa922f2d1675f2ULL},
+    {0x69956135febada11ULL, 0x847c9b5d7c2e09b7ULL},
+    {0x43fab9837e699095ULL, 0xa59bc234db398c25ULL},
+    {0x94f967e45e03f4bbULL, 0xcf02b2c21207ef2eULL},
+    {0x1d1be0eebac278f5ULL, 0x8161afb94b44f57dULL},
+    {0x6462d92a69731732ULL, 0xa1ba1ba79e1632dcULL},
+    {0x7d7b8f7503cfdcfeULL, 0xca28a291859bbf93ULL},
+    {0x5cda735244c3d43eULL, 0xfcb2cb35e702af78ULL},
+    {0x3a0888136afa64a7ULL, 0x9defbf01b061adabULL},
+    {0x088aaa1845b8fdd0ULL, 0xc56baec21c7a1916ULL},
+    {0x8aad549e57273d45ULL, 0xf6c69a72a3989f5bULL},
+    {0x36ac54e2f678864bULL, 0x9a3c2087a63f6399ULL},
+    {0x84576a1bb416a7ddULL, 0xc0cb28a98fcf3c7fULL},
+    {0x656d44a2a11c51d5ULL, 0xf0fdf2d3f3c30b9fULL},
+    {0x9f644ae5a4b1b325ULL, 0x969eb7c47859e743ULL},
+    {0x873d5d9f0dde1feeULL, 0xbc4665b596706114ULL},
+    {0xa90cb506d155a7eaULL, 0xeb57ff22fc0c7959ULL},
+    {0x09a7f12442d588f2ULL, 0x9316ff75dd87cbd8ULL},
+    {0x0c11ed6d538aeb2fULL, 0xb7dcbf5354e9beceULL},
+    {0x8f1668c8a86da5faULL, 0xe5d3ef282a242e81ULL},
+    {0xf96e017d694487bcULL, 0x8fa475791a569d10ULL},
+    {0x37c981dcc395a9acULL, 0xb38d92d760ec4455ULL},
+    {0x85bbe253f47b1417ULL, 0xe070f78d3927556aULL},
+    {0x93956d7478ccec8eULL, 0x8c469ab843b89562ULL},
+    {0x387ac8d1970027b2ULL, 0xaf58416654a6babbULL},
+    {0x06997b05fcc0319eULL, 0xdb2e51bfe9d0696aULL},
+    {0x441fece3bdf81f03ULL, 0x88fcf317f22241e2ULL},
+    {0xd527e81cad7626c3ULL, 0xab3c2fddeeaad25aULL},
+    {0x8a71e223d8d3b074ULL, 0xd60b3bd56a5586f1ULL},
+    {0xf6872d5667844e49ULL, 0x85c7056562757456ULL},
+    {0xb428f8ac016561dbULL, 0xa738c6bebb12d16cULL},
+    {0xe13336d701beba52ULL, 0xd106f86e69d785c7ULL},
+    {0xecc0024661173473ULL, 0x82a45b450226b39cULL},
+    {0x27f002d7f95d0190ULL, 0xa34d721642b06084ULL},
+    {0x31ec038df7b441f4ULL, 0xcc20ce9bd35c78a5ULL},
+    {0x7e67047175a15271ULL, 0xff290242c83396ceULL},
+    {0x0f0062c6e984d386ULL, 0x9f79a169bd203e41ULL},
+    {0x52c07b78a3e60868ULL, 0xc75809c42c684dd1ULL},
+    {0xa7709a56ccdf8a82ULL, 0xf92e0c3537826145ULL},
+    {0x88a66076400bb691ULL, 0x9bbcc7a142b17ccbULL},
+    {0x6acff893d00ea435ULL, 0xc2abf989935ddbfeULL},
+    {0x0583f6b8c4124d43ULL, 0xf356f7ebf83552feULL},
+    {0xc3727a337a8b704aULL, 0x98165af37b2153deULL},
+    {0x744f18c0592e4c5cULL, 0xbe1bf1b059e9a8d6ULL},
+    {0x1162def06f79df73ULL, 0xeda2ee1c7064130cULL},
+    {0x8addcb5645ac2ba8ULL, 0x9485d4d1c63e8be7ULL},
+    {0x6d953e2bd7173692ULL, 0xb9a74a0637ce2ee1ULL},
+    {0xc8fa8db6ccdd0437ULL, 0xe8111c87c5c1ba99ULL},
+    {0x1d9c9892400a22a2ULL, 0x910ab1d4db9914a0ULL},
+    {0x2503beb6d00cab4bULL, 0xb54d5e4a127f59c8ULL},
+    {0x2e44ae64840fd61dULL, 0xe2a0b5dc971f303aULL},
+    {0x5ceaecfed289e5d2ULL, 0x8da471a9de737e24ULL},
+    {0x7425a83e872c5f47ULL, 0xb10d8e1456105dadULL},
+    {0xd12f124e28f77719ULL, 0xdd50f1996b947518ULL},
+    {0x82bd6b70d99aaa6fULL, 0x8a5296ffe33cc92fULL},
+    {0x636cc64d1001550bULL, 0xace73cbfdc0bfb7bULL},
+    {0x3c47f7e05401aa4eULL, 0xd8210befd30efa5aULL},
+    {0x65acfaec34810a71ULL, 0x8714a775e3e95c78ULL},
+    {0x7f1839a741a14d0dULL, 0xa8d9d1535ce3b396ULL},
+    {0x1ede48111209a050ULL, 0xd31045a8341ca07cULL},
+    {0x934aed0aab460432ULL, 0x83ea2b892091e44dULL},
+    {0xf81da84d5617853fULL, 0xa4e4b66b68b65d60ULL},
+    {0x36251260ab9d668eULL, 0xce1de40642e3f4b9ULL},
+    {0xc1d72b7c6b426019ULL, 0x80d2ae83e9ce78f3ULL},
+    {0xb24cf65b8612f81fULL, 0xa1075a24e4421730ULL},
+    {0xdee033f26797b627ULL, 0xc94930ae1d529cfcULL},
+    {0x169840ef017da3b1ULL, 0xfb9b7cd9a4a7443cULL},
+    {0x8e1f289560ee864eULL, 0x9d412e0806e88aa5ULL},
+    {0xf1a6f2bab92a27e2ULL, 0xc491798a08a2ad4eULL},
+    {0xae10af696774b1dbULL, 0xf5b5d7ec8acb58a2ULL},
+    {0xacca6da1e0a8ef29ULL, 0x9991a6f3d6bf1765ULL},
+    {0x17fd090a58d32af3ULL, 0xbff610b0cc6edd3fULL},
+    {0xddfc4b4cef07f5b0ULL, 0xeff394dcff8a948eULL},
+    {0x4abdaf101564f98eULL, 0x95f83d0a1fb69cd9ULL},
+    {0x9d6d1ad41abe37f1ULL, 0xbb764c4ca7a4440fULL},
+    {0x84c86189216dc5edULL, 0xea53df5fd18d5513ULL},
+    {0x32fd3cf5b4e49bb4ULL, 0x92746b9be2f8552cULL},
+    {0x3fbc8c33221dc2a1ULL, 0xb7118682dbb66a77ULL},
+    {0x0fabaf3feaa5334aULL, 0xe4d5e82392a40515ULL},
+    {0x29cb4d87f2a7400eULL, 0x8f05b1163ba6832dULL},
+    {0x743e20e9ef511012ULL, 0xb2c71d5bca9023f8ULL},
+    {0x914da9246b255416ULL, 0xdf78e4b2bd342cf6ULL},
+    {0x1ad089b6c2f7548eULL, 0x8bab8eefb6409c1aULL},
+    {0xa184ac2473b529b1ULL, 0xae9672aba3d0c320ULL},
+    {0xc9e5d72d90a2741eULL, 0xda3c0f568cc4f3e8ULL},
+    {0x7e2fa67c7a658892ULL, 0x8865899617fb1871ULL},
+    {0xddbb901b98feeab7ULL, 0xaa7eebfb9df9de8dULL},
+    {0x552a74227f3ea565ULL, 0xd51ea6fa85785631ULL},
+    {0xd53a88958f87275fULL, 0x8533285c936b35deULL},
+    {0x8a892abaf368f137ULL, 0xa67ff273b8460356ULL},
+    {0x2d2b7569b0432d85ULL, 0xd01fef10a657842cULL},
+    {0x9c3b29620e29fc73ULL, 0x8213f56a67f6b29bULL},
+    {0x8349f3ba91b47b8fULL, 0xa298f2c501f45f42ULL},
+    {0x241c70a936219a73ULL, 0xcb3f2f7642717713ULL},
+    {0xed238cd383aa0110ULL, 0xfe0efb53d30dd4d7ULL},
+    {0xf4363804324a40aaULL, 0x9ec95d1463e8a506ULL},
+    {0xb143c6053edcd0d5ULL, 0xc67bb4597ce2ce48ULL},
+    {0xdd94b7868e94050aULL, 0xf81aa16fdc1b81daULL},
+    {0xca7cf2b4191c8326ULL, 0x9b10a4e5e9913128ULL},
+    {0xfd1c2f611f63a3f0ULL, 0xc1d4ce1f63f57d72ULL},
+    {0xbc633b39673c8cecULL, 0xf24a01a73cf2dccfULL},
+    {0xd5be0503e085d813ULL, 0x976e41088617ca01ULL},
+    {0x4b2d8644d8a74e18ULL, 0xbd49d14aa79dbc82ULL},
+    {0xddf8e7d60ed1219eULL, 0xec9c459d51852ba2ULL},
+    {0xcabb90e5c942b503ULL, 0x93e1ab8252f33b45ULL},
+    {0x3d6a751f3b936243ULL, 0xb8da1662e7b00a17ULL},
+    {0x0cc512670a783ad4ULL, 0xe7109bfba19c0c9dULL},
+    {0x27fb2b80668b24c5ULL, 0x906a617d450187e2ULL},
+    {0xb1f9f660802dedf6ULL, 0xb484f9dc9641e9daULL},
+    {0x5e7873f8a0396973ULL, 0xe1a63853bbd26451ULL},
+    {0xdb0b487b6423e1e8ULL, 0x8d07e33455637eb2ULL},
+    {0x91ce1a9a3d2cda62ULL, 0xb049dc016abc5e5fULL},
+    {0x7641a140cc7810fbULL, 0xdc5c5301c56b75f7ULL},
+    {0xa9e904c87fcb0a9dULL, 0x89b9b3e11b6329baULL},
+    {0x546345fa9fbdcd44ULL, 0xac2820d9623bf429ULL},
+    {0xa97c177947ad4095ULL, 0xd732290fbacaf133ULL},
+    {0x49ed8eabcccc485dULL, 0x867f59a9d4bed6c0ULL},
+    {0x5c68f256bfff5a74ULL, 0xa81f301449ee8c70ULL},
+    {0x73832eec6fff3111ULL, 0xd226fc195c6a2f8cULL},
+    {0xc831fd53c5ff7eabULL, 0x83585d8fd9c25db7ULL},
+    {0xba3e7ca8b77f5e55ULL, 0xa42e74f3d032f525ULL},
+    {0x28ce1bd2e55f35ebULL, 0xcd3a1230c43fb26fULL},
+    {0x7980d163cf5b81b3ULL, 0x80444b5e7aa7cf85ULL},
+    {0xd7e105bcc332621fULL, 0xa0555e361951c366ULL},
+    {0x8dd9472bf3fefaa7ULL, 0xc86ab5c39fa63440ULL},
+    {0xb14f98f6f0feb951ULL, 0xfa856334878fc150ULL},
+    {0x6ed1bf9a569f33d3ULL, 0x9c935e00d4b9d8d2ULL},
+    {0x0a862f80ec4700c8ULL, 0xc3b8358109e84f07ULL},
+    {0xcd27bb612758c0faULL, 0xf4a642e14c6262c8ULL},
+    {0x8038d51cb897789cULL, 0x98e7e9cccfbd7dbdULL},
+    {0xe0470a63e6bd56c3ULL, 0xbf21e44003acdd2cULL},
+    {0x1858ccfce06cac74ULL, 0xeeea5d5004981478ULL},
+    {0x0f37801e0c43ebc8ULL, 0x95527a5202df0ccbULL},
+    {0xd30560258f54e6baULL, 0xbaa718e68396cffdULL},
+    {0x47c6b82ef32a2069ULL, 0xe950df20247c83fdULL},
+    {0x4cdc331d57fa5441ULL, 0x91d28b7416cdd27eULL},
+    {0xe0133fe4adf8e952ULL, 0xb6472e511c81471dULL},
+    {0x58180fddd97723a6ULL, 0xe3d8f9e563a198e5ULL},
+    {0x570f09eaa7ea7648ULL, 0x8e679c2f5e44ff8fULL},
+    {0x2cd2cc6551e513daULL, 0xb201833b35d63f73ULL},
+    {0xf8077f7ea65e58d1ULL, 0xde81e40a034bcf4fULL},
+    {0xfb04afaf27faf782ULL, 0x8b112e86420f6191ULL},
+    {0x79c5db9af1f9b563ULL, 0xadd57a27d29339f6ULL},
+    {0x18375281ae7822bcULL, 0xd94ad8b1c7380874ULL},
+    {0x8f2293910d0b15b5ULL, 0x87cec76f1c830548ULL},
+    {0xb2eb3875504ddb22ULL, 0xa9c2794ae3a3c69aULL},
+    {0x5fa60692a46151ebULL, 0xd433179d9c8cb841ULL},
+    {0xdbc7c41ba6bcd333ULL, 0x849feec281d7f328ULL},
+    {0x12b9b522906c0800ULL, 0xa5c7ea73224deff3ULL},
+    {0xd768226b34870a00ULL, 0xcf39e50feae16befULL},
+    {0xe6a1158300d46640ULL, 0x81842f29f2cce375ULL},
+    {0x60495ae3c1097fd0ULL, 0xa1e53af46f801c53ULL},
+    {0x385bb19cb14bdfc4ULL, 0xca5e89b18b602368ULL},
+    {0x46729e03dd9ed7b5ULL, 0xfcf62c1dee382c42ULL},
+    {0x6c07a2c26a8346d1ULL, 0x9e19db92b4e31ba9ULL},
+    {0xc7098b7305241885ULL, 0xc5a05277621be293ULL},
+    {0xb8cbee4fc66d1ea7ULL, 0xf70867153aa2db38ULL},
+    {0x737f74f1dc043328ULL, 0x9a65406d44a5c903ULL},
+    {0x505f522e53053ff2ULL, 0xc0fe908895cf3b44ULL},
+    {0x647726b9e7c68fefULL, 0xf13e34aabb430a15ULL},
+    {0x5eca783430dc19f5ULL, 0x96c6e0eab509e64dULL},
+    {0xb67d16413d132072ULL, 0xbc789925624c5fe0ULL},
+    {0xe41c5bd18c57e88fULL, 0xeb96bf6ebadf77d8ULL},
+    {0x8e91b962f7b6f159ULL, 0x933e37a534cbaae7ULL},
+    {0x723627bbb5a4adb0ULL, 0xb80dc58e81fe95a1ULL},
+    {0xcec3b1aaa30dd91cULL, 0xe61136f2227e3b09ULL},
+    {0x213a4f0aa5e8a7b1ULL, 0x8fcac257558ee4e6ULL},
+    {0xa988e2cd4f62d19dULL, 0xb3bd72ed2af29e1fULL},
+    {0x93eb1b80a33b8605ULL, 0xe0accfa875af45a7ULL},
+    {0xbc72f130660533c3ULL, 0x8c6c01c9498d8b88ULL},
+    {0xeb8fad7c7f8680b4ULL, 0xaf87023b9bf0ee6aULL},
+    {0xa67398db9f6820e1ULL, 0xdb68c2ca82ed2a05ULL},
+    {0x88083f8943a1148cULL, 0x892179be91d43a43ULL},
+    {0x6a0a4f6b948959b0ULL, 0xab69d82e364948d4ULL},
+    {0x848ce34679abb01cULL, 0xd6444e39c3db9b09ULL},
+    {0xf2d80e0c0c0b4e11ULL, 0x85eab0e41a6940e5ULL},
+    {0x6f8e118f0f0e2195ULL, 0xa7655d1d2103911fULL},
+    {0x4b7195f2d2d1a9fbULL, 0xd13eb46469447567ULL},
+  };
+  
+  static inline unsigned long long mul64(unsigned long long a, unsigned long long b,
+                                         unsigned long long *lo) {
+#ifdef __SIZEOF_INT128__
+    unsigned __int128 r=(unsigned __int128)a*b;
+    *lo=(unsigned long long)r;
+    return (unsigned long long)(r>>64);
+#else
+    unsigned long long alo=a&0xffffffffu, ahi=a>>32;
+    unsigned long long blo=b&0xffffffffu, bhi=b>>32;
+    unsigned long long ll=alo*blo, lh=alo*bhi, hl=ahi*blo, hh=ahi*bhi;
+    unsigned long long mid=(ll>>32)+(lh&0xffffffffu)+(hl&0xffffffffu);
+    *lo=(mid<<32)|(ll&0xffffffffu);
+    return hh+(lh>>32)+(hl>>32)+(mid>>32);
+#endif
+  }
+  
+  /**
+     Computes the double nearest to man*10^exp10, for man!=0.
+
+     @return false if the result cannot be determined this way.
+   */
+  
+  static bool eisel_lemire(unsigned long long man, int exp10, bool neg, double *ret) {
+    if (exp10<-348 || exp10>347)
+      return false;
     
-    if (*s->p=='-')
-      s->p++;
-    else
-      sgn=1;
+#ifdef __GNUC__
+    int clz=__builtin_clzll(man);
+#else
+    int clz=0;
+    while (!(man>>(63-clz)))
+      clz++;
+#endif
+    man<<=clz;
+    unsigned long long exp2=(unsigned long long)((217706*exp10>>16)+64+1023-clz);
+    const unsigned long long *pow=powers_of_ten[exp10+348];
     
-    switch(*s->p) {
-      case '0':
-        s->p++;
-        goto intend;
-        
-      case '1':
-      case '2':
-      case '3':
-      case '4':
-      case '5':
-      case '6':
-      case '7':
-      case '8':
-      case '9':
-        n=(double) (*s->p-'0');
-        s->p++;
-        for (;;) {
-          switch(*s->p) {
-            case '0':
-            case '1':
-            case '2':
-            case '3':
-            case '4':
-            case '5':
-            case '6':
-            case '7':
-            case '8':
-            case '9':
-              n=n*10+(*s->p-'0');
-              s->p++;
-              break;
-              
-            case '.':
-            case 'e':
-            case 'E':
-              goto intend;
-              
-            default:
-              goto end;
-          }
-        }
-      default:
-        return (Number *)syntaxerror(s);
+    unsigned long long xlo;
+    unsigned long long xhi=mul64(man, pow[1], &xlo);
+    if ((xhi&0x1ff)==0x1ff && xlo+man<man) {
+      // The truncated product might be off; use the low half as well
+      unsigned long long ylo;
+      unsigned long long yhi=mul64(man, pow[0], &ylo);
+      unsigned long long mergedhi=xhi, mergedlo=xlo+yhi;
+      if (mergedlo<xlo)
+        mergedhi++;
+      if ((mergedhi&0x1ff)==0x1ff && mergedlo+1==0 && ylo+man<man)
+        return false;
+      xhi=mergedhi;
+      xlo=mergedlo;
     }
     
+    unsigned long long msb=xhi>>63;
+    unsigned long long mant=xhi>>(msb+9);
+    exp2-=1^msb;
     
-  intend:
-    switch(*s->p) {
-      case '.':
-        s->p++;
-        goto fraction;
-      case 'e':
-      case 'E':
-        goto exp;
-      default:
-        goto end;
+    // Exactly halfway between two doubles?
+    if (xlo==0 && (xhi&0x1ff)==0 && (mant&3)==1)
+      return false;
+    
+    mant+=mant&1;
+    mant>>=1;
+    if (mant>>53) {
+      mant>>=1;
+      exp2++;
     }
+    // Subnormal, infinite or out of range
+    if (exp2-1>=0x7ff-1)
+      return false;
     
-  fraction:
-    mul=0.1;
-    for (;;) {
-      switch(*s->p) {
-        case '0':
-        case '1':
-        case '2':
-        case '3':
-        case '4':
-        case '5':
-        case '6':
-        case '7':
-        case '8':
-        case '9':
-          n+=mul*(*s->p-'0');
-          s->p++;
-          mul/=10.;
-          break;
-        case 'e':
-        case 'E':
-          goto exp;
-        default:
-          goto end;
+    unsigned long long bits=exp2<<52 | (mant&0x000fffffffffffffULL);
+    if (neg)
+      bits|=0x8000000000000000ULL;
+    memcpy(ret, &bits, sizeof(bits));
+    return true;
+  }
+  
+  /**
+     Converts the number between start and end with strtod.
+   */
+  
+  static double slow_number(const jschar *start, const jschar *end) {
+    std::string buf(start, end);
+    // strtod expects the decimal point of the current locale
+    const char *point=localeconv()->decimal_point;
+    if (point[0]!='.') {
+      size_t i=buf.find('.');
+      if (i!=std::string::npos)
+        buf.replace(i, 1, point);
+    }
+    return strtod(buf.c_str(), NULL);
+  }
+  
+  /*
+    Formatting of numbers, with Schubfach (Giulietti, "The Schubfach
+    way to render doubles"). It finds the shortest decimals that read
+    back as the same double, and picks the nearest of those. The powers
+    of ten are those used for parsing, rounded up.
+  */
+  
+  /**
+     @return The top 64 bits of the 192-bit product of g and cp, with
+     the lowest bit set if the rest is not zero.
+   */
+  
+  static inline unsigned long long round_to_odd(unsigned long long ghi, unsigned long long glo,
+                                                unsigned long long cp) {
+    unsigned long long xlo, ylo;
+    unsigned long long xhi=mul64(glo, cp, &xlo);
+    unsigned long long yhi=mul64(ghi, cp, &ylo);
+    unsigned long long z=ylo+xhi;
+    if (z<ylo)
+      yhi++;
+    return yhi | (z>1);
+  }
+  
+  /**
+     Finds the shortest decimal form of a positive, finite double.
+
+     @return The digits, whose value is scaled by 10^*exp10
+   */
+  
+  static unsigned long long shortest_decimal(double d, int *exp10) {
+    unsigned long long bits;
+    memcpy(&bits, &d, sizeof(bits));
+    unsigned long long F=bits&0x000fffffffffffffULL;
+    int E=(int)(bits>>52);
+    unsigned long long c=E ? F|1ULL<<52 : F;
+    int q=E ? E-1075 : -1074;
+    
+    // The boundaries halfway to the neighbouring doubles, scaled by 4.
+    // The one below is closer when d is a power of two. They belong to
+    // d if c is even, as the parser rounds ties to even.
+    bool closer=F==0 && E>1;
+    bool even=!(c&1);
+    unsigned long long cb=4*c;
+    unsigned long long cbl=cb-2+closer;
+    unsigned long long cbr=cb+2;
+    
+    // floor(log10(2^q)), or of 3/4*2^q when the lower boundary is closer
+    int k=(q*1262611-(closer ? 524031 : 0))>>22;
+    int h=q+(217706*-k>>16)+1;
+    
+    // 10^-k, rounded up. It is exact for 0<=-k<=55.
+    const unsigned long long *pow=powers_of_ten[-k+348];
+    unsigned long long glo=pow[0], ghi=pow[1];
+    if (-k<0 || -k>55) {
+      if (!++glo)
+        ghi++;
+    }
+    
+    unsigned long long vbl=round_to_odd(ghi, glo, cbl<<h);
+    unsigned long long vb=round_to_odd(ghi, glo, cb<<h);
+    unsigned long long vbr=round_to_odd(ghi, glo, cbr<<h);
+    unsigned long long lower=vbl+!even;
+    unsigned long long upper=vbr-!even;
+    unsigned long long s=vb/4;
+    
+    if (s>=10) {
+      // One digit fewer, if exactly one of its neighbours is inside
+      unsigned long long sp=s/10;
+      bool upin=lower<=40*sp;
+      bool wpin=40*sp+40<=upper;
+      if (upin!=wpin) {
+        *exp10=k+1;
+        return sp+wpin;
       }
     }
     
-  exp:
-    s->p++; //e or E
-    switch(*s->p) {
-      case '+':
-        s->p++;
-        // fall through
-      case '0':
-      case '1':
-      case '2':
-      case '3':
-      case '4':
-      case '5':
-      case '6':
-      case '7':
-      case '8':
-      case '9':
-        break;
-      case '-':
-        expsgn=-1;
-        s->p++;
+    bool uin=lower<=4*s;
+    bool win=4*s+4<=upper;
+    *exp10=k;
+    if (uin!=win)
+      return s+win;
+    // Both are inside: the nearer one, ties to even
+    unsigned long long mid=4*s+2;
+    return s+(vb>mid || (vb==mid && (s&1)));
+  }
+  
+  static char *format_uint(char *p, unsigned long long n) {
+    char digits[20];
+    int len=0;
+    do {
+      digits[len++]=(char)('0'+n%10);
+      n/=10;
+    } while (n);
+    while (len)
+      *p++=digits[--len];
+    return p;
+  }
+  
+  int formatNumber(char *buf, double d) {
+    char *p=buf;
+    char digits[20];
+    int len, exp10, point, i;
+    
+    if (d!=d || d-d!=0) {
+      // NaN or infinite
+      strcpy(buf, "null");
+      return 4;
+    }
+    if (signbit(d)) {
+      *p++='-';
+      d=-d;
+    }
+    
+    if (d<9007199254740992.0 && d==(double)(unsigned long long)d) {
+      // An integer below 2^53 has no shorter form than its digits
+      p=format_uint(p, (unsigned long long)d);
+      *p=0;
+      return (int)(p-buf);
+    }
+    
+    unsigned long long n=shortest_decimal(d, &exp10);
+    while (n%10==0) {
+      n/=10;
+      exp10++;
+    }
+    len=(int)(format_uint(digits, n)-digits);
+    point=len+exp10; // the decimal point comes after this many digits
+    
+    if (len<=point && point<=21) {
+      memcpy(p, digits, len);
+      p+=len;
+      for (i=len; i<point; i++)
+        *p++='0';
+    } else if (0<point && point<=21) {
+      memcpy(p, digits, point);
+      p+=point;
+      *p++='.';
+      memcpy(p, digits+point, len-point);
+      p+=len-point;
+    } else if (-6<point && point<=0) {
+      *p++='0';
+      *p++='.';
+      for (i=point; i<0; i++)
+        *p++='0';
+      memcpy(p, digits, len);
+      p+=len;
+    } else {
+      *p++=digits[0];
+      if (len>1) {
+        *p++='.';
+        memcpy(p, digits+1, len-1);
+        p+=len-1;
+      }
+      *p++='e';
+      *p++=point>0 ? '+' : '-';
+      p=format_uint(p, point>0 ? point-1 : 1-point);
+    }
+    *p=0;
+    return (int)(p-buf);
+  }
+  
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__==__ORDER_LITTLE_ENDIAN__
+#define JSON_SWAR
+  
+  static inline bool is_eight_digits(unsigned long long v) {
+    return ((v & 0xf0f0f0f0f0f0f0f0ULL) |
+            (((v + 0x0606060606060606ULL) & 0xf0f0f0f0f0f0f0f0ULL) >> 4)) ==
+      0x3333333333333333ULL;
+  }
+  
+  static inline unsigned parse_eight_digits(unsigned long long v) {
+    const unsigned long long mask=0x000000ff000000ffULL;
+    const unsigned long long mul1=0x000f424000000064ULL; // 100 + (1000000 << 32)
+    const unsigned long long mul2=0x0000271000000001ULL; // 1 + (10000 << 32)
+    v-=0x3030303030303030ULL;
+    v=(v*10)+(v>>8);
+    v=(((v & mask)*mul1)+(((v>>16) & mask)*mul2))>>32;
+    return (unsigned)v;
+  }
+  
+#endif
+  
+  /**
+     Accumulates the digits at s->p into *man. Digits that do not fit
+     in 64 bits are dropped, and *truncated is set. *exp10 is adjusted
+     so that the number is *man*10^*exp10.
+   */
+  
+  static inline void scan_digits(struct JSON *s, unsigned long long *man,
+                                 int *exp10, bool *truncated, bool fraction) {
+    unsigned long long m=*man;
+    const jschar *p=s->p;
+    
+#ifdef JSON_SWAR
+    // Eight digits cannot overflow m while it is below 10^11
+    while (p+8<=s->end && m<100000000000ULL) {
+      unsigned long long v;
+      memcpy(&v, p, 8);
+      if (!is_eight_digits(v))
         break;
-      default:
-        return (Number *)syntaxerror(s);
+      m=m*100000000+parse_eight_digits(v);
+      p+=8;
+      if (fraction)
+        *exp10-=8;
     }
+#endif
     
-    for (;;) {
-      switch(*s->p) {
+    for (; p<s->end && *p>='0' && *p<='9'; p++) {
+      unsigned d=*p-'0';
+      if (!*truncated && m<=(~0ULL-d)/10) {
+        m=m*10+d;
+        if (fraction)
+          (*exp10)--;
+      } else {
+        *truncated=true;
+        if (!fraction)
+          (*exp10)++;
+      }
+    }
+    
+    *man=m;
+    s->p=p;
+  }
+  
+  static inline bool scan_number(struct JSON *s, struct NumberToken *n) {
+    const jschar *start=s->p;
+    unsigned long long man=0;
+    int exp10=0;
+    int expn=0;
+    int expsgn=1;
+    bool truncated=false;
+    jschar c;
+    
+    n->integer=true;
+    n->negative=false;
+    if (peek(s)=='-') {
+      n->negative=true;
+      s->p++;
+    }
+    
+    c=peek(s);
+    if (c=='0')
+      s->p++;
+    else if (c>='1' && c<='9')
+      scan_digits(s, &man, &exp10, &truncated, false);
+    else
+      return false;
+    
+    if (peek(s)=='.') {
+      n->integer=false;
+      s->p++;
+      scan_digits(s, &man, &exp10, &truncated, true);
+    }
+    
+    c=peek(s);
+    if (c=='e' || c=='E') {
+      n->integer=false;
+      s->p++;
+      switch(peek(s)) {
+        case '+':
+          s->p++;
+          break;
+        case '-':
+          expsgn=-1;
+          s->p++;
+          break;
         case '0':
         case '1':
         case '2':
@@ -552,35 +2300,77 @@ namespace JSON {
         case '7':
         case '8':
         case '9':
-          expn=expn*10+*(s->p++)-'0';
           break;
         default:
-          goto expend;
+          return false;
+      }
+      while ((c=peek(s))>='0' && c<='9') {
+        if (expn<100000)
+          expn=expn*10+(c-'0');
+        s->p++;
+      }
+      exp10+=expsgn*expn;
+    }
+    
+    if (truncated)
+      n->integer=false;
+    if (n->negative && man>(1ULL<<63))
+      n->integer=false;
+    n->magnitude=man;
+    
+    if (!truncated) {
+      double d;
+      if (man==0 || exp10==0) {
+        d=(double)man;
+        n->value=n->negative ? -d : d;
+        return true;
+      }
+      if (man<=(1ULL<<53) && exp10>=-22 && exp10<=22) {
+        d=(double)man;
+        if (exp10<0)
+          d/=exact_powers_of_ten[-exp10];
+        else
+          d*=exact_powers_of_ten[exp10];
+        n->value=n->negative ? -d : d;
+        return true;
       }
+      if (eisel_lemire(man, exp10, n->negative, &n->value))
+        return true;
     }
     
-  expend:
-    n*=pow(10., expn*expsgn);
+    n->value=slow_number(start, s->p);
+    return true;
+  }
+  
+  static inline Number *parse_number(struct JSON *s) {
+    struct NumberToken n;
+    
+    if (!scan_number(s, &n))
+      return (Number *)syntaxerror(s);
     
-  end:
-    return new Number(sgn==1?n:-n, s->line_no);
+    JSON_NODE(s, number, sizeof(Number));
+    if (n.integer)
+      return new (s->arena) Number(n.magnitude, n.negative, s->line_no);
+    return new (s->arena) Number(n.value, s->line_no);
   }
   
   
   static inline Value *parse_value(struct JSON *s, jschar end) {
     for (;;) {
-      switch(*s->p) {
+      switch(peek(s)) {
         case ',':
           if (end!=0) {
-            return new Null(s->line_no);
+            JSON_NODE(s, null, sizeof(Null));
+            return new (s->arena) Null(s->line_no);
           } else {
             return (Value *)syntaxerror(s);
           }
           
         case ']':
         case '}':
-          if (*s->p==end) {
-            return new Null(s->line_no);
+          if (peek(s)==end) {
+            JSON_NODE(s, null, sizeof(Null));
+            return new (s->arena) Null(s->line_no);
           } else {
             return (Value *)syntaxerror(s);
           }
@@ -618,11 +2408,10 @@ namespace JSON {
           return parse_object(s);
           
         case '\n':
-          s->line_no++; // fall through
         case ' ':
         case '\t':
         case '\r':
-          s->p++;
+          skip_space(s);
           break;
         case '#':
         case '/':
@@ -636,84 +2425,2936 @@ namespace JSON {
     }
   }
   
+  /**
+     Moves the elements parsed so far from the stack into the array.
+     The array storage is allocated once, at its final size.
+   */
+  
+  static inline Array *finish_array(struct JSON *s, Array *array, size_t base) {
+    JSON_CLOSE(s);
+    if (s->stack.size()>base)
+      JSON_ALLOC(s, (s->stack.size()-base)*sizeof(Value *));
+    array->value.assign(s->stack.begin()+base, s->stack.end());
+    s->stack.resize(base);
+    return array;
+  }
+  
+  static Array *abort_array(struct JSON *s, Array *array, size_t base) {
+    size_t i;
+    JSON_CLOSE(s);
+    for (i=base; i<s->stack.size(); i++)
+      release(s, s->stack[i]);
+    s->stack.resize(base);
+    release(s, array);
+    return NULL;
+  }
+  
   static Array *parse_array(struct JSON *s) {
-    Array *array=new Array(s->line_no);
+    Array *array=new (s->arena) Array(s->line_no, s->arena);
+    size_t base=s->stack.size();
     
+    JSON_NODE(s, array, sizeof(Array));
+    JSON_OPEN(s);
     s->p++; // [
     
     for (;;) {
-      if ((*s->p)!=' ' &&
-          (*s->p)!='\t' &&
-          (*s->p)!='\n' &&
-          (*s->p)!='/' &&
-          (*s->p)!='#' &&
-          (*s->p)!='\r') break;
-      if ((*s->p)=='\n')
-        s->line_no++;
-      if (((*s->p)=='/' || (*s->p)=='#') && !ignore_comment(s))
-        return (Array *)syntaxerror(s);
+      jschar c=peek(s);
+      if (c==' ' ||
+          c=='\t' ||
+          c=='\n' ||
+          c=='\r') {
+        skip_space(s);
+        continue;
+      }
+      if (c!='/' &&
+          c!='#') break;
+      if (!ignore_comment(s)) {
+        syntaxerror(s);
+        return abort_array(s, array, base);
+      }
       s->p++;
     }
     
-    if (*s->p==']') {
+    if (peek(s)==']') {
       s->p++;
+      JSON_CLOSE(s);
       return array;
     }
     
     for (;;) {
       Value *v=parse_value(s, ']');
-      if (!v) {
-        delete array;
-        return NULL;
-      }
-      array->value.push_back(v);
+      if (!v)
+        return abort_array(s, array, base);
+      s->stack.push_back(v);
       
       // Scan for comma
       
-      while (*s->p!=',') {
-        switch(*(s->p++)) {
+      while (peek(s)!=',') {
+        switch(peek(s)) {
           case ']':
-            return array;
+            s->p++;
+            return finish_array(s, array, base);
           case '\n':
-            s->line_no++; // fall through
           case ' ':
           case '\t':
           case '\r':
+            skip_space(s);
             break;
           case '/':
           case '#':
-            if (!ignore_comment(s))
-              return (Array *)syntaxerror(s);
+            if (!ignore_comment(s)) {
+              syntaxerror(s);
+              return abort_array(s, array, base);
+            }
+            s->p++;
             break;
           default:
-            return (Array *)syntaxerror(s);
+            syntaxerror(s);
+            return abort_array(s, array, base);
         }
       }
       s->p++;
     }
     
     // not reached
-    return false;
+    return NULL;
   }
   
+  /**
+     Parses len bytes at str, allocating the values from the given
+     arena, or with new if the arena is NULL. If buf is not NULL, it
+     must point to the same bytes as str and may be modified. If insitu
+     is set, buf must be given, and strings will refer to it.
+   */
   
-  Value *decodeJSON(string str, ErrFunc *err, void *errData) {
-    struct JSON s;
-    
-    s.line_no=1;
+  static void init_state(struct JSON *s, Arena *arena,
+                         ErrFunc *err, void *errData) {
+    s->line_no=1;
     if (err)
-      s.err=err;
+      s->err=err;
     else
-      s.err=defaultError;
-    s.errData=errData;
-
-    jschar *c=strdup(str.c_str());
+      s->err=defaultError;
+    s->errData=errData;
+    s->arena=arena;
+    s->buf=NULL;
+    s->insitu=false;
+    s->k=kernels();
+#ifdef JSON_STATS
+    s->stats=NULL;
+    s->depth=0;
+#endif
+  }
+  
+  static Value *parse_buffer(const jschar *str, size_t len, jschar *buf,
+                             bool insitu, Arena *arena,
+                             ErrFunc *err, void *errData, int line_no=1,
+                             Stats *stats=NULL) {
+    struct JSON s;
+    Value *v;
     
-    s.p=c;
+    init_state(&s, arena, err, errData);
+    s.line_no=line_no;
+    s.p=str;
     s.start=s.p;
-    Value *ret=parse_value(&s, 0);
-    free(c);
-    return ret;
+    s.end=str+len;
+    s.buf=buf;
+    s.insitu=insitu;
+#ifdef JSON_STATS
+    double start=stats ? Stats::clock() : 0;
+    s.stats=stats;
+#else
+    (void)stats;
+#endif
+    v=parse_value(&s, 0);
+#ifdef JSON_STATS
+    if (stats) {
+      stats->parseTime+=Stats::clock()-start;
+      JSON_COUNT(&s, bytes, s.p-s.start);
+    }
+#endif
+    return v;
+  }
+  
+  Value *decodeJSON(const string &str, ErrFunc *err, void *errData, Stats *stats) {
+    return parse_buffer(str.data(), str.size(), NULL, false, NULL, err, errData,
+                        1, stats);
+  }
+  
+  Value *decodeJSON(const jschar *str, size_t len, ErrFunc *err, void *errData,
+                    Stats *stats) {
+    return parse_buffer(str, len, NULL, false, NULL, err, errData, 1, stats);
+  }
+  
+  Value *decodeJSONInPlace(jschar *str, size_t len, ErrFunc *err, void *errData) {
+    return parse_buffer(str, len, str, false, NULL, err, errData);
+  }
+  
+  Document::Document():
+  root(NULL) {
+  }
+  
+  Document::~Document() {
+    // The values are not destroyed one by one: everything they own is
+    // in the arena
+  }
+  
+  Value *Document::parse(const string &str, ErrFunc *err, void *errData,
+                         Stats *stats) {
+    return parse(str.data(), str.size(), err, errData, stats);
+  }
+  
+  Value *Document::parse(const jschar *str, size_t len, ErrFunc *err, void *errData,
+                         Stats *stats) {
+    clear();
+    root=parse_buffer(str, len, NULL, false, &arena, err, errData, 1, stats);
+    return root;
+  }
+  
+  void Document::clear(Stats *stats) {
+#ifdef JSON_STATS
+    double start=stats ? Stats::clock() : 0;
+#else
+    (void)stats;
+#endif
+    root=NULL;
+    arena.clear();
+#ifdef JSON_STATS
+    if (stats)
+      stats->freeTime+=Stats::clock()-start;
+#endif
+  }
+  
+  void release(Value *v, Stats *stats) {
+#ifdef JSON_STATS
+    double start=stats ? Stats::clock() : 0;
+#else
+    (void)stats;
+#endif
+    delete v;
+#ifdef JSON_STATS
+    if (stats)
+      stats->freeTime+=Stats::clock()-start;
+#endif
+  }
+  
+  Value *Document::parseInPlace(jschar *str, size_t len, ErrFunc *err, void *errData) {
+    root=NULL;
+    arena.clear();
+    root=parse_buffer(str, len, str, false, &arena, err, errData);
+    return root;
+  }
+  
+  Value *Document::parseInSitu(jschar *str, size_t len, ErrFunc *err, void *errData) {
+    root=NULL;
+    arena.clear();
+    root=parse_buffer(str, len, str, true, &arena, err, errData);
+    return root;
+  }
+  
+  Value *Document::parseFile(const string &path, ErrFunc *err, void *errData) {
+    MappedFile f;
+    root=NULL;
+    arena.clear();
+    if (!f.open(path, err, errData))
+      return NULL;
+    root=parse_buffer(f.data, f.size, NULL, false, &arena, err, errData);
+    return root;
+  }
+  
+  Value *decodeJSONFile(const string &path, ErrFunc *err, void *errData) {
+    MappedFile f;
+    if (!f.open(path, err, errData))
+      return NULL;
+    return parse_buffer(f.data, f.size, NULL, false, NULL, err, errData);
+  }
+  
+  MappedFile::MappedFile():
+  data(NULL), size(0), mapped(false), owned(false) {
+  }
+  
+  MappedFile::~MappedFile() {
+    close();
+  }
+  
+  static bool fileerror(const string &path, ErrFunc *err, void *errData) {
+    string msg="JSON: Cannot read "+path+": "+strerror(errno);
+    if (!err)
+      err=defaultError;
+    err(errData, msg);
+    return false;
+  }
+  
+#ifndef _WIN32
+  /**
+     Reads fd to the end into a new buffer.
+     @return false, with errno set, if a read fails
+   */
+  
+  static bool read_all(int fd, jschar **data, size_t *size) {
+    size_t capacity=65536;
+    jschar *buf=new jschar[capacity];
+    ssize_t n;
+    
+    *size=0;
+    for (;;) {
+      if (*size==capacity) {
+        jschar *bigger=new jschar[2*capacity];
+        memcpy(bigger, buf, *size);
+        delete[] buf;
+        buf=bigger;
+        capacity*=2;
+      }
+      n=::read(fd, buf+*size, capacity-*size);
+      if (n<0 && errno==EINTR)
+        continue;
+      if (n<=0)
+        break;
+      *size+=n;
+    }
+    if (n<0) {
+      delete[] buf;
+      *size=0;
+      return false;
+    }
+    *data=buf;
+    return true;
+  }
+  
+  bool MappedFile::open(const string &path, ErrFunc *err, void *errData) {
+    struct stat st;
+    int fd;
+    
+    close();
+    fd=::open(path.c_str(), O_RDONLY);
+    if (fd<0)
+      return fileerror(path, err, errData);
+    if (fstat(fd, &st)<0) {
+      fileerror(path, err, errData);
+      ::close(fd);
+      return false;
+    }
+    if (!S_ISREG(st.st_mode)) {
+      // A pipe, a FIFO or a file in /proc has no size to map, so it
+      // is read to the end instead
+      jschar *buf;
+      if (!read_all(fd, &buf, &size)) {
+        fileerror(path, err, errData);
+        ::close(fd);
+        return false;
+      }
+      ::close(fd);
+      data=buf;
+      owned=true;
+      return true;
+    }
+    size=st.st_size;
+    if (size==0) {
+      // mmap refuses empty mappings
+      ::close(fd);
+      data="";
+      return true;
+    }
+    void *p=mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p==MAP_FAILED) {
+      fileerror(path, err, errData);
+      ::close(fd);
+      size=0;
+      return false;
+    }
+    ::close(fd);
+    // The parser reads front to back, so read ahead and drop behind
+    madvise(p, size, MADV_SEQUENTIAL);
+    data=(const jschar *)p;
+    mapped=true;
+    return true;
+  }
+  
+  void MappedFile::close() {
+    if (mapped)
+      munmap((void *)data, size);
+    if (owned)
+      delete[] data;
+    data=NULL;
+    size=0;
+    mapped=false;
+    owned=false;
+  }
+#else
+  bool MappedFile::open(const string &path, ErrFunc *err, void *errData) {
+    close();
+    FILE *f=fopen(path.c_str(), "rb");
+    if (!f)
+      return fileerror(path, err, errData);
+    fseek(f, 0, SEEK_END);
+    long n=ftell(f);
+    fseek(f, 0, SEEK_SET);
+    jschar *buf=new jschar[n>0 ? n : 1];
+    if (n<0 || fread(buf, 1, n, f)!=(size_t)n) {
+      fileerror(path, err, errData);
+      delete[] buf;
+      fclose(f);
+      return false;
+    }
+    fclose(f);
+    data=buf;
+    size=n;
+    owned=true;
+    return true;
+  }
+  
+  void MappedFile::close() {
+    if (owned)
+      delete[] data;
+    data=NULL;
+    size=0;
+    mapped=false;
+    owned=false;
+  }
+#endif
+  
+  /*
+    Batch decoding of JSON Lines. The input is split into records
+    first, and the records are then handed out to the worker threads in
+    batches, each taken from a shared counter.
+  */
+  
+  void splitLines(const jschar *str, size_t len, std::vector<Record> *records) {
+    const jschar *end=str+len;
+    const jschar *p=str;
+    int lineno=1;
+    
+    records->clear();
+    while (p<end) {
+      const jschar *nl=(const jschar *)memchr(p, '\n', end-p);
+      if (!nl)
+        nl=end;
+      const jschar *q;
+      for (q=p; q<nl && (*q==' ' || *q=='\t' || *q=='\r'); q++);
+      if (q<nl) {
+        Record r;
+        r.data=p;
+        r.size=nl-p;
+        r.lineno=lineno;
+        records->push_back(r);
+      }
+      p=nl+1;
+      lineno++;
+    }
+  }
+  
+  enum {recordBatch=64};
+  
+  static int processors() {
+#ifndef _WIN32
+    return (int)sysconf(_SC_NPROCESSORS_ONLN);
+#else
+    return 1;
+#endif
+  }
+  
+  struct RecordJob {
+    std::vector<Record> *records;
+    RecordFunc *f;
+    void *data;
+    size_t next;          // the first record not yet taken
+#ifndef _WIN32
+    pthread_mutex_t lock;
+#endif
+  };
+  
+  static void *record_worker(void *arg) {
+    RecordJob *job=(RecordJob *)arg;
+    size_t n=job->records->size();
+    
+    for (;;) {
+#ifndef _WIN32
+      pthread_mutex_lock(&job->lock);
+#endif
+      size_t i=job->next;
+      job->next+=recordBatch;
+#ifndef _WIN32
+      pthread_mutex_unlock(&job->lock);
+#endif
+      if (i>=n)
+        return NULL;
+      size_t e=i+recordBatch<n ? i+recordBatch : n;
+      for (; i<e; i++)
+        job->f(job->data, i, &(*job->records)[i]);
+    }
+  }
+  
+  void forEachRecord(std::vector<Record> *records, RecordFunc *f, void *data,
+                     int threads) {
+    RecordJob job;
+    job.records=records;
+    job.f=f;
+    job.data=data;
+    job.next=0;
+    
+#ifndef _WIN32
+    if (threads<=0)
+      threads=processors();
+    size_t batches=(records->size()+recordBatch-1)/recordBatch;
+    if ((size_t)threads>batches)
+      threads=(int)batches;
+    if (threads<1)
+      threads=1;
+    std::vector<pthread_t> workers(threads-1);
+    int started;
+    pthread_mutex_init(&job.lock, NULL);
+    for (started=0; started<threads-1; started++)
+      if (pthread_create(&workers[started], NULL, record_worker, &job))
+        break;
+    // The calling thread takes its share too
+    record_worker(&job);
+    while (started>0)
+      pthread_join(workers[--started], NULL);
+    pthread_mutex_destroy(&job.lock);
+#else
+    record_worker(&job);
+#endif
+  }
+  
+  /**
+     Keeps the first error message of a record.
+   */
+  
+  void recordError(void *data, string msg) {
+    Record *r=(Record *)data;
+    if (r->error.empty())
+      r->error=msg;
+  }
+  
+  /**
+     Skips the whitespace and comments after the value at the end of
+     the input.
+     @return false, after reporting a syntax error, if anything else
+     follows
+   */
+  
+  static bool parse_end(struct JSON *s) {
+    if (!sax_space(s))
+      return false;
+    if (s->p<s->end) {
+      syntaxerror(s);
+      return false;
+    }
+    return true;
+  }
+  
+  static void decode_record(void *, size_t, Record *r) {
+    struct JSON s;
+    
+    init_state(&s, NULL, recordError, r);
+    s.line_no=r->lineno;
+    s.p=r->data;
+    s.start=s.p;
+    s.end=r->data+r->size;
+    r->value=parse_value(&s, 0);
+    // A record holds one value, and a second one would be lost
+    if (r->value && !parse_end(&s)) {
+      delete r->value;
+      r->value=NULL;
+    }
+  }
+  
+  bool decodeJSONLines(const jschar *str, size_t len, std::vector<Record> *records,
+                       int threads) {
+    size_t i;
+    
+    splitLines(str, len, records);
+    forEachRecord(records, decode_record, NULL, threads);
+    for (i=0; i<records->size(); i++)
+      if (!(*records)[i].value)
+        return false;
+    return true;
+  }
+  
+  /*
+    The push parser. The recursive descent of parse_value, parse_object
+    and parse_array is kept as a stack of frames, one per open
+    container, each with the state of its grammar. Tokens are read with
+    the same functions as above. A token that is cut off at the end of
+    a chunk is copied to a pending buffer and completed from the next
+    chunk; nothing else refers to the chunk once feed returns.
+  */
+  
+  enum PushState {
+    TOP_VALUE,    // before the root value
+    TOP_DONE,     // after it
+    ARRAY_FIRST,  // after [
+    ARRAY_VALUE,  // after ,
+    ARRAY_COMMA,  // after a value
+    OBJECT_KEY,   // after { or ,
+    OBJECT_COLON, // after a key
+    OBJECT_VALUE, // after :
+    OBJECT_COMMA  // after a value
+  };
+  
+  enum PushComment {
+    NO_COMMENT,
+    LINE_COMMENT,
+    BLOCK_COMMENT
+  };
+  
+  struct PushFrame {
+    Value *v;           // the container, or NULL at the top
+    size_t base;        // where its elements or members start on the stack
+    PushState state;
+    Str key;            // the key of the member being parsed
+  };
+  
+  struct Parser::State {
+    struct JSON s;
+    std::vector<PushFrame> frames;
+    Value *root;
+    Document *doc;
+    std::vector<jschar> pending; // a token cut off by the end of a chunk
+    bool escaped;       // the pending string ends with a backslash
+    PushComment comment;
+    bool star;          // the last character of a block comment was *
+    bool failed;
+  };
+  
+  static inline bool number_char(jschar c) {
+    return (c>='0' && c<='9') || c=='-' || c=='+' || c=='.' || c=='e' || c=='E';
+  }
+  
+  static inline bool word_char(jschar c) {
+    return (c>='A' && c<='Z') || (c>='a' && c<='z') || (c>='0' && c<='9') || c=='_';
+  }
+  
+  /**
+     Finds the end of a string whose opening quote has been seen.
+
+     @return The position after the closing quote (or after a NUL,
+     which the lexer will reject), or NULL if the string goes on past
+     end. *escaped carries a trailing backslash over to the next chunk.
+   */
+  
+  static const jschar *string_end(struct JSON *s, const jschar *p, bool *escaped) {
+    if (*escaped) {
+      if (p>=s->end)
+        return NULL;
+      p++;
+      *escaped=false;
+    }
+    for (;;) {
+      p=s->k->string(p, s->end);
+      if (p>=s->end)
+        return NULL;
+      if (*p!='\\')
+        return p+1;
+      if (p+1>=s->end) {
+        *escaped=true;
+        return NULL;
+      }
+      p+=2;
+    }
+  }
+  
+  /**
+     Finds the end of the token at s->p.
+
+     @return The end of the token, or NULL if it may go on in the next
+     chunk.
+   */
+  
+  static const jschar *token_end(Parser::State *st, bool final) {
+    struct JSON *s=&st->s;
+    const jschar *p=s->p;
+    const jschar *e;
+    
+    if (*p=='"') {
+      bool escaped=false;
+      e=string_end(s, p+1, &escaped);
+    } else if ((*p>='0' && *p<='9') || *p=='-' || *p=='+') {
+      for (e=p; e<s->end && number_char(*e); e++);
+      if (e==s->end)
+        e=NULL;
+    } else {
+      for (e=p; e<s->end && word_char(*e); e++);
+      if (e==s->end)
+        e=NULL;
+    }
+    if (!e && final)
+      e=s->end;
+    return e;
+  }
+  
+  /**
+     Moves the rest of the chunk to the pending buffer.
+   */
+  
+  static void save_pending(Parser::State *st) {
+    struct JSON *s=&st->s;
+    if (s->p<s->end && *s->p=='"') {
+      st->escaped=false;
+      string_end(s, s->p+1, &st->escaped);
+    }
+    st->pending.assign(s->p, s->end);
+    s->p=s->end;
+  }
+  
+  static void push_abort(Parser::State *st) {
+    struct JSON *s=&st->s;
+    while (st->frames.size()>1) {
+      PushFrame &f=st->frames.back();
+      if (f.v->getType()==Value::array)
+        abort_array(s, (Array *)f.v, f.base);
+      else
+        abort_object(s, (Object *)f.v, f.base);
+      st->frames.pop_back();
+    }
+    if (st->root && !st->doc)
+      delete st->root;
+    st->root=NULL;
+  }
+  
+  static bool push_error(Parser::State *st) {
+    syntaxerror(&st->s);
+    push_abort(st);
+    st->failed=true;
+    return false;
+  }
+  
+  /**
+     Hands a complete value to the innermost open container.
+   */
+  
+  static void push_add(Parser::State *st, Value *v) {
+    struct JSON *s=&st->s;
+    PushFrame &f=st->frames.back();
+    switch (f.state) {
+      case TOP_VALUE:
+        st->root=v;
+        f.state=TOP_DONE;
+        break;
+      case ARRAY_FIRST:
+      case ARRAY_VALUE:
+        s->stack.push_back(v);
+        f.state=ARRAY_COMMA;
+        break;
+      default:
+        s->members.push_back(Members::value_type(f.key, v));
+        f.state=OBJECT_COMMA;
+        break;
+    }
+  }
+  
+  static void push_close(Parser::State *st) {
+    struct JSON *s=&st->s;
+    PushFrame f=st->frames.back();
+    st->frames.pop_back();
+    if (f.v->getType()==Value::array)
+      push_add(st, finish_array(s, (Array *)f.v, f.base));
+    else
+      push_add(st, finish_object(s, (Object *)f.v, f.base));
+  }
+  
+  static void push_open(Parser::State *st, Value *v, PushState state) {
+    PushFrame f;
+    f.v=v;
+    f.state=state;
+    if (state==ARRAY_FIRST)
+      f.base=st->s.stack.size();
+    else
+      f.base=st->s.members.size();
+    st->frames.push_back(f);
+  }
+  
+  /**
+     Skips as much of the current comment as there is in the chunk.
+   */
+  
+  static void push_comment(Parser::State *st) {
+    struct JSON *s=&st->s;
+    
+    if (st->comment==LINE_COMMENT) {
+      const jschar *nl=(const jschar *)memchr(s->p, '\n', s->end-s->p);
+      if (nl) {
+        // The newline is counted as whitespace
+        s->p=nl;
+        st->comment=NO_COMMENT;
+      } else {
+        s->p=s->end;
+      }
+      return;
+    }
+    
+    while (s->p<s->end) {
+      const jschar *start=s->p;
+      s->p=s->k->find(s->p, s->end, '/', &s->line_no);
+      if (s->p>=s->end) {
+        if (s->p>start)
+          st->star=s->p[-1]=='*';
+        return;
+      }
+      bool star=s->p>start ? s->p[-1]=='*' : st->star;
+      s->p++;
+      st->star=false;
+      if (star) {
+        st->comment=NO_COMMENT;
+        return;
+      }
+    }
+  }
+  
+  /**
+     Parses the chunk from s->p to s->end. If final is set, the end of
+     the chunk ends the token being read.
+
+     @return false on syntax error.
+   */
+  
+  static bool push_run(Parser::State *st, bool final) {
+    struct JSON *s=&st->s;
+    const jschar *e;
+    const jschar *name;
+    int namelen;
+    Value *v;
+    
+    while (s->p<s->end) {
+      PushFrame &f=st->frames.back();
+      
+      if (f.state==TOP_DONE) {
+        // Like decodeJSON, ignore whatever follows the root value
+        s->p=s->end;
+        return true;
+      }
+      
+      if (st->comment) {
+        push_comment(st);
+        continue;
+      }
+      
+      jschar c=*s->p;
+      switch (c) {
+        case '\n':
+        case ' ':
+        case '\t':
+        case '\r':
+          skip_space(s);
+          continue;
+        case '#':
+          st->comment=LINE_COMMENT;
+          s->p++;
+          continue;
+        case '/':
+          if (s->p+1>=s->end) {
+            if (final)
+              return push_error(st);
+            save_pending(st);
+            return true;
+          }
+          if (s->p[1]=='/') {
+            st->comment=LINE_COMMENT;
+          } else if (s->p[1]=='*') {
+            st->comment=BLOCK_COMMENT;
+            st->star=true;
+          } else {
+            return push_error(st);
+          }
+          s->p+=2;
+          continue;
+      }
+      
+      switch (f.state) {
+        case TOP_VALUE:
+        case ARRAY_FIRST:
+        case ARRAY_VALUE:
+        case OBJECT_VALUE:
+          switch (c) {
+            case '[':
+              push_open(st, new (s->arena) Array(s->line_no, s->arena), ARRAY_FIRST);
+              s->p++;
+              continue;
+            case '{':
+              push_open(st, new (s->arena) Object(s->line_no, s->arena), OBJECT_KEY);
+              s->p++;
+              continue;
+            case ',':
+            case ']':
+            case '}':
+              if (f.state==TOP_VALUE)
+                return push_error(st);
+              if (f.state==ARRAY_FIRST && c==']') {
+                s->p++;
+                push_close(st);
+                continue;
+              }
+              if (c!=',' && c!=(f.state==OBJECT_VALUE ? '}' : ']'))
+                return push_error(st);
+              // An empty value is null; the delimiter is read next time round
+              push_add(st, new (s->arena) Null(s->line_no));
+              continue;
+          }
+          e=token_end(st, final);
+          if (!e) {
+            save_pending(st);
+            return true;
+          }
+          switch (c) {
+            case '"':
+              v=parse_string(s);
+              break;
+            case '0':
+            case '1':
+            case '2':
+            case '3':
+            case '4':
+            case '5':
+            case '6':
+            case '7':
+            case '8':
+            case '9':
+            case '-':
+            case '+':
+              v=parse_number(s);
+              break;
+            case 't':
+              v=parse_true(s);
+              break;
+            case 'f':
+              v=parse_false(s);
+              break;
+            case 'n':
+              v=parse_null(s);
+              break;
+            default:
+              v=(Value *)syntaxerror(s);
+          }
+          if (!v) {
+            push_abort(st);
+            st->failed=true;
+            return false;
+          }
+          push_add(st, v);
+          continue;
+          
+        case ARRAY_COMMA:
+        case OBJECT_COMMA:
+          if (c==',') {
+            f.state=f.state==ARRAY_COMMA ? ARRAY_VALUE : OBJECT_KEY;
+            s->p++;
+            continue;
+          }
+          if (c==(f.state==ARRAY_COMMA ? ']' : '}')) {
+            s->p++;
+            push_close(st);
+            continue;
+          }
+          return push_error(st);
+          
+        case OBJECT_KEY:
+          if (c=='}') {
+            s->p++;
+            push_close(st);
+            continue;
+          }
+          e=token_end(st, final);
+          if (!e) {
+            save_pending(st);
+            return true;
+          }
+          if (c=='"') {
+            namelen=parse_unescape(s, &name);
+          } else {
+            name=s->p;
+            namelen=parse_barename(s);
+          }
+          if (namelen==-1)
+            return push_error(st);
+          f.key=((Object *)f.v)->value.copyKey(name, namelen);
+          f.state=OBJECT_COLON;
+          continue;
+          
+        case OBJECT_COLON:
+          if (c!=':')
+            return push_error(st);
+          s->p++;
+          f.state=OBJECT_VALUE;
+          continue;
+          
+        default:
+          return push_error(st);
+      }
+    }
+    return true;
+  }
+  
+  /**
+     Completes the pending token with the start of the chunk and parses
+     it. Points s->p past the part of the chunk that was used.
+   */
+  
+  static bool push_pending(Parser::State *st, const jschar *data, size_t len, bool final) {
+    struct JSON *s=&st->s;
+    const jschar *e;
+    jschar first=st->pending[0];
+    
+    s->p=data;
+    s->end=data+len;
+    if (first=='/') {
+      e=len ? data+1 : NULL;
+    } else if (first=='"') {
+      e=string_end(s, data, &st->escaped);
+    } else {
+      bool number=(first>='0' && first<='9') || first=='-' || first=='+';
+      for (e=data; e<s->end && (number ? number_char(*e) : word_char(*e)); e++);
+      if (e==s->end)
+        e=NULL;
+    }
+    if (!e) {
+      st->pending.insert(st->pending.end(), data, data+len);
+      if (!final) {
+        s->p=s->end;
+        return true;
+      }
+      e=s->end;
+    } else {
+      st->pending.insert(st->pending.end(), data, e);
+    }
+    
+    std::vector<jschar> token;
+    token.swap(st->pending);
+    s->p=&token[0];
+    s->start=s->p;
+    s->end=s->p+token.size();
+    if (!push_run(st, true))
+      return false;
+    
+    s->p=e;
+    s->start=data;
+    s->end=data+len;
+    return true;
+  }
+  
+  Parser::Parser(ErrFunc *err, void *errData):
+  state(new State) {
+    init(NULL, err, errData);
+  }
+  
+  Parser::Parser(Document *doc, ErrFunc *err, void *errData):
+  state(new State) {
+    init(doc, err, errData);
+  }
+  
+  void Parser::init(Document *doc, ErrFunc *err, void *errData) {
+    State *st=state;
+    if (doc) {
+      doc->root=NULL;
+      doc->arena.clear();
+    }
+    init_state(&st->s, doc ? &doc->arena : NULL, err, errData);
+    PushFrame top;
+    top.v=NULL;
+    top.base=0;
+    top.state=TOP_VALUE;
+    st->frames.push_back(top);
+    st->root=NULL;
+    st->doc=doc;
+    st->escaped=false;
+    st->comment=NO_COMMENT;
+    st->star=false;
+    st->failed=false;
+  }
+  
+  Parser::~Parser() {
+    push_abort(state);
+    delete state;
+  }
+  
+  bool Parser::feed(const jschar *data, size_t len) {
+    State *st=state;
+    struct JSON *s=&st->s;
+    bool ok;
+    
+    if (st->failed)
+      return false;
+    if (!st->pending.empty()) {
+      ok=push_pending(st, data, len, false);
+    } else {
+      s->p=data;
+      s->start=data;
+      s->end=data+len;
+      ok=true;
+    }
+    if (ok)
+      ok=push_run(st, false);
+    s->p=s->start=s->end=NULL;
+    return ok;
+  }
+  
+  Value *Parser::finish() {
+    State *st=state;
+    
+    if (st->failed)
+      return NULL;
+    if (!st->pending.empty() && !push_pending(st, NULL, 0, true))
+      return NULL;
+    if (st->comment==BLOCK_COMMENT || st->frames.back().state!=TOP_DONE) {
+      push_error(st);
+      return NULL;
+    }
+    
+    Value *root=st->root;
+    st->root=NULL;
+    if (st->doc)
+      st->doc->root=root;
+    st->failed=true; // nothing more can be fed
+    return root;
+  }
+  
+  /*
+    The event parser. It follows parse_value, parse_array and
+    parse_object, but hands each token to a Handler instead of building
+    values.
+  */
+  
+  static bool sax_array(struct JSON *s, Handler *h);
+  static bool sax_object(struct JSON *s, Handler *h);
+  
+  static inline bool sax_string(struct JSON *s, Handler *h) {
+    const jschar *start;
+    int len=parse_unescape(s, &start);
+    
+    if (len==-1) {
+      syntaxerror(s);
+      return false;
+    }
+    h->lineno=s->line_no;
+    return h->stringValue(Str(start, len));
+  }
+  
+  static inline bool sax_number(struct JSON *s, Handler *h) {
+    struct NumberToken n;
+    
+    if (!scan_number(s, &n)) {
+      syntaxerror(s);
+      return false;
+    }
+    h->lineno=s->line_no;
+    if (n.integer) {
+      Number number(n.magnitude, n.negative, s->line_no);
+      return h->numberValue(number);
+    }
+    Number number(n.value, s->line_no);
+    return h->numberValue(number);
+  }
+  
+  static inline bool sax_word(struct JSON *s, Handler *h, const char *word) {
+    int i;
+    for (i=1; word[i]; i++)
+      if (peek(s, i)!=word[i]) {
+        syntaxerror(s);
+        return false;
+      }
+    s->p+=i;
+    h->lineno=s->line_no;
+    switch (word[0]) {
+      case 't':
+        return h->booleanValue(true);
+      case 'f':
+        return h->booleanValue(false);
+      default:
+        return h->nullValue();
+    }
+  }
+  
+  static bool sax_value(struct JSON *s, Handler *h, jschar end) {
+    for (;;) {
+      switch(peek(s)) {
+        case ',':
+        case ']':
+        case '}':
+          if (end!=0 && (peek(s)==',' || peek(s)==end)) {
+            h->lineno=s->line_no;
+            return h->nullValue();
+          }
+          syntaxerror(s);
+          return false;
+          
+        case '"':
+          return sax_string(s, h);
+          
+        case '0':
+        case '1':
+        case '2':
+        case '3':
+        case '4':
+        case '5':
+        case '6':
+        case '7':
+        case '8':
+        case '9':
+        case '-':
+        case '+':
+          return sax_number(s, h);
+          
+        case 't':
+          return sax_word(s, h, "true");
+          
+        case 'f':
+          return sax_word(s, h, "false");
+          
+        case 'n':
+          return sax_word(s, h, "null");
+          
+        case '[':
+          return sax_array(s, h);
+          
+        case '{':
+          return sax_object(s, h);
+          
+        case '\n':
+        case ' ':
+        case '\t':
+        case '\r':
+          skip_space(s);
+          break;
+        case '#':
+        case '/':
+          if (!ignore_comment(s)) {
+            syntaxerror(s);
+            return false;
+          }
+          s->p++;
+          break;
+        default:
+          syntaxerror(s);
+          return false;
+      }
+    }
+  }
+  
+  /**
+     Skips whitespace and comments up to the next token.
+
+     @return false in case of syntax error
+   */
+  
+  static inline bool sax_space(struct JSON *s) {
+    for (;;) {
+      switch(peek(s)) {
+        case '\n':
+        case ' ':
+        case '\t':
+        case '\r':
+          skip_space(s);
+          break;
+        case '#':
+        case '/':
+          if (!ignore_comment(s)) {
+            syntaxerror(s);
+            return false;
+          }
+          s->p++;
+          break;
+        default:
+          return true;
+      }
+    }
+  }
+  
+  static bool sax_array(struct JSON *s, Handler *h) {
+    h->lineno=s->line_no;
+    if (!h->startArray())
+      return false;
+    
+    s->p++; // [
+    
+    if (!sax_space(s))
+      return false;
+    
+    if (peek(s)!=']') {
+      for (;;) {
+        if (!sax_value(s, h, ']'))
+          return false;
+        
+        // Scan for comma
+        
+        if (!sax_space(s))
+          return false;
+        if (peek(s)==']')
+          break;
+        if (peek(s)!=',') {
+          syntaxerror(s);
+          return false;
+        }
+        s->p++;
+      }
+    }
+    
+    s->p++; // ]
+    h->lineno=s->line_no;
+    return h->endArray();
+  }
+  
+  static bool sax_object(struct JSON *s, Handler *h) {
+    const jschar *name;
+    int namelen;
+    
+    h->lineno=s->line_no;
+    if (!h->startObject())
+      return false;
+    
+    s->p++; // {
+    
+    for (;;) {
+      if (!sax_space(s))
+        return false;
+      if (peek(s)=='}')
+        break;
+      
+      if (peek(s)=='"') {
+        namelen=parse_unescape(s, &name);
+      } else {
+        name=s->p;
+        namelen=parse_barename(s);
+      }
+      if (namelen==-1) {
+        syntaxerror(s);
+        return false;
+      }
+      
+      h->lineno=s->line_no;
+      if (!h->key(Str(name, namelen)))
+        return false;
+      
+      // scan for colon
+      if (!sax_space(s))
+        return false;
+      if (peek(s)!=':') {
+        syntaxerror(s);
+        return false;
+      }
+      s->p++;
+      
+      if (!sax_value(s, h, '}'))
+        return false;
+      
+      // Scan for comma
+      if (!sax_space(s))
+        return false;
+      if (peek(s)=='}')
+        break;
+      if (peek(s)!=',') {
+        syntaxerror(s);
+        return false;
+      }
+      s->p++;
+    }
+    
+    s->p++; // }
+    h->lineno=s->line_no;
+    return h->endObject();
+  }
+  
+  bool decodeJSON(const jschar *str, size_t len, Handler *handler,
+                  ErrFunc *err, void *errData) {
+    struct JSON s;
+    
+    init_state(&s, NULL, err, errData);
+    s.p=str;
+    s.start=str;
+    s.end=str+len;
+    return sax_value(&s, handler, 0);
+  }
+  
+  bool decodeJSON(const string &str, Handler *handler, ErrFunc *err, void *errData) {
+    return decodeJSON(str.data(), str.size(), handler, err, errData);
+  }
+  
+  /*
+    The pull parser. Each open container is kept on a stack with its
+    closing bracket, which also ends an empty value.
+  */
+  
+  struct ReaderFrame {
+    jschar end;
+    bool first;
+  };
+  
+  struct Reader::State {
+    struct JSON s;
+    std::vector<ReaderFrame> frames;
+  };
+  
+  Reader::Reader(const jschar *str, size_t len, ErrFunc *err, void *errData,
+                 int lineno, Stats *stats):
+  state(new State) {
+    struct JSON *s=&state->s;
+    init_state(s, NULL, err, errData);
+    s->line_no=lineno;
+    s->p=str;
+    s->start=str;
+    s->end=str+len;
+#ifdef JSON_STATS
+    s->stats=stats;
+#else
+    (void)stats;
+#endif
+  }
+  
+  Reader::~Reader() {
+    JSON_COUNT(&state->s, bytes, state->s.p-state->s.start);
+    delete state;
+  }
+  
+  /**
+     @return true if the next value is empty, that is, the input is at
+     a comma or at the end of the current container.
+   */
+  
+  static inline bool reader_empty(Reader::State *st) {
+    jschar c=peek(&st->s);
+    if (st->frames.empty())
+      return false;
+    return c==',' || c==st->frames.back().end;
+  }
+  
+  bool Reader::peek(Value::type *type) {
+    struct JSON *s=&state->s;
+    
+    if (!sax_space(s))
+      return false;
+    if (reader_empty(state)) {
+      *type=Value::null;
+      return true;
+    }
+    switch(::JSON::peek(s)) {
+      case '"':
+        *type=Value::string;
+        return true;
+      case '0':
+      case '1':
+      case '2':
+      case '3':
+      case '4':
+      case '5':
+      case '6':
+      case '7':
+      case '8':
+      case '9':
+      case '-':
+      case '+':
+        *type=Value::number;
+        return true;
+      case 't':
+      case 'f':
+        *type=Value::boolean;
+        return true;
+      case 'n':
+        *type=Value::null;
+        return true;
+      case '[':
+        *type=Value::array;
+        return true;
+      case '{':
+        *type=Value::object;
+        return true;
+      default:
+        syntaxerror(s);
+        return false;
+    }
+  }
+  
+  static bool reader_open(Reader::State *st, jschar open, jschar end) {
+    struct JSON *s=&st->s;
+    
+    if (!sax_space(s))
+      return false;
+    if (peek(s)!=open) {
+      syntaxerror(s);
+      return false;
+    }
+    s->p++;
+    ReaderFrame f;
+    f.end=end;
+    f.first=true;
+    st->frames.push_back(f);
+    if (open=='[')
+      JSON_COUNT(s, nodes[Value::array], 1);
+    else
+      JSON_COUNT(s, nodes[Value::object], 1);
+    JSON_DEPTH(s, (int)st->frames.size());
+    return true;
+  }
+  
+  /**
+     Reads the comma before the next element or member, or the end of
+     the container.
+   */
+  
+  static bool reader_next(Reader::State *st, bool *more) {
+    struct JSON *s=&st->s;
+    ReaderFrame &f=st->frames.back();
+    
+    if (!sax_space(s))
+      return false;
+    if (peek(s)==f.end) {
+      if (s->p<s->end)
+        s->p++;
+      st->frames.pop_back();
+      *more=false;
+      return true;
+    }
+    if (f.first) {
+      f.first=false;
+    } else {
+      if (peek(s)!=',') {
+        syntaxerror(s);
+        return false;
+      }
+      s->p++;
+    }
+    *more=true;
+    return true;
+  }
+  
+  bool Reader::startObject() {
+    return reader_open(state, '{', '}');
+  }
+  
+  bool Reader::nextMember(Str *key, bool *more) {
+    struct JSON *s=&state->s;
+    const jschar *name;
+    int namelen;
+    
+    if (!reader_next(state, more))
+      return false;
+    if (!*more)
+      return true;
+    
+    // A comma may end the object
+    if (!sax_space(s))
+      return false;
+    if (::JSON::peek(s)=='}') {
+      s->p++;
+      state->frames.pop_back();
+      *more=false;
+      return true;
+    }
+    
+    if (::JSON::peek(s)=='"') {
+      namelen=parse_unescape(s, &name);
+    } else {
+      name=s->p;
+      namelen=parse_barename(s);
+    }
+    if (namelen==-1) {
+      syntaxerror(s);
+      return false;
+    }
+    *key=Str(name, namelen);
+    
+    // scan for colon
+    if (!sax_space(s))
+      return false;
+    if (::JSON::peek(s)!=':') {
+      syntaxerror(s);
+      return false;
+    }
+    s->p++;
+    return true;
+  }
+  
+  bool Reader::startArray() {
+    return reader_open(state, '[', ']');
+  }
+  
+  void Reader::startElements() {
+    ReaderFrame f;
+    f.end=0;
+    f.first=false;
+    state->frames.push_back(f);
+  }
+  
+  bool Reader::nextElement(bool *more) {
+    struct JSON *s=&state->s;
+    ReaderFrame &f=state->frames.back();
+    
+    if (!f.first)
+      return reader_next(state, more);
+    
+    // [] is empty, but [,] has two elements
+    f.first=false;
+    if (!sax_space(s))
+      return false;
+    if (::JSON::peek(s)==']') {
+      s->p++;
+      state->frames.pop_back();
+      *more=false;
+      return true;
+    }
+    *more=true;
+    return true;
+  }
+  
+  bool Reader::readString(Str *value) {
+    struct JSON *s=&state->s;
+    const jschar *start;
+    int len;
+    
+    if (!sax_space(s))
+      return false;
+    if (::JSON::peek(s)!='"') {
+      syntaxerror(s);
+      return false;
+    }
+    len=parse_unescape(s, &start);
+    if (len==-1) {
+      syntaxerror(s);
+      return false;
+    }
+    JSON_COUNT(s, nodes[Value::string], 1);
+    *value=Str(start, len);
+    return true;
+  }
+  
+  bool Reader::readNumber(double *value) {
+    struct JSON *s=&state->s;
+    struct NumberToken n;
+    
+    if (!sax_space(s))
+      return false;
+    if (!scan_number(s, &n)) {
+      syntaxerror(s);
+      return false;
+    }
+    JSON_COUNT(s, nodes[Value::number], 1);
+    *value=n.value;
+    return true;
+  }
+  
+  bool Reader::readNumbers(double *values, size_t size, size_t *n, bool *more) {
+    struct JSON *s=&state->s;
+    struct NumberToken t;
+    jschar c;
+    
+    *n=0;
+    *more=true;
+    if (!size)
+      return true;
+    if (!nextElement(more))
+      return false;
+    while (*more) {
+      if (!sax_space(s))
+        return false;
+      c=::JSON::peek(s);
+      if (!((c>='0' && c<='9') || c=='-' || c=='+'))
+        return true;
+      if (!scan_number(s, &t)) {
+        syntaxerror(s);
+        return false;
+      }
+      JSON_COUNT(s, nodes[Value::number], 1);
+      values[(*n)++]=t.value;
+      // Full: stop before the comma, where nextElement would be
+      if (*n==size)
+        return true;
+      // The common case: a comma straight after the number
+      if (s->p<s->end && *s->p==',') {
+        s->p++;
+        continue;
+      }
+      if (!reader_next(state, more))
+        return false;
+    }
+    return true;
+  }
+  
+  bool Reader::readNumbers(std::vector<double> *values, bool *more) {
+    size_t at, size, n;
+    
+    for (;;) {
+      at=values->size();
+      size=at<64 ? 64 : at;
+      values->resize(at+size);
+      if (!readNumbers(&(*values)[at], size, &n, more)) {
+        values->resize(at+n);
+        return false;
+      }
+      values->resize(at+n);
+      if (!*more || n<size)
+        return true;
+    }
+  }
+  
+  bool Reader::readBoolean(bool *value) {
+    struct JSON *s=&state->s;
+    
+    if (!sax_space(s))
+      return false;
+    if (::JSON::peek(s)=='t' &&
+        ::JSON::peek(s, 1)=='r' &&
+        ::JSON::peek(s, 2)=='u' &&
+        ::JSON::peek(s, 3)=='e') {
+      s->p+=4;
+      JSON_COUNT(s, nodes[Value::boolean], 1);
+      *value=true;
+      return true;
+    }
+    if (::JSON::peek(s)=='f' &&
+        ::JSON::peek(s, 1)=='a' &&
+        ::JSON::peek(s, 2)=='l' &&
+        ::JSON::peek(s, 3)=='s' &&
+        ::JSON::peek(s, 4)=='e') {
+      s->p+=5;
+      JSON_COUNT(s, nodes[Value::boolean], 1);
+      *value=false;
+      return true;
+    }
+    syntaxerror(s);
+    return false;
+  }
+  
+  bool Reader::readNull() {
+    struct JSON *s=&state->s;
+    
+    if (!sax_space(s))
+      return false;
+    if (reader_empty(state)) {
+      JSON_COUNT(s, nodes[Value::null], 1);
+      return true;
+    }
+    if (::JSON::peek(s)=='n' &&
+        ::JSON::peek(s, 1)=='u' &&
+        ::JSON::peek(s, 2)=='l' &&
+        ::JSON::peek(s, 3)=='l') {
+      s->p+=4;
+      JSON_COUNT(s, nodes[Value::null], 1);
+      return true;
+    }
+    syntaxerror(s);
+    return false;
+  }
+  
+  bool Reader::skip() {
+    Value::type type;
+    Str str;
+    double d;
+    bool b;
+    bool more;
+    
+    if (!peek(&type))
+      return false;
+    switch (type) {
+      case Value::string:
+        return readString(&str);
+      case Value::number:
+        return readNumber(&d);
+      case Value::boolean:
+        return readBoolean(&b);
+      case Value::null:
+        return readNull();
+      case Value::array:
+        if (!startArray())
+          return false;
+        for (;;) {
+          if (!nextElement(&more))
+            return false;
+          if (!more)
+            return true;
+          if (!skip())
+            return false;
+        }
+      default:
+        if (!startObject())
+          return false;
+        for (;;) {
+          if (!nextMember(&str, &more))
+            return false;
+          if (!more)
+            return true;
+          if (!skip())
+            return false;
+        }
+    }
+  }
+  
+  bool Reader::end() {
+    return parse_end(&state->s);
+  }
+  
+  Value *Reader::readValue(Arena *arena) {
+    struct JSON *s=&state->s;
+    Arena *saved=s->arena;
+    Value *v;
+    
+    if (!sax_space(s))
+      return NULL;
+    if (reader_empty(state)) {
+      JSON_NODE(s, null, sizeof(Null));
+      return new (arena) Null(s->line_no);
+    }
+    s->arena=arena;
+#ifdef JSON_STATS
+    s->depth=(int)state->frames.size();
+#endif
+    v=parse_value(s, 0);
+    s->arena=saved;
+    return v;
+  }
+  
+  int Reader::lineno() {
+    return state->s.line_no;
+  }
+  
+  /*
+    Parallel parsing of a large array. A structural scan finds the
+    commas between the top-level elements, and counts lines the way the
+    parser does. The elements between chosen commas are then parsed on
+    separate threads, straight into their places in the array.
+  */
+  
+  enum {minimumPiece=65536};
+  
+  /**
+     Skips the comment at p.
+     @return The character after it, or NULL if it does not end
+   */
+  
+  static const jschar *skip_comment_text(const Kernels *k, const jschar *p,
+                                         const jschar *end, int *line) {
+    if (*p=='#' || (p+1<end && p[1]=='/'))
+      return (const jschar *)memchr(p, '\n', end-p);
+    if (p+1>=end || p[1]!='*')
+      return NULL;
+    // As in ignore_block_comment, "/*/" is a whole comment
+    for (p+=2; ; p++) {
+      p=k->find(p, end, '/', line);
+      if (p>=end)
+        return NULL;
+      if (p[-1]=='*')
+        return p+1;
+    }
+  }
+  
+  /**
+     Finds the pieces of the array in str, and the line of its opening
+     bracket.
+   */
+  
+  static bool split_array(const jschar *str, size_t len, size_t pieces,
+                          std::vector<Record> *chunks, std::vector<size_t> *first,
+                          int *arrayline) {
+    const Kernels *k=kernels();
+    const jschar *p=str;
+    const jschar *end=str+len;
+    const jschar *start;
+    size_t target;
+    size_t commas=0;    // in the current piece
+    size_t total=0;
+    int depth=0;
+    int line=1;
+    int startline;
+    bool content=false; // anything but space and comments in the piece
+    
+    if (pieces==0)
+      pieces=4*processors();
+    target=len/pieces;
+    if (target<minimumPiece)
+      target=minimumPiece;
+    chunks->clear();
+    first->clear();
+    
+    // Up to the opening bracket
+    for (p=k->space(p, end, &line); p<end && (*p=='#' || *p=='/');
+         p=k->space(p, end, &line))
+      if (!(p=skip_comment_text(k, p, end, &line)))
+        return false;
+    if (p>=end || *p!='[')
+      return false;
+    *arrayline=line;
+    start=++p;
+    startline=line;
+    
+    while (p<end) {
+      switch (*p) {
+        case '"':
+          for (p++; ; p+=2) {
+            p=k->string(p, end);
+            if (p>=end || *p!='\\')
+              break;
+          }
+          if (p>=end || *p!='"')
+            return false;
+          content=true;
+          break;
+        case '[':
+        case '{':
+          depth++;
+          content=true;
+          break;
+        case ']':
+        case '}':
+          if (depth==0) {
+            if (*p!=']')
+              return false;
+            Record r;
+            r.data=start;
+            r.size=p-start;
+            r.lineno=startline;
+            if (!chunks->empty() || content || commas) {
+              chunks->push_back(r);
+              first->push_back(total);
+              total+=commas+1;
+            }
+            first->push_back(total);
+            return true;
+          }
+          depth--;
+          break;
+        case '\n':
+          line++;
+          break;
+        case ' ':
+        case '\t':
+        case '\r':
+          break;
+        case '#':
+        case '/':
+          if (!(p=skip_comment_text(k, p, end, &line)))
+            return false;
+          continue;
+        case ',':
+          if (depth==0 && (size_t)(p-start)>=target) {
+            Record r;
+            r.data=start;
+            r.size=p-start;
+            r.lineno=startline;
+            chunks->push_back(r);
+            first->push_back(total);
+            total+=commas+1;
+            commas=0;
+            start=p+1;
+            startline=line;
+            content=false;
+          } else {
+            if (depth==0)
+              commas++;
+            content=true;
+          }
+          break;
+        default:
+          content=true;
+      }
+      p++;
+    }
+    return false;
+  }
+  
+  bool splitArray(const jschar *str, size_t len, size_t pieces,
+                  std::vector<Record> *chunks, std::vector<size_t> *first) {
+    int line;
+    return split_array(str, len, pieces, chunks, first, &line);
+  }
+  
+  struct ArrayJob {
+    Array *array;
+    std::vector<size_t> *first;
+    Arena *arenas;        // one per piece, or NULL for the heap
+  };
+  
+  /**
+     Parses the elements of one piece of the array into their places.
+   */
+  
+  static void decode_elements(void *data, size_t index, Record *r) {
+    ArrayJob *job=(ArrayJob *)data;
+    struct JSON s;
+    size_t i=(*job->first)[index];
+    size_t e=(*job->first)[index+1];
+    
+    init_state(&s, job->arenas ? &job->arenas[index] : NULL, recordError, r);
+    s.line_no=r->lineno;
+    s.p=r->data;
+    s.start=s.p;
+    s.end=s.p+r->size;
+    
+    for (;;) {
+      Value *v;
+      if (!sax_space(&s))
+        return;
+      if (i>=e) {
+        syntaxerror(&s);
+        return;
+      }
+      if (s.p>=s.end || peek(&s)==',')
+        v=new (s.arena) Null(s.line_no);
+      else
+        v=parse_value(&s, ']');
+      if (!v)
+        return;
+      job->array->value[i++]=v;
+      
+      if (!sax_space(&s))
+        return;
+      if (s.p>=s.end)
+        break;
+      if (peek(&s)!=',') {
+        syntaxerror(&s);
+        return;
+      }
+      s.p++;
+    }
+    if (i!=e)
+      syntaxerror(&s);
+  }
+  
+  /**
+     Parses str, splitting a large array between threads. The values
+     are allocated from arena, or from the heap if it is NULL.
+   */
+  
+  static Value *parse_parallel(const jschar *str, size_t len, ErrFunc *err,
+                               void *errData, int threads, Arena *arena) {
+    std::vector<Record> chunks;
+    std::vector<size_t> first;
+    int line;
+    size_t i;
+    
+    if (threads<=0)
+      threads=processors();
+    if (threads==1 || len<2*minimumPiece ||
+        !split_array(str, len, 4*threads, &chunks, &first, &line))
+      return parse_buffer(str, len, NULL, false, arena, err, errData);
+    
+    ArrayJob job;
+    job.array=new (arena) Array(line, arena);
+    job.array->value.resize(first.back());
+    job.first=&first;
+    // An arena is not shared between threads, so each piece gets its own
+    job.arenas=arena ? new Arena[chunks.size()] : NULL;
+    forEachRecord(&chunks, decode_elements, &job, threads);
+    if (arena) {
+      for (i=0; i<chunks.size(); i++)
+        arena->adopt(&job.arenas[i]);
+      delete[] job.arenas;
+    }
+    
+    // Report the first error, as parsing in one piece would have
+    for (i=0; i<chunks.size(); i++)
+      if (!chunks[i].error.empty())
+        break;
+    if (i<chunks.size()) {
+      if (!err)
+        err=defaultError;
+      err(errData, chunks[i].error);
+      if (!arena)
+        delete job.array;
+      return NULL;
+    }
+    return job.array;
+  }
+  
+  Value *decodeJSONParallel(const jschar *str, size_t len, ErrFunc *err,
+                            void *errData, int threads) {
+    return parse_parallel(str, len, err, errData, threads, NULL);
+  }
+  
+  Value *Document::parseParallel(const jschar *str, size_t len, ErrFunc *err,
+                                 void *errData, int threads) {
+    root=NULL;
+    arena.clear();
+    root=parse_parallel(str, len, err, errData, threads, &arena);
+    return root;
+  }
+  
+  /*
+    The tape. It is written by a Handler, so it is parsed with the same
+    grammar as everything else.
+  */
+  
+  class TapeBuilder : public Handler {
+  public:
+    TapeBuilder(Tape *atape):tape(atape){};
+    
+    void add(Tape::tag t, unsigned long long payload) {
+      tape->entries.push_back(((unsigned long long)t<<56) | payload);
+      tape->lines.push_back(lineno);
+    }
+    
+    void addWord(unsigned long long w) {
+      tape->entries.push_back(w);
+      tape->lines.push_back(lineno);
+    }
+    
+    void addString(Tape::tag t, Str str) {
+      std::vector<jschar> &strings=tape->strings;
+      size_t off=strings.size();
+      unsigned n=(unsigned)str.size();
+      strings.resize(off+sizeof n+n+1);
+      memcpy(&strings[off], &n, sizeof n);
+      memcpy(&strings[off+sizeof n], str.data(), n);
+      strings[off+sizeof n+n]=0;
+      add(t, off);
+    }
+    
+    bool startObject() {
+      open.push_back(tape->entries.size());
+      add(Tape::objectTag, 0);
+      return true;
+    }
+    
+    bool startArray() {
+      open.push_back(tape->entries.size());
+      add(Tape::arrayTag, 0);
+      return true;
+    }
+    
+    bool endObject() {
+      return endArray();
+    }
+    
+    bool endArray() {
+      size_t start=open.back();
+      open.pop_back();
+      tape->entries[start]|=tape->entries.size();
+      add(Tape::endTag, start);
+      return true;
+    }
+    
+    bool key(Str name) {
+      addString(Tape::keyTag, name);
+      return true;
+    }
+    
+    bool stringValue(Str value) {
+      addString(Tape::stringTag, value);
+      return true;
+    }
+    
+    bool numberValue(Number &value) {
+      unsigned long long u;
+      long long i;
+      if (value.getUInt64(&u) && !signbit(value.value)) {
+        add(Tape::integerTag, 0);
+        addWord(u);
+      } else if (value.getInt64(&i)) {
+        add(Tape::integerTag, 1);
+        addWord(0-(unsigned long long)i);
+      } else {
+        add(Tape::doubleTag, 0);
+        memcpy(&u, &value.value, sizeof u);
+        addWord(u);
+      }
+      return true;
+    }
+    
+    bool booleanValue(bool value) {
+      add(value ? Tape::trueTag : Tape::falseTag, 0);
+      return true;
+    }
+    
+    bool nullValue() {
+      add(Tape::nullTag, 0);
+      return true;
+    }
+    
+  private:
+    Tape *tape;
+    std::vector<size_t> open; // the start entries of the open containers
+  };
+  
+  Tape::Tape() {
+  }
+  
+  void Tape::clear() {
+    entries.clear();
+    strings.clear();
+    lines.clear();
+  }
+  
+  bool Tape::parse(const jschar *str, size_t len, ErrFunc *err, void *errData) {
+    TapeBuilder b(this);
+    
+    clear();
+    if (!decodeJSON(str, len, &b, err, errData)) {
+      clear();
+      return false;
+    }
+    // Ends the root, so that root().next() is not valid
+    b.lineno=0;
+    b.add(endTag, 0);
+    return true;
+  }
+  
+  bool Tape::parse(const string &str, ErrFunc *err, void *errData) {
+    return parse(str.data(), str.size(), err, errData);
+  }
+  
+  Str Tape::stringAt(size_t i) const {
+    size_t off=payloadAt(i);
+    unsigned n;
+    memcpy(&n, &strings[off], sizeof n);
+    return Str(&strings[off+sizeof n], n);
+  }
+  
+  Value::type Tape::Cursor::getType() const {
+    switch (tape->tagAt(i)) {
+      case objectTag:
+        return Value::object;
+      case arrayTag:
+        return Value::array;
+      case stringTag:
+        return Value::string;
+      case doubleTag:
+      case integerTag:
+        return Value::number;
+      case trueTag:
+      case falseTag:
+        return Value::boolean;
+      default:
+        return Value::null;
+    }
+  }
+  
+  Tape::Cursor Tape::Cursor::child() const {
+    size_t j=i+1;
+    if (tape->tagAt(j)==keyTag)
+      j++;
+    return Cursor(tape, j);
+  }
+  
+  Tape::Cursor Tape::Cursor::next() const {
+    size_t j;
+    switch (tape->tagAt(i)) {
+      case objectTag:
+      case arrayTag:
+        j=tape->payloadAt(i)+1;
+        break;
+      case doubleTag:
+      case integerTag:
+        j=i+2;
+        break;
+      default:
+        j=i+1;
+    }
+    if (tape->tagAt(j)==keyTag)
+      j++;
+    return Cursor(tape, j);
+  }
+  
+  double Tape::Cursor::getNumber() const {
+    unsigned long long w=tape->entries[i+1];
+    double d;
+    if (tape->tagAt(i)==integerTag) {
+      d=(double)w;
+      return tape->payloadAt(i) ? -d : d;
+    }
+    memcpy(&d, &w, sizeof d);
+    return d;
+  }
+  
+  bool Tape::Cursor::getInt64(long long *ret) const {
+    unsigned long long w=tape->entries[i+1];
+    if (tape->tagAt(i)!=integerTag)
+      return false;
+    if (tape->payloadAt(i)) {
+      if (w>(1ULL<<63))
+        return false;
+      *ret=(long long)(0-w);
+    } else {
+      if (w>(~0ULL>>1))
+        return false;
+      *ret=(long long)w;
+    }
+    return true;
+  }
+  
+  Tape::Cursor Tape::Cursor::find(const Str &name) const {
+    Cursor c;
+    Cursor found;
+    // The last of several members with the same key wins, as in Object
+    for (c=child(); c.valid(); c=c.next())
+      if (c.key()==name)
+        found=c;
+    return found;
+  }
+  
+  Value *Tape::Cursor::toValue(Arena *arena) const {
+    int line=lineno();
+    Cursor c;
+    size_t n=0;
+    
+    switch (tape->tagAt(i)) {
+      case objectTag: {
+        Object *o=new (arena) Object(line, arena);
+        for (c=child(); c.valid(); c=c.next())
+          n++;
+        o->value.reserve(n);
+        for (c=child(); c.valid(); c=c.next()) {
+          Str k=c.key();
+          Value *v=c.toValue(arena);
+          std::pair<Members::iterator, bool> r=
+            o->value.insert(Members::value_type(o->value.copyKey(k.data(), k.size()), v));
+          if (!r.second) {
+            if (!arena)
+              delete r.first->second;
+            r.first->second=v;
+          }
+        }
+        return o;
+      }
+      case arrayTag: {
+        Array *a=new (arena) Array(line, arena);
+        for (c=child(); c.valid(); c=c.next())
+          n++;
+        a->value.reserve(n);
+        for (c=child(); c.valid(); c=c.next())
+          a->value.push_back(c.toValue(arena));
+        return a;
+      }
+      case stringTag: {
+        Str str=getString();
+        return new (arena) String(str.data(), str.size(), line, arena);
+      }
+      case integerTag:
+        return new (arena) Number(tape->entries[i+1], tape->payloadAt(i)!=0, line);
+      case doubleTag:
+        return new (arena) Number(getNumber(), line);
+      case trueTag:
+        return new (arena) Boolean(true, line);
+      case falseTag:
+        return new (arena) Boolean(false, line);
+      default:
+        return new (arena) Null(line);
+    }
+  }
+  
+  /*
+    The lazy document. A container is skipped by matching brackets,
+    passing over strings and comments, and counting lines as the parser
+    does.
+  */
+  
+  /**
+     @return The position after the container that starts at p, or
+     NULL if it does not end.
+   */
+  
+  static const jschar *skip_container(const Kernels *k, const jschar *p,
+                                      const jschar *end, int *line) {
+    int depth=0;
+    
+    for (; p<end; p++) {
+      switch (*p) {
+        case '"':
+          for (p++; ; p+=2) {
+            p=k->string(p, end);
+            if (p>=end || *p!='\\')
+              break;
+          }
+          if (p>=end || *p!='"')
+            return NULL;
+          break;
+        case '[':
+        case '{':
+          depth++;
+          break;
+        case ']':
+        case '}':
+          if (--depth==0)
+            return p+1;
+          break;
+        case '\n':
+          (*line)++;
+          break;
+        case '#':
+        case '/':
+          if (*p=='#' || (p+1<end && p[1]=='/')) {
+            const jschar *nl=(const jschar *)memchr(p, '\n', end-p);
+            if (!nl)
+              return NULL;
+            p=nl-1;
+            break;
+          }
+          if (p+1>=end || p[1]!='*')
+            break;    // the parser will complain
+          for (p+=2; ; p++) {
+            p=k->find(p, end, '/', line);
+            if (p>=end)
+              return NULL;
+            if (p[-1]=='*')
+              break;
+          }
+          break;
+      }
+    }
+    return NULL;
+  }
+  
+  /**
+     Reads a value, parsing a scalar and skipping a container.
+   */
+  
+  static LazyValue *lazy_value(struct JSON *s, LazyDocument *doc, jschar end) {
+    LazyValue *v;
+    Value *scalar;
+    
+    if (!sax_space(s))
+      return NULL;
+    jschar c=peek(s);
+    if (c=='[' || c=='{') {
+      v=new (s->arena->alloc(sizeof(LazyValue)))
+        LazyValue(doc, c=='[' ? Value::array : Value::object, s->line_no);
+      v->start=s->p;
+      s->p=skip_container(s->k, s->p, s->end, &s->line_no);
+      if (!s->p) {
+        s->p=s->end;
+        return (LazyValue *)syntaxerror(s);
+      }
+      v->end=s->p;
+      return v;
+    }
+    scalar=parse_value(s, end);
+    if (!scalar)
+      return NULL;
+    v=new (s->arena->alloc(sizeof(LazyValue)))
+      LazyValue(doc, scalar->getType(), scalar->lineno);
+    v->tree=scalar;
+    return v;
+  }
+  
+  LazyValue::LazyValue(LazyDocument *adoc, Value::type atype, int alineno):
+  type(atype),
+  lineno(alineno),
+  doc(adoc),
+  start(NULL),
+  end(NULL),
+  expanded(false),
+  broken(false),
+  n(0),
+  keys(NULL),
+  children(NULL),
+  tree(NULL) {
+  }
+  
+  /**
+     Parses the contents of a container, following parse_array and
+     parse_object.
+   */
+  
+  bool LazyValue::expand() {
+    struct JSON s;
+    std::vector<LazyValue *> values;
+    std::vector<Str> names;
+    const jschar *name;
+    int namelen;
+    jschar close=type==Value::array ? ']' : '}';
+    
+    if (expanded)
+      return !broken;
+    expanded=true;
+    broken=true;
+    if (type!=Value::array && type!=Value::object)
+      return false;
+    
+    init_state(&s, &doc->arena, doc->err, doc->errdata);
+    s.line_no=lineno;
+    s.p=start+1;
+    s.start=start;
+    s.end=end;
+    
+    for (;;) {
+      if (!sax_space(&s))
+        return false;
+      if (peek(&s)==close && (type==Value::object || values.empty())) {
+        s.p++;
+        break;
+      }
+      
+      if (type==Value::object) {
+        if (peek(&s)=='"') {
+          namelen=parse_unescape(&s, &name);
+        } else {
+          name=s.p;
+          namelen=parse_barename(&s);
+        }
+        if (namelen==-1) {
+          syntaxerror(&s);
+          return false;
+        }
+        // The name may be in s.scratch, which the next key overwrites
+        jschar *copy=(jschar *)doc->arena.alloc(namelen+1);
+        memcpy(copy, name, namelen);
+        copy[namelen]=0;
+        names.push_back(Str(copy, namelen));
+        
+        // scan for colon
+        if (!sax_space(&s))
+          return false;
+        if (peek(&s)!=':') {
+          syntaxerror(&s);
+          return false;
+        }
+        s.p++;
+      }
+      
+      LazyValue *v=lazy_value(&s, doc, close);
+      if (!v)
+        return false;
+      values.push_back(v);
+      
+      // Scan for comma
+      if (!sax_space(&s))
+        return false;
+      if (peek(&s)==close) {
+        s.p++;
+        break;
+      }
+      if (peek(&s)!=',') {
+        syntaxerror(&s);
+        return false;
+      }
+      s.p++;
+    }
+    
+    n=values.size();
+    if (n) {
+      children=(LazyValue **)doc->arena.alloc(n*sizeof(LazyValue *));
+      memcpy(children, &values[0], n*sizeof(LazyValue *));
+      if (type==Value::object) {
+        keys=(Str *)doc->arena.alloc(n*sizeof(Str));
+        memcpy(keys, &names[0], n*sizeof(Str));
+      }
+    }
+    broken=false;
+    return true;
+  }
+  
+  size_t LazyValue::size() {
+    if (!expand())
+      return 0;
+    return n;
+  }
+  
+  LazyValue *LazyValue::at(size_t i) {
+    if (!expand() || i>=n)
+      return NULL;
+    return children[i];
+  }
+  
+  Str LazyValue::key(size_t i) {
+    if (!expand() || i>=n || !keys)
+      return Str();
+    return keys[i];
+  }
+  
+  LazyValue *LazyValue::find(const Str &name) {
+    size_t i;
+    if (!expand() || !keys)
+      return NULL;
+    for (i=n; i>0; i--)
+      if (keys[i-1]==name)
+        return children[i-1];
+    return NULL;
+  }
+  
+  Value *LazyValue::value() {
+    if (!tree && start)
+      tree=parse_buffer(start, end-start, NULL, false, &doc->arena,
+                        doc->err, doc->errdata, lineno);
+    return tree;
+  }
+  
+  LazyDocument::LazyDocument():
+  root(NULL),
+  err(NULL),
+  errdata(NULL) {
+  }
+  
+  LazyValue *LazyDocument::parse(const jschar *str, size_t len, ErrFunc *aerr, void *aerrdata) {
+    struct JSON s;
+    
+    root=NULL;
+    arena.clear();
+    err=aerr;
+    errdata=aerrdata;
+    init_state(&s, &arena, err, errdata);
+    s.p=str;
+    s.start=str;
+    s.end=str+len;
+    if (!sax_space(&s))
+      return NULL;
+    if (peek(&s)=='[' || peek(&s)=='{') {
+      // The root need not be skipped: its contents end where it does
+      root=new (arena.alloc(sizeof(LazyValue)))
+        LazyValue(this, peek(&s)=='[' ? Value::array : Value::object, s.line_no);
+      root->start=s.p;
+      root->end=s.end;
+      return root;
+    }
+    root=lazy_value(&s, this, 0);
+    return root;
+  }
+  
+  /*
+    The query engine. The paths that may still match are kept on a
+    stack, those for each level after those of the level above, so
+    that a value no path can reach is skipped without being parsed.
+  */
+  
+  /**
+     @return The array index spelt by t, or -1 if t is not one
+   */
+  
+  static long array_index(const string &t) {
+    long i=0;
+    size_t n;
+    
+    if (t.empty() || t.size()>9 || (t[0]=='0' && t.size()>1))
+      return -1;
+    for (n=0; n<t.size(); n++) {
+      if (t[n]<'0' || t[n]>'9')
+        return -1;
+      i=i*10+(t[n]-'0');
+    }
+    return i;
+  }
+  
+  int Query::add(const string &path) {
+    std::vector<Step> steps;
+    Step step;
+    size_t i=0;
+    size_t size=path.size();
+    
+    if (path.empty() || path[0]=='/') {
+      // JSON Pointer
+      while (i<size) {
+        i++; // /
+        step.type=Step::token;
+        step.name.clear();
+        for (; i<size && path[i]!='/'; i++) {
+          if (path[i]!='~') {
+            step.name+=path[i];
+          } else if (i+1<size && path[i+1]=='0') {
+            step.name+='~';
+            i++;
+          } else if (i+1<size && path[i+1]=='1') {
+            step.name+='/';
+            i++;
+          } else {
+            return -1;
+          }
+        }
+        step.i=array_index(step.name);
+        steps.push_back(step);
+      }
+    } else if (path[0]=='$') {
+      // JSONPath: .name, .*, [n], [*], ['name'] and ["name"]
+      for (i=1; i<size; ) {
+        step.name.clear();
+        step.i=-1;
+        if (path[i]=='.') {
+          i++;
+          if (i<size && path[i]=='*') {
+            step.type=Step::any;
+            i++;
+          } else {
+            step.type=Step::key;
+            while (i<size && path[i]!='.' && path[i]!='[')
+              step.name+=path[i++];
+            if (step.name.empty())
+              return -1;
+          }
+        } else if (path[i]=='[') {
+          i++;
+          if (i<size && path[i]=='*') {
+            step.type=Step::any;
+            i++;
+          } else if (i<size && (path[i]=='\'' || path[i]=='"')) {
+            char quote=path[i++];
+            step.type=Step::key;
+            while (i<size && path[i]!=quote) {
+              if (path[i]=='\\' && i+1<size)
+                i++;
+              step.name+=path[i++];
+            }
+            if (i>=size)
+              return -1;
+            i++;
+          } else {
+            size_t start=i;
+            while (i<size && path[i]>='0' && path[i]<='9')
+              i++;
+            step.type=Step::index;
+            step.i=array_index(path.substr(start, i-start));
+            if (step.i<0)
+              return -1;
+          }
+          if (i>=size || path[i]!=']')
+            return -1;
+          i++;
+        } else {
+          return -1;
+        }
+        steps.push_back(step);
+      }
+    } else {
+      return -1;
+    }
+    paths.push_back(steps);
+    return (int)paths.size()-1;
+  }
+  
+  struct QueryState {
+    struct JSON s;
+    Query *q;
+    QueryFunc *f;
+    void *data;
+    std::vector<int> active;
+  };
+  
+  static bool query_value(QueryState *r, size_t level, size_t base, jschar end);
+  
+  /**
+     @return The next step of active path number i, or NULL if the
+     path ends at this level
+   */
+  
+  static inline const Query::Step *query_step(QueryState *r, size_t i, size_t level) {
+    const std::vector<Query::Step> &steps=r->q->paths[r->active[i]];
+    return level<steps.size() ? &steps[level] : NULL;
+  }
+  
+  /**
+     Skips a value that no path can match, following parse_value for
+     where an empty value may be.
+   */
+  
+  static bool query_skip(struct JSON *s, jschar end) {
+    const jschar *p;
+    bool escaped=false;
+    jschar c=peek(s);
+    
+    switch (c) {
+      case ',':
+        if (end==0)
+          break;
+        return true;
+      case ']':
+      case '}':
+        if (c!=end)
+          break;
+        return true;
+      case '[':
+      case '{':
+        p=skip_container(s->k, s->p, s->end, &s->line_no);
+        if (!p) {
+          s->p=s->end;
+          break;
+        }
+        s->p=p;
+        return true;
+      case '"':
+        p=string_end(s, s->p+1, &escaped);
+        if (!p) {
+          s->p=s->end;
+          break;
+        }
+        s->p=p;
+        return true;
+      default:
+        if (!number_char(c) && !word_char(c))
+          break;
+        while (number_char(peek(s)) || word_char(peek(s)))
+          s->p++;
+        return true;
+    }
+    syntaxerror(s);
+    return false;
+  }
+  
+  /**
+     Pushes the paths of [base, top) whose next step matches element
+     index of an array, or key name of an object.
+   */
+  
+  static void query_match(QueryState *r, size_t level, size_t base, size_t top,
+                          long index, const jschar *name, int namelen) {
+    const Query::Step *step;
+    size_t i;
+    
+    for (i=base; i<top; i++) {
+      step=query_step(r, i, level);
+      if (!step)
+        continue;
+      if (step->type==Query::Step::any ||
+          (name ?
+           step->type!=Query::Step::index &&
+           step->name.size()==(size_t)namelen &&
+           memcmp(step->name.data(), name, namelen)==0 :
+           step->type!=Query::Step::key && step->i==index))
+        r->active.push_back(r->active[i]);
+    }
+  }
+  
+  static bool query_array(QueryState *r, size_t level, size_t base) {
+    struct JSON *s=&r->s;
+    size_t top=r->active.size();
+    long index;
+    bool ok;
+    
+    s->p++; // [
+    
+    if (!sax_space(s))
+      return false;
+    
+    if (peek(s)!=']') {
+      for (index=0; ; index++) {
+        query_match(r, level, base, top, index, NULL, 0);
+        ok=query_value(r, level+1, top, ']');
+        r->active.resize(top);
+        if (!ok)
+          return false;
+        
+        // Scan for comma
+        
+        if (!sax_space(s))
+          return false;
+        if (peek(s)==']')
+          break;
+        if (peek(s)!=',') {
+          syntaxerror(s);
+          return false;
+        }
+        s->p++;
+      }
+    }
+    
+    s->p++; // ]
+    return true;
+  }
+  
+  static bool query_object(QueryState *r, size_t level, size_t base) {
+    struct JSON *s=&r->s;
+    size_t top=r->active.size();
+    const jschar *name;
+    int namelen;
+    bool ok;
+    
+    s->p++; // {
+    
+    for (;;) {
+      if (!sax_space(s))
+        return false;
+      if (peek(s)=='}')
+        break;
+      
+      if (peek(s)=='"') {
+        namelen=parse_unescape(s, &name);
+      } else {
+        name=s->p;
+        namelen=parse_barename(s);
+      }
+      if (namelen==-1) {
+        syntaxerror(s);
+        return false;
+      }
+      query_match(r, level, base, top, -1, name, namelen);
+      
+      // scan for colon
+      if (!sax_space(s))
+        return false;
+      if (peek(s)!=':') {
+        syntaxerror(s);
+        return false;
+      }
+      s->p++;
+      
+      ok=query_value(r, level+1, top, '}');
+      r->active.resize(top);
+      if (!ok)
+        return false;
+      
+      // Scan for comma
+      if (!sax_space(s))
+        return false;
+      if (peek(s)=='}')
+        break;
+      if (peek(s)!=',') {
+        syntaxerror(s);
+        return false;
+      }
+      s->p++;
+    }
+    
+    s->p++; // }
+    return true;
+  }
+  
+  /**
+     Reads a value that the paths from base onwards have reached. A
+     value that ends a path is parsed; one that paths go on into is
+     then read again, so that its own values can be matched.
+   */
+  
+  static bool query_value(QueryState *r, size_t level, size_t base, jschar end) {
+    struct JSON *s=&r->s;
+    size_t top=r->active.size();
+    size_t i;
+    bool matched=false;
+    bool deeper=false;
+    
+    if (!sax_space(s))
+      return false;
+    if (base==top)
+      return query_skip(s, end);
+    
+    for (i=base; i<top; i++) {
+      if (query_step(r, i, level))
+        deeper=true;
+      else
+        matched=true;
+    }
+    
+    if (matched) {
+      const jschar *start=s->p;
+      int line=s->line_no;
+      Value *v=parse_value(s, end);
+      if (!v)
+        return false;
+      for (i=base; i<top; i++)
+        if (!query_step(r, i, level) && !r->f(r->data, r->active[i], v))
+          return false;
+      // The value was only lent to the callbacks
+      r->q->arena.reset();
+      if (!deeper)
+        return true;
+      s->p=start;
+      s->line_no=line;
+    }
+    
+    switch (peek(s)) {
+      case '[':
+        return query_array(r, level, base);
+      case '{':
+        return query_object(r, level, base);
+      default:
+        return query_skip(s, end);
+    }
+  }
+  
+  bool Query::run(const jschar *str, size_t len, QueryFunc *f, void *data,
+                  ErrFunc *err, void *errdata) {
+    QueryState r;
+    size_t i;
+    
+    arena.clear();
+    init_state(&r.s, &arena, err, errdata);
+    r.s.p=str;
+    r.s.start=str;
+    r.s.end=str+len;
+    r.q=this;
+    r.f=f;
+    r.data=data;
+    for (i=0; i<paths.size(); i++)
+      r.active.push_back((int)i);
+    return query_value(&r, 0, 0, 0);
   }
   
 }
@@ -30,15 +30,259 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #ifndef decodeJSON_h
 #define decodeJSON_h
 
+#include <stddef.h>
+#include <string.h>
 #include <string>
 #include <ostream>
-#include <map>
 #include <vector>
+#include <new>
 
 namespace JSON {
   
   typedef char jschar;
 
+  /**
+     A bump allocator. Memory is handed out from large chunks and is
+     only given back to the system, all at once, when the arena is
+     cleared or destroyed. Nothing allocated from an arena is ever
+     freed individually.
+
+   */
+
+  class Arena {
+  public:
+    /**
+       Constructor.
+
+       @chunksize The size of the first chunk. Later chunks double in
+       size up to a limit.
+     */
+
+    Arena(size_t chunksize=65536);
+
+    /**
+       Destructor. Releases all chunks.
+     */
+
+    ~Arena();
+
+    /**
+       Allocates n bytes, aligned for any JSON value type.
+     */
+
+    void *alloc(size_t n) {
+      n=(n+(align-1)) & ~(size_t)(align-1);
+      if ((size_t)(end-p)<n)
+        return grow(n);
+      void *ret=p;
+      p+=n;
+      return ret;
+    }
+
+    /**
+       Releases all chunks. Everything allocated from the arena
+       becomes invalid.
+     */
+
+    void clear();
+
+    /**
+       Like clear, but keeps the chunk that is being allocated from,
+       so that an arena that is filled and emptied over and over does
+       not go back to the heap each time.
+     */
+
+    void reset();
+
+    /**
+       Moves the chunks of other into this arena, leaving other empty.
+       What was allocated from other stays valid, and is released with
+       this arena.
+     */
+
+    void adopt(Arena *other);
+
+  private:
+    enum {align=sizeof(double)>sizeof(void *) ? sizeof(double) : sizeof(void *)};
+
+    struct Chunk {
+      Chunk *next;
+      double pad;
+    };
+
+    void *grow(size_t n);
+
+    Chunk *chunks;
+    char *p;
+    char *end;
+    size_t chunksize;
+
+    Arena(const Arena &);
+    Arena &operator=(const Arena &);
+  };
+
+  /**
+     A standard library allocator that takes its memory from an Arena,
+     or from the heap if no arena is given. Used for the strings and
+     containers inside JSON values, so that a whole tree can live in
+     one arena.
+
+   */
+
+  template<class T> class Allocator {
+  public:
+    typedef T value_type;
+    typedef T *pointer;
+    typedef const T *const_pointer;
+    typedef T &reference;
+    typedef const T &const_reference;
+    typedef size_t size_type;
+    typedef ptrdiff_t difference_type;
+
+    template<class U> struct rebind {
+      typedef Allocator<U> other;
+    };
+
+    Allocator(Arena *aarena=NULL):
+    arena(aarena) {}
+
+    template<class U> Allocator(const Allocator<U> &a):
+    arena(a.arena) {}
+
+    T *allocate(size_t n, const void * =NULL) {
+      if (arena)
+        return (T *)arena->alloc(n*sizeof(T));
+      return (T *)::operator new(n*sizeof(T));
+    }
+
+    void deallocate(T *p, size_t) {
+      if (!arena)
+        ::operator delete(p);
+    }
+
+    T *address(T &x) const {
+      return &x;
+    }
+
+    const T *address(const T &x) const {
+      return &x;
+    }
+
+    size_t max_size() const {
+      return (size_t)-1/sizeof(T);
+    }
+
+    void construct(T *p, const T &x) {
+      new((void *)p) T(x);
+    }
+
+    void destroy(T *p) {
+      p->~T();
+    }
+
+    Arena *arena;
+  };
+
+  template<class T, class U>
+  inline bool operator==(const Allocator<T> &a, const Allocator<U> &b) {
+    return a.arena==b.arena;
+  }
+
+  template<class T, class U>
+  inline bool operator!=(const Allocator<T> &a, const Allocator<U> &b) {
+    return a.arena!=b.arena;
+  }
+
+  /**
+     The string type used for JSON string values and object keys: a
+     pointer and a length. A Str does not own its characters; they
+     belong to the value holding it, to the arena of a Document, or,
+     after an in-situ parse, to the input buffer.
+
+     A Str is not NUL-terminated in general. Keys after an in-situ
+     parse, and the strings given to a Handler or returned by a Reader,
+     point into the input and end where the string does there. Use
+     data() with size(), or convert it to a std::string.
+   */
+
+  class Str {
+  public:
+    Str():
+    ptr(""),
+    len(0) {}
+
+    Str(const jschar *s, size_t n):
+    ptr(s),
+    len(n) {}
+
+    Str(const jschar *s):
+    ptr(s),
+    len(std::char_traits<jschar>::length(s)) {}
+
+    Str(const std::string &s):
+    ptr(s.c_str()),
+    len(s.size()) {}
+
+    const jschar *data() const {
+      return ptr;
+    }
+
+    size_t size() const {
+      return len;
+    }
+
+    size_t length() const {
+      return len;
+    }
+
+    bool empty() const {
+      return len==0;
+    }
+
+    const jschar *begin() const {
+      return ptr;
+    }
+
+    const jschar *end() const {
+      return ptr+len;
+    }
+
+    jschar operator[](size_t i) const {
+      return ptr[i];
+    }
+
+    int compare(const Str &s) const {
+      int c=std::char_traits<jschar>::compare(ptr, s.ptr, len<s.len ? len : s.len);
+      if (c)
+        return c;
+      return len<s.len ? -1 : len>s.len ? 1 : 0;
+    }
+
+    operator std::string() const {
+      return std::string(ptr, len);
+    }
+
+  private:
+    const jschar *ptr;
+    size_t len;
+  };
+
+  inline bool operator==(const Str &a, const Str &b) {
+    return a.size()==b.size() && a.compare(b)==0;
+  }
+
+  inline bool operator!=(const Str &a, const Str &b) {
+    return !(a==b);
+  }
+
+  inline bool operator<(const Str &a, const Str &b) {
+    return a.compare(b)<0;
+  }
+
+  inline std::ostream &operator<<(std::ostream &o, const Str &s) {
+    return o.write(s.data(), s.size());
+  }
+
   /**
      Parent class of the different types of JSON values. Contains
      the line number at which the value is stored, for error reporting.
@@ -92,27 +336,171 @@ namespace JSON {
 
     virtual ~Value(){}
 
+    /**
+       Allocation. Values created by the parser are allocated with the
+       placement form, which takes the memory from an arena unless the
+       arena is NULL.
+     */
+
+    static void *operator new(size_t n) {
+      return ::operator new(n);
+    }
+
+    static void *operator new(size_t n, Arena *arena) {
+      if (arena)
+        return arena->alloc(n);
+      return ::operator new(n);
+    }
+
+    static void operator delete(void *p) {
+      ::operator delete(p);
+    }
+
+    static void operator delete(void *p, Arena *arena) {
+      if (!arena)
+        ::operator delete(p);
+    }
+
     int lineno;
   };
 
   /**
-     A JSON object, represented by a std::map<std::string, Value *>
+     The members of a JSON object: key/value pairs stored contiguously,
+     in the order they were inserted. Small objects are searched
+     linearly. Objects with more than indexThreshold members get a
+     hash index the first time a key is looked up.
+
+     Iterators are pointers to std::pair<Str, Value *>, so members are
+     accessed with I->first and I->second as with a std::map.
+   */
+
+  class Members {
+  public:
+    typedef std::pair<Str, Value *> value_type;
+    typedef value_type *iterator;
+    typedef const value_type *const_iterator;
+
+    enum {indexThreshold=16};
+
+    /**
+       Constructor. The storage comes from the arena, or from the heap
+       if the arena is NULL.
+     */
+
+    Members(Arena *aarena=NULL):
+    arena(aarena),
+    data(NULL),
+    n(0),
+    capacity(0),
+    index(NULL),
+    indexsize(0),
+    keys(NULL) {}
+
+    ~Members();
+
+    iterator begin() {
+      return data;
+    }
+
+    iterator end() {
+      return data+n;
+    }
+
+    const_iterator begin() const {
+      return data;
+    }
+
+    const_iterator end() const {
+      return data+n;
+    }
+
+    size_t size() const {
+      return n;
+    }
+
+    bool empty() const {
+      return n==0;
+    }
+
+    /**
+       @return The member with the given key, or end() if there is none.
+     */
+
+    iterator find(const Str &key);
+
+    size_t count(const Str &key) {
+      return find(key)!=end();
+    }
+
+    /**
+       @return The value for the given key. If the key is not present,
+       a copy of it is appended with a NULL value.
+     */
+
+    Value *&operator[](const Str &key);
+
+    /**
+       Appends v unless its key is already present. The key is not
+       copied, and must live as long as the object.
+
+       @return The member with the key of v, and whether it was inserted.
+     */
+
+    std::pair<iterator, bool> insert(const value_type &v);
+
+    /**
+       Makes room for n members.
+     */
+
+    void reserve(size_t n);
+
+    /**
+       Copies a key into storage owned by the members. The copy lives
+       in the arena if there is one.
+     */
+
+    Str copyKey(const jschar *s, size_t len);
+
+  private:
+    static unsigned hash(const Str &key);
+    void buildIndex();
+    void addToIndex(size_t i);
+
+    Arena *arena;
+    value_type *data;
+    size_t n;
+    size_t capacity;
+    unsigned *index;   // open addressing; member number+1, or 0 if free
+    size_t indexsize;  // a power of two, or 0 if there is no index
+    jschar *keys;      // chain of keys copied to the heap
+
+    Members(const Members &);
+    Members &operator=(const Members &);
+  };
+
+  /**
+     A JSON object, represented by Members, a flat insertion-ordered
+     map from Str to Value *
 
    */
   
   class Object : public Value {
   public:
+    typedef JSON::Members Members;
+
     /**
        Constructor. Called during parsing.
      */
     
-    Object(int lineno):Value(lineno){}
+    Object(int lineno, Arena *arena=NULL):
+    Value(lineno),
+    value(arena) {}
 
     /**
-       The data contained in the object, represented by a std::map<std::string, Value *>.
+       The data contained in the object, represented by Members.
      */
 
-    std::map<std::string, Value *> value;
+    Members value;
 
     /**
        @return Always returns JSON::Value::object
@@ -138,14 +526,18 @@ namespace JSON {
 
   class Array : public Value {
   public:
+    typedef std::vector<Value *, Allocator<Value *> > Elements;
+
     /**
        Constructor. Called during parsing.
      */
-    Array(int lineno):Value(lineno){}
+    Array(int lineno, Arena *arena=NULL):
+    Value(lineno),
+    value(Elements::allocator_type(arena)) {}
     /**
        The data contained in the array, represented by a std::vector<Value *>.
      */
-    std::vector<Value *> value;
+    Elements value;
     /**
        @return Always returns JSON::Value::array
      */
@@ -170,11 +562,39 @@ namespace JSON {
        Constructor. Called during parsing.
      */
 
-    Number(double an, int lineno):Value(lineno),value(an){};
+    Number(double an, int lineno):Value(lineno),value(an),integer(false),negative(an<0),magnitude(0){};
+    /**
+       Constructor for a number written as an integer. Called during
+       parsing.
+     */
+
+    Number(unsigned long long amagnitude, bool anegative, int lineno);
     /**
        The value of the number, represented by a double
     */
     double value;
+    /**
+       @return true if the number was written as an integer that fits
+       in 64 bits, signed or unsigned. Its exact value can then be had
+       from getInt64 or getUInt64.
+     */
+    bool isInteger() {
+      return integer;
+    }
+    /**
+       Gets the exact value of an integer.
+
+       @return false if the number is not an integer, or does not fit
+       in a long long.
+     */
+    bool getInt64(long long *ret);
+    /**
+       Gets the exact value of a non-negative integer.
+
+       @return false if the number is not an integer, or does not fit
+       in an unsigned long long.
+     */
+    bool getUInt64(unsigned long long *ret);
     /**
        @return Always returns JSON::Value::number
      */
@@ -186,22 +606,37 @@ namespace JSON {
 
     */
     void print(std::ostream &o);
+
+  private:
+    bool integer;
+    bool negative;
+    unsigned long long magnitude;
   };
   
   /**
-     A JSON string, represented by a std::string
+     A JSON string, represented by a Str
 
    */
   class String : public Value {
   public:
     /**
-       Constructor. Called during parsing.
+       Constructor. The string is copied.
+     */
+    String(std::string s, int lineno);
+    /**
+       Constructor. Called during parsing. The string is copied into
+       the arena, or to the heap if the arena is NULL.
+     */
+    String(const jschar *s, size_t len, int lineno, Arena *arena=NULL);
+    /**
+       Constructor. Called during in-situ parsing. The string is not
+       copied, and must outlive the value.
      */
-    String(std::string s, int lineno):Value(lineno),value(s){};
+    String(Str s, int lineno):Value(lineno),value(s),copy(NULL){};
     /**
-       The value of the string, represented by a std::string
+       The value of the string, represented by a Str
     */
-    std::string value;
+    Str value;
     /**
        @return Always returns JSON::Value::string
      */
@@ -213,6 +648,10 @@ namespace JSON {
 
     */
     void print(std::ostream &o);
+    ~String();
+
+  private:
+    jschar *copy; // heap copy of value, if any
   };
   
   /**
@@ -266,7 +705,75 @@ namespace JSON {
   };
 
   typedef void ErrFunc(void *errdata, std::string);
+
+  /**
+     Writes the shortest decimal form of d that reads back as d,
+     NUL-terminated, to buf, which must hold at least 32 characters.
+     The form is the one JavaScript uses: 100, 0.001, 1.5e+21. NaN and
+     infinities, which JSON cannot hold, are written as null.
+
+     @return The length of the string
+   */
+
+  int formatNumber(char *buf, double d);
+
+  /**
+     @return The first character in [p, end) that must be escaped in a
+     JSON string: a quote, a backslash or a control character. end if
+     there is none.
+   */
+
+  const jschar *findEscape(const jschar *p, const jschar *end);
   
+  /**
+     What a parse has seen and what it cost, for the functions that
+     take a Stats. The counts are added to, so one Stats may sum up
+     many parses; clear starts over.
+
+     The counting is compiled in only if JSON_STATS is defined. Without
+     it the functions ignore their Stats, which stays zero, and the
+     parsers are exactly as they would be without it.
+   */
+
+  struct Stats {
+    Stats() {
+      clear();
+    }
+
+    void clear() {
+      memset(this, 0, sizeof(*this));
+    }
+
+    /**
+       @return A wall clock, in seconds
+     */
+
+    static double clock();
+
+    /**
+       true if the counting is compiled in
+     */
+
+#ifdef JSON_STATS
+    enum {enabled=1};
+#else
+    enum {enabled=0};
+#endif
+
+    size_t bytes;          // of input read
+    size_t nodes[6];       // values read, by Value::type
+    int maxDepth;          // of nested arrays and objects
+    size_t strings;        // string values and quoted keys
+    size_t stringBytes;    // their length, after unescaping
+    size_t escapes;        // escape sequences decoded
+    size_t comments;
+    size_t allocations;    // for values, from the heap or an arena
+    size_t allocatedBytes;
+    double parseTime;      // seconds spent building values
+    double convertTime;    // converting them, or reading into a schema
+    double freeTime;       // releasing them
+  };
+
   /**
      Convert a string containing JSON data into a JSON::Value.
 
@@ -276,8 +783,769 @@ namespace JSON {
      If an error occurs during parsing, an error message is printed to
      stderr and the function returns NULL.
    */
-  Value *decodeJSON(std::string str, ErrFunc *err=NULL, void *errdata=NULL);
-  
+  Value *decodeJSON(const std::string &str, ErrFunc *err=NULL, void *errdata=NULL,
+                    Stats *stats=NULL);
+
+  /**
+     Convert a buffer containing JSON data into a JSON::Value. The
+     buffer is read in place and need not be NUL-terminated.
+
+     @str The JSON data
+     @len The length of the data in bytes
+     @stats If not NULL, what the parse sees is added to it
+     @return A JSON value or NULL in case of syntax error
+   */
+  Value *decodeJSON(const jschar *str, size_t len, ErrFunc *err=NULL, void *errdata=NULL,
+                    Stats *stats=NULL);
+
+  /**
+     Like decodeJSON(const jschar *, size_t), but escape sequences in
+     strings are decoded in place. The contents of the buffer are
+     undefined afterwards.
+   */
+  Value *decodeJSONInPlace(jschar *str, size_t len, ErrFunc *err=NULL, void *errdata=NULL);
+
+  /**
+     Deletes a value returned by decodeJSON, with everything in it. If
+     stats is not NULL, the time taken is added to its freeTime.
+   */
+  void release(Value *v, Stats *stats=NULL);
+
+  /**
+     Convert a file containing JSON data into a JSON::Value. The file
+     is mapped into memory and parsed where it lies.
+
+     @path The name of the file
+     @return A JSON value or NULL if the file cannot be read or in case
+     of syntax error
+   */
+  Value *decodeJSONFile(const std::string &path, ErrFunc *err=NULL, void *errdata=NULL);
+
+  /**
+     The contents of a file, mapped read-only into memory where the
+     system supports it, and else read into a heap buffer, as are
+     pipes and other files that are not regular. The data are not
+     NUL-terminated; the parsers only read size bytes.
+   */
+
+  class MappedFile {
+  public:
+    MappedFile();
+    ~MappedFile();
+
+    /**
+       Maps the file, releasing any file mapped before.
+
+       @return false if the file cannot be read
+     */
+
+    bool open(const std::string &path, ErrFunc *err=NULL, void *errdata=NULL);
+    void close();
+
+    const jschar *data;
+    size_t size;
+
+  private:
+    bool mapped;        // data is mapped
+    bool owned;         // data is a buffer of our own
+
+    MappedFile(const MappedFile &);
+    MappedFile &operator=(const MappedFile &);
+  };
+
+  /**
+     A parsed JSON document. All values, strings and containers of the
+     document are allocated from an arena owned by the document, so
+     parsing does not call malloc for every node, and the whole tree is
+     released at once when the document is destroyed or reparsed.
+
+     The values belong to the document and must not be deleted.
+   */
+
+  class Document {
+  public:
+    Document();
+
+    /**
+       Destructor. Frees the whole tree in one go.
+     */
+
+    ~Document();
+
+    /**
+       Parses a string containing JSON data. Any previous contents of
+       the document are released first.
+
+       @str The string containing JSON data
+       @return The root value, or NULL in case of syntax error
+     */
+
+    Value *parse(const std::string &str, ErrFunc *err=NULL, void *errdata=NULL,
+                 Stats *stats=NULL);
+
+    /**
+       Parses len bytes of JSON data at str. The buffer need not be
+       NUL-terminated, and is not copied. If stats is not NULL, what
+       the parse sees is added to it; to count the release of the
+       previous contents, call clear first.
+     */
+
+    Value *parse(const jschar *str, size_t len, ErrFunc *err=NULL, void *errdata=NULL,
+                 Stats *stats=NULL);
+
+    /**
+       Like parse(const jschar *, size_t), but escape sequences in
+       strings are decoded in place. The contents of the buffer are
+       undefined afterwards.
+     */
+
+    Value *parseInPlace(jschar *str, size_t len, ErrFunc *err=NULL, void *errdata=NULL);
+
+    /**
+       Parses len bytes of JSON data at str in situ: string values and
+       object keys are not copied, but refer to the buffer, where
+       escape sequences are decoded in place and NUL terminators are
+       written. The buffer must outlive the document.
+     */
+
+    Value *parseInSitu(jschar *str, size_t len, ErrFunc *err=NULL, void *errdata=NULL);
+
+    /**
+       Parses a file containing JSON data. The file is mapped into
+       memory, and released again once it has been parsed.
+     */
+
+    Value *parseFile(const std::string &path, ErrFunc *err=NULL, void *errdata=NULL);
+
+    /**
+       Like parse(const jschar *, size_t), but if the data is one large
+       array, its elements are parsed on several threads, as by
+       decodeJSONParallel. Each thread allocates from an arena of its
+       own, which the document takes over afterwards.
+
+       @threads The number of threads to use, or 0 for one per processor
+     */
+
+    Value *parseParallel(const jschar *str, size_t len, ErrFunc *err=NULL,
+                         void *errdata=NULL, int threads=0);
+
+    /**
+       Releases the values of the document, which is then empty. If
+       stats is not NULL, the time taken is added to its freeTime.
+     */
+
+    void clear(Stats *stats=NULL);
+
+    /**
+       The root value of the document, or NULL if nothing has been
+       parsed successfully.
+     */
+
+    Value *root;
+
+    /**
+       The arena that holds the values.
+     */
+
+    Arena arena;
+
+  private:
+    Document(const Document &);
+    Document &operator=(const Document &);
+  };
+
+  /**
+     A record of newline-delimited JSON (JSON Lines) input, and the
+     outcome of decoding it.
+   */
+
+  struct Record {
+    Record():data(NULL),size(0),lineno(0),value(NULL){};
+
+    const jschar *data;
+    size_t size;
+    int lineno;         // the line of the record in the input
+    Value *value;       // the decoded value, or NULL in case of error
+    std::string error;  // the first error message, if any
+  };
+
+  /**
+     Decodes newline-delimited JSON, one value per line, with the
+     records spread over a number of threads. Blank lines are skipped,
+     and anything but comments after the value of a line is an error.
+     The records come back in input order, each with its value, which
+     belongs to the caller, or its error message. The line numbers in
+     error messages count from the start of str.
+
+     @threads The number of threads to use, or 0 for one per processor
+     @return true if every record was decoded
+   */
+
+  bool decodeJSONLines(const jschar *str, size_t len, std::vector<Record> *records,
+                       int threads=0);
+
+  /**
+     Splits newline-delimited JSON into records, skipping blank lines.
+   */
+
+  void splitLines(const jschar *str, size_t len, std::vector<Record> *records);
+
+  typedef void RecordFunc(void *data, size_t index, Record *record);
+
+  /**
+     Calls f for each record, from several threads at once.
+
+     @threads The number of threads to use, or 0 for one per processor
+   */
+
+  void forEachRecord(std::vector<Record> *records, RecordFunc *f, void *data,
+                     int threads=0);
+
+  /**
+     An ErrFunc that stores the first error in the Record given as
+     errdata.
+   */
+
+  void recordError(void *errdata, std::string msg);
+
+  /**
+     Splits the elements of a top-level array into about the given
+     number of pieces, or four per processor if pieces is 0, for
+     parsing in parallel. Each piece holds the
+     text of one or more whole elements, without the commas between
+     pieces, and the line number it starts on. The elements of piece i
+     are numbered from (*first)[i]; the last entry of first is the
+     length of the array.
+
+     @return false if str does not hold a well-formed array, in which
+     case it should be parsed as a whole
+   */
+
+  bool splitArray(const jschar *str, size_t len, size_t pieces,
+                  std::vector<Record> *chunks, std::vector<size_t> *first);
+
+  /**
+     Like decodeJSON(const jschar *, size_t), but if the data is one
+     large array, its elements are parsed on several threads. The result
+     is the same, line numbers included. Document::parseParallel does
+     the same without allocating each value on the heap.
+
+     @threads The number of threads to use, or 0 for one per processor
+   */
+
+  Value *decodeJSONParallel(const jschar *str, size_t len, ErrFunc *err=NULL,
+                            void *errdata=NULL, int threads=0);
+
+  /**
+     A push parser for JSON data that arrives in pieces, such as from a
+     socket. The chunks may be split anywhere, also in the middle of a
+     token, and need not be kept after feed returns. The result is the
+     same as from decodeJSON on the whole input.
+   */
+
+  class Parser {
+  public:
+    /**
+       Constructor. The values are allocated with new, and the root
+       returned by finish belongs to the caller.
+     */
+
+    Parser(ErrFunc *err=NULL, void *errdata=NULL);
+
+    /**
+       Constructor. The values are allocated in the arena of doc, whose
+       previous contents are released, and finish sets doc->root.
+     */
+
+    Parser(Document *doc, ErrFunc *err=NULL, void *errdata=NULL);
+
+    /**
+       Destructor. Frees any partly parsed values.
+     */
+
+    ~Parser();
+
+    /**
+       Parses the next len bytes of input.
+
+       @return false in case of syntax error
+     */
+
+    bool feed(const jschar *data, size_t len);
+
+    /**
+       Ends the input.
+
+       @return The root value, or NULL in case of syntax error or
+       incomplete input
+     */
+
+    Value *finish();
+
+    struct State;
+
+  private:
+    void init(Document *doc, ErrFunc *err, void *errdata);
+
+    State *state;
+
+    Parser(const Parser &);
+    Parser &operator=(const Parser &);
+  };
+
+  /**
+     Receives the contents of a JSON document as a sequence of events,
+     without a tree being built. Strings and keys are views that are
+     valid only during the call, and are not NUL-terminated. Each
+     method returns false to stop parsing. The default implementations
+     ignore the event.
+   */
+
+  class Handler {
+  public:
+    Handler():lineno(0){};
+    virtual ~Handler(){};
+
+    virtual bool startObject() {return true;}
+    virtual bool key(Str) {return true;}
+    virtual bool endObject() {return true;}
+    virtual bool startArray() {return true;}
+    virtual bool endArray() {return true;}
+    virtual bool stringValue(Str) {return true;}
+    virtual bool numberValue(Number &) {return true;}
+    virtual bool booleanValue(bool) {return true;}
+    virtual bool nullValue() {return true;}
+
+    /**
+       The line number of the current event
+     */
+    int lineno;
+  };
+
+  /**
+     Parses JSON data, reporting its contents to handler.
+
+     @str The JSON data
+     @len The length of the data in bytes
+     @return false in case of syntax error, or if the handler stopped
+     parsing
+   */
+  bool decodeJSON(const jschar *str, size_t len, Handler *handler,
+                  ErrFunc *err=NULL, void *errdata=NULL);
+
+  bool decodeJSON(const std::string &str, Handler *handler,
+                  ErrFunc *err=NULL, void *errdata=NULL);
+
+  /**
+     A pull parser, which reads JSON data one value at a time at the
+     request of the caller, without building values. Syntax errors are
+     reported to err, after which the methods return false.
+
+     The caller calls peek to learn the type of the next value, and
+     then the matching read method, or startArray or startObject
+     followed by nextElement or nextMember until they report the end
+     of the container. An empty value, as in [1,,2], is a null.
+
+     If a Stats is given, what is read is added to it as it is read,
+     except for the number of bytes, which is added when the reader is
+     destroyed. No values are built, so nothing is allocated.
+   */
+
+  class Reader {
+  public:
+    Reader(const jschar *str, size_t len, ErrFunc *err=NULL, void *errdata=NULL,
+           int lineno=1, Stats *stats=NULL);
+    ~Reader();
+
+    /**
+       Finds the type of the next value without reading it.
+     */
+
+    bool peek(Value::type *type);
+
+    bool startObject();
+
+    /**
+       Reads the key of the next member of the current object, or the
+       end of the object, in which case *more is set to false. The key
+       is valid until the next call, and is not NUL-terminated.
+     */
+
+    bool nextMember(Str *key, bool *more);
+
+    bool startArray();
+
+    /**
+       Goes on as if inside an array whose first element is next, with
+       the end of the input as the end of the array. This reads the
+       elements of an array that has been split with splitArray, each
+       piece of which holds at least one element.
+     */
+
+    void startElements();
+
+    /**
+       Moves to the next element of the current array, or reads the
+       end of the array, in which case *more is set to false.
+     */
+
+    bool nextElement(bool *more);
+
+    /**
+       Reads a string. The value is valid until the next call, and is
+       not NUL-terminated.
+     */
+
+    bool readString(Str *value);
+    bool readNumber(double *value);
+    bool readBoolean(bool *value);
+    bool readNull();
+
+    /**
+       Reads the elements of the current array in one loop for as long
+       as they are numbers, appending them to *values. Called where
+       nextElement would be. *more is set to false if the end of the
+       array was read, and to true if the next element is not a
+       number, in which case the reader is at that element, as after
+       nextElement.
+     */
+
+    bool readNumbers(std::vector<double> *values, bool *more);
+
+    /**
+       Like readNumbers(std::vector<double> *, bool *), but into the
+       size doubles at values, setting *n to the number read. If they
+       fill up, *more is true and the reader is after the last of them,
+       where nextElement or readNumbers can go on.
+     */
+
+    bool readNumbers(double *values, size_t size, size_t *n, bool *more);
+
+    /**
+       Reads the next value, of whatever type, and discards it.
+     */
+
+    bool skip();
+
+    /**
+       Reads the next value, of whatever type, and builds it as a tree
+       would be, its values allocated from arena, or with new if arena
+       is NULL.
+
+       @return The value, or NULL in case of syntax error
+     */
+
+    Value *readValue(Arena *arena);
+
+    /**
+       Reads the end of the input, after the last value. Whitespace and
+       comments may come before it; anything else is a syntax error.
+     */
+
+    bool end();
+
+    /**
+       @return The line number of the next value
+     */
+
+    int lineno();
+
+    struct State;
+
+  private:
+    State *state;
+
+    Reader(const Reader &);
+    Reader &operator=(const Reader &);
+  };
+
+  class LazyDocument;
+
+  /**
+     A value of a LazyDocument. Scalars are parsed along with the
+     container that holds them. A container only records where it is in
+     the input, and is parsed the first time its contents are asked
+     for, its own containers again being recorded but not parsed.
+   */
+
+  class LazyValue {
+  public:
+    LazyValue(LazyDocument *doc, Value::type type, int lineno);
+
+    Value::type getType() const {
+      return type;
+    }
+
+    /**
+       @return The number of elements or members of a container, or 0
+       in case of syntax error
+     */
+    size_t size();
+
+    /**
+       @return Element or member number i
+     */
+    LazyValue *at(size_t i);
+
+    /**
+       @return The key of member number i
+     */
+    Str key(size_t i);
+
+    /**
+       @return The member with the given key, or NULL. If the key occurs
+       more than once, the last one wins, as in Object.
+     */
+    LazyValue *find(const Str &name);
+
+    /**
+       @return The value as a JSON::Value, allocated in the document.
+       A container is parsed in full. NULL in case of syntax error.
+     */
+    Value *value();
+
+    Value::type type;
+    int lineno;
+    LazyDocument *doc;
+    const jschar *start;  // of a container: its text,
+    const jschar *end;    // from the opening bracket
+    bool expanded;        // the contents have been parsed
+    bool broken;          // and found to be in error
+    size_t n;
+    Str *keys;            // of an object
+    LazyValue **children;
+    Value *tree;          // the value, once parsed
+
+  private:
+    bool expand();
+  };
+
+  /**
+     A JSON document that is parsed on demand, so that reading a few
+     values from a large document does not build all the others. The
+     input is not copied, and must outlive the document. Syntax errors
+     inside a container are reported when it is parsed.
+   */
+
+  class LazyDocument {
+  public:
+    LazyDocument();
+
+    /**
+       Prepares to parse len bytes at str, releasing any earlier
+       contents.
+
+       @return The root value, or NULL in case of syntax error
+     */
+
+    LazyValue *parse(const jschar *str, size_t len, ErrFunc *err=NULL, void *errdata=NULL);
+
+    LazyValue *root;
+
+    /**
+       The arena that holds the values.
+     */
+
+    Arena arena;
+
+    ErrFunc *err;
+    void *errdata;
+
+  private:
+    LazyDocument(const LazyDocument &);
+    LazyDocument &operator=(const LazyDocument &);
+  };
+
+  /**
+     A parsed JSON document stored as a tape: one contiguous array of
+     64-bit entries, each with a tag in the top byte, in document
+     order. A container starts with an entry holding the index of its
+     end entry, so it can be skipped in one step. An object holds a key
+     entry before each value. Strings are kept in a separate buffer,
+     numbers in the entry after their tag, and line numbers in an array
+     of their own that traversal does not touch.
+   */
+
+  class Tape {
+  public:
+    enum tag {
+      objectTag='{',
+      arrayTag='[',
+      endTag=']',       // payload: index of the start entry
+      keyTag=':',       // payload: offset in strings
+      stringTag='"',    // payload: offset in strings
+      doubleTag='d',    // next entry: the bits of the double
+      integerTag='i',   // payload: 1 if negative; next entry: magnitude
+      trueTag='t',
+      falseTag='f',
+      nullTag='n'
+    };
+
+    /**
+       A position on the tape. In an object, a cursor refers to the
+       value of a member, and the key is found just before it.
+     */
+
+    class Cursor {
+    public:
+      Cursor():tape(NULL),i(0){};
+      Cursor(const Tape *atape, size_t ai):tape(atape),i(ai){};
+
+      /**
+         @return false at the end of a container
+       */
+      bool valid() const {
+        return tape && tape->tagAt(i)!=endTag;
+      }
+
+      Value::type getType() const;
+
+      /**
+         @return The first element or member of a container, which is
+         not valid if the container is empty
+       */
+      Cursor child() const;
+
+      /**
+         @return The next element or member of the container, which is
+         not valid at the end
+       */
+      Cursor next() const;
+
+      /**
+         @return The key of a member of an object
+       */
+      Str key() const {
+        return tape->stringAt(i-1);
+      }
+
+      Str getString() const {
+        return tape->stringAt(i);
+      }
+      double getNumber() const;
+      bool isInteger() const {
+        return tape->tagAt(i)==integerTag;
+      }
+      bool getInt64(long long *ret) const;
+      bool getBoolean() const {
+        return tape->tagAt(i)==trueTag;
+      }
+
+      /**
+         @return The member with the given key, or an invalid cursor.
+         Searches the object from the start.
+       */
+      Cursor find(const Str &name) const;
+
+      int lineno() const {
+        return tape->lines[i];
+      }
+
+      /**
+         Converts the value at the cursor into a JSON::Value tree,
+         allocated from arena, or with new if arena is NULL.
+       */
+      Value *toValue(Arena *arena=NULL) const;
+
+      const Tape *tape;
+      size_t i;
+    };
+
+    Tape();
+
+    /**
+       Parses JSON data onto the tape, replacing its contents.
+
+       @return false in case of syntax error
+     */
+
+    bool parse(const jschar *str, size_t len, ErrFunc *err=NULL, void *errdata=NULL);
+    bool parse(const std::string &str, ErrFunc *err=NULL, void *errdata=NULL);
+    void clear();
+
+    /**
+       @return The root value
+     */
+
+    Cursor root() const {
+      return Cursor(this, 0);
+    }
+
+    tag tagAt(size_t i) const {
+      return (tag)(entries[i]>>56);
+    }
+
+    unsigned long long payloadAt(size_t i) const {
+      return entries[i] & ((1ULL<<56)-1);
+    }
+
+    Str stringAt(size_t i) const;
+
+    std::vector<unsigned long long> entries;
+    std::vector<jschar> strings;  // length, characters and NUL
+    std::vector<int> lines;
+  };
+
+  /**
+     Called by Query::run with each value that matches path number
+     path. The value is only valid during the call.
+
+     @return false to stop the query
+   */
+
+  typedef bool QueryFunc(void *data, int path, Value *value);
+
+  /**
+     A set of paths that are looked up together in one pass over a
+     document. Only the values that match are built; everything else is
+     skipped without being parsed, and syntax errors inside skipped
+     values are not noticed.
+
+     A path is either a JSON Pointer, such as /events/0/user/id, or a
+     simple JSONPath, such as $.events[*].user.id or $['events'][0]. A
+     Pointer token that is a number matches either an array index or a
+     key.
+   */
+
+  class Query {
+  public:
+    /**
+       Adds a path.
+
+       @return The number of the path, or -1 if it cannot be parsed
+     */
+
+    int add(const std::string &path);
+
+    /**
+       Looks up the paths in len bytes at str, calling f for each match
+       in document order. A value that matches more than one path is
+       passed once for each.
+
+       @return false in case of syntax error, or if f stopped the query
+     */
+
+    bool run(const jschar *str, size_t len, QueryFunc *f, void *data,
+             ErrFunc *err=NULL, void *errdata=NULL);
+
+    struct Step {
+      enum kind {key, index, token, any};
+      kind type;
+      std::string name;
+      long i;           // index, or -1 for a token that is not a number
+    };
+
+    std::vector<std::vector<Step> > paths;
+
+    /**
+       The arena that holds the values passed to the callback. It is
+       reset after each callback returns, so a run needs no more memory
+       than its largest match.
+     */
+
+    Arena arena;
+  };
+
 }
 
 #endif
@@ -28,6 +28,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "JSONschema.h"
 #include <iostream>
+#include <stdlib.h>
 
 using namespace JSONSchema;
 using namespace std;
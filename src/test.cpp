@@ -0,0 +1,1636 @@
+/*
+
+Copyright (c) 2013, Svein Berge
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL SVEIN BERGE BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+  Checks that what the parsers and encoders produce is what they
+  should. Run by make test, it prints each check that fails, and exits
+  with 1 if any did.
+*/
+
+#include "JSONschema.h"
+#include <map>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace JSONSchema;
+using namespace std;
+
+static int checks, failures;
+
+#define CHECK(c) check(c, #c, __LINE__)
+
+static void check(bool ok, const char *what, int line) {
+  checks++;
+  if (!ok) {
+    failures++;
+    printf("test.cpp:%d: failed: %s\n", line, what);
+  }
+}
+
+// A class with the hooks of Object<T>
+class Point {
+public:
+  static string memberName[];
+  static Type *memberType[];
+
+  void *member(int n) {
+    switch (n) {
+    case 0: return &x;
+    case 1: return &label;
+    case 2: return &weights;
+    case 3: return &visible;
+    case 4: return &tags;
+    }
+    return NULL;
+  }
+
+  bool unfreeze(JSON::ErrFunc *, void *) {
+    return true;
+  }
+
+  void freeze() {}
+
+  double x;
+  string label;
+  vector<double> weights;
+  bool visible;
+  map<string, double> tags;
+};
+
+string Point::memberName[]={
+  "x",
+  "label",
+  "weights",
+  "visible",
+  "tags"
+};
+
+Type *Point::memberType[]={
+  Number,
+  String,
+  NumberArray,
+  Bool,
+  NumberMap
+};
+
+static Type *pointType=new Object<Point>;
+static Type *pointArray=ObjectArray(Point);
+
+// Described classes
+struct Inner {
+  double v;
+  string s;
+
+  template<class D> static void describe(D &d) {
+    d.member("v", &Inner::v);
+    d.member("s", &Inner::s);
+  }
+};
+
+struct Outer {
+  double number;
+  string text;
+  bool flag;
+  Inner inner;
+  vector<Inner> list;
+  map<string, double> table;
+  vector<bool> bits;
+  vector<string> words;
+
+  template<class D> static void describe(D &d) {
+    d.member("number", &Outer::number);
+    d.member("text", &Outer::text);
+    d.member("flag", &Outer::flag);
+    d.member("inner", &Outer::inner);
+    d.member("list", &Outer::list);
+    d.member("table", &Outer::table);
+    d.member("bits", &Outer::bits);
+    d.member("words", &Outer::words);
+  }
+};
+
+struct Numeric {
+  vector<double> doubles;
+  vector<float> floats;
+  vector<int> ints;
+  double fixed[3];
+  int pair[2];
+#if __cplusplus>=201103L
+  std::array<float, 2> array;
+#endif
+
+  template<class D> static void describe(D &d) {
+    d.member("doubles", &Numeric::doubles);
+    d.member("floats", &Numeric::floats);
+    d.member("ints", &Numeric::ints);
+    d.member("fixed", &Numeric::fixed);
+    d.member("pair", &Numeric::pair);
+#if __cplusplus>=201103L
+    d.member("array", &Numeric::array);
+#endif
+  }
+};
+
+// A Type of its own, which reads a colour written as a hex string. Like
+// a Type written before reading straight from the input, encoding
+// through a Writer and MessagePack, it only fills from a tree and
+// encodes to a string
+class HexType : public Type {
+public:
+  JSON::Value::type getType() {
+    return JSON::Value::string;
+  }
+
+  bool fill(JSON::Value *v, void *ret, JSON::ErrFunc *err, void *errData) {
+    JSON::Str s=((JSON::String *)v)->value;
+    std::string text(s.data(), s.size());
+    char *end;
+    *(unsigned long *)ret=strtoul(text.c_str(), &end, 16);
+    if (text.empty() || *end) {
+      schemaerror(v, err, errData);
+      return false;
+    }
+    return true;
+  }
+
+  std::string encode(void *obj) {
+    char buf[32];
+    sprintf(buf, "\"%06lx\"", *(unsigned long *)obj);
+    return buf;
+  }
+};
+
+static HexType hexType;
+
+class Swatch {
+public:
+  static string memberName[];
+  static Type *memberType[];
+
+  void *member(int n) {
+    switch (n) {
+    case 0: return &name;
+    case 1: return &color;
+    case 2: return &shades;
+    }
+    return NULL;
+  }
+
+  bool unfreeze(JSON::ErrFunc *, void *) {
+    return true;
+  }
+
+  void freeze() {}
+
+  string name;
+  unsigned long color;
+  vector<unsigned long> shades;
+};
+
+string Swatch::memberName[]={
+  "name",
+  "color",
+  "shades"
+};
+
+Type *Swatch::memberType[]={
+  String,
+  &hexType,
+  new Array<unsigned long>(&hexType)
+};
+
+static Type *swatchType=new Object<Swatch>;
+
+// An ErrFunc that keeps the last message, so that errors are not printed
+static void keepError(void *errdata, std::string msg) {
+  *(std::string *)errdata=msg;
+}
+
+static JSON::Value *member(JSON::Value *v, const char *key) {
+  if (!v || v->getType()!=JSON::Value::object)
+    return NULL;
+  JSON::Object::Members &m=((JSON::Object *)v)->value;
+  JSON::Object::Members::iterator I=m.find(key);
+  return I==m.end() ? NULL : I->second;
+}
+
+static JSON::Value *element(JSON::Value *v, size_t i) {
+  if (!v || v->getType()!=JSON::Value::array ||
+      i>=((JSON::Array *)v)->value.size())
+    return NULL;
+  return ((JSON::Array *)v)->value[i];
+}
+
+static bool isNumber(JSON::Value *v, double d) {
+  return v && v->getType()==JSON::Value::number && ((JSON::Number *)v)->value==d;
+}
+
+static bool isString(JSON::Value *v, const char *s) {
+  return v && v->getType()==JSON::Value::string &&
+    ((JSON::String *)v)->value==JSON::Str(s);
+}
+
+// Two trees with the same values, on the same lines
+static bool equal(JSON::Value *a, JSON::Value *b) {
+  if (!a || !b)
+    return a==b;
+  if (a->getType()!=b->getType() || a->lineno!=b->lineno)
+    return false;
+  size_t i;
+  switch (a->getType()) {
+  case JSON::Value::object: {
+    JSON::Members &ma=((JSON::Object *)a)->value, &mb=((JSON::Object *)b)->value;
+    if (ma.size()!=mb.size())
+      return false;
+    for (i=0; i<ma.size(); i++)
+      if (ma.begin()[i].first!=mb.begin()[i].first ||
+	  !equal(ma.begin()[i].second, mb.begin()[i].second))
+        return false;
+    return true;
+  }
+  case JSON::Value::array:
+    if (((JSON::Array *)a)->value.size()!=((JSON::Array *)b)->value.size())
+      return false;
+    for (i=0; i<((JSON::Array *)a)->value.size(); i++)
+      if (!equal(element(a, i), element(b, i)))
+        return false;
+    return true;
+  case JSON::Value::string:
+    return ((JSON::String *)a)->value==((JSON::String *)b)->value;
+  case JSON::Value::number:
+    return ((JSON::Number *)a)->value==((JSON::Number *)b)->value &&
+      ((JSON::Number *)a)->isInteger()==((JSON::Number *)b)->isInteger();
+  case JSON::Value::boolean:
+    return ((JSON::Boolean *)a)->value==((JSON::Boolean *)b)->value;
+  default:
+    return true;
+  }
+}
+
+static void testDocument() {
+  JSON::Document doc;
+  std::string err;
+  JSON::Value *v;
+  v=doc.parse("{\"a\": [1, 2.5, \"x\"], \"b\": {\"c\": true, \"d\": null}}",
+	      keepError, &err);
+  CHECK(v && v==doc.root);
+  CHECK(isNumber(element(member(v, "a"), 0), 1));
+  CHECK(isNumber(element(member(v, "a"), 1), 2.5));
+  CHECK(isString(element(member(v, "a"), 2), "x"));
+  v=member(member(doc.root, "b"), "c");
+  CHECK(v && v->getType()==JSON::Value::boolean && ((JSON::Boolean *)v)->value);
+  v=member(member(doc.root, "b"), "d");
+  CHECK(v && v->getType()==JSON::Value::null);
+
+  // Reparsing releases the old tree; a failed parse leaves no root
+  v=doc.parse("[1,", keepError, &err);
+  CHECK(!v && !doc.root && !err.empty());
+
+  // More values than fit in the first chunk of the arena
+  std::string s="[";
+  char buf[32];
+  int i;
+  for (i=0; i<100000; i++) {
+    sprintf(buf, "%s\"s%d\"", i ? "," : "", i);
+    s+=buf;
+  }
+  s+="]";
+  v=doc.parse(s);
+  CHECK(v && ((JSON::Array *)v)->value.size()==100000);
+  CHECK(isString(element(v, 99999), "s99999"));
+
+  // Containers of the standard library in an arena
+  JSON::Arena arena;
+  JSON::Allocator<int> alloc(&arena);
+  std::vector<int, JSON::Allocator<int> > ints(alloc);
+  for (i=0; i<1000; i++)
+    ints.push_back(i);
+  CHECK(ints.size()==1000 && ints[999]==999);
+  std::map<int, int, std::less<int>, JSON::Allocator<std::pair<const int, int> > >
+    map(std::less<int>(), alloc);
+  for (i=0; i<100; i++)
+    map[i]=2*i;
+  CHECK(map.size()==100 && map[50]==100);
+}
+
+static void testBuffer() {
+  std::string err;
+  // Only len bytes are read: what follows is not JSON
+  const char text[]="[1, {\"k\": \"v\"}]garbage";
+  JSON::Value *v=JSON::decodeJSON(text, 15, keepError, &err);
+  CHECK(v && isNumber(element(v, 0), 1));
+  CHECK(isString(member(element(v, 1), "k"), "v"));
+  delete v;
+  char unterminated[4]={'[', '7', ']', '['};
+  v=JSON::decodeJSON(unterminated, 3, keepError, &err);
+  CHECK(isNumber(element(v, 0), 7));
+  delete v;
+  // Cut off in the middle
+  err.clear();
+  v=JSON::decodeJSON(text, 10, keepError, &err);
+  CHECK(!v && !err.empty());
+  // A number at the very end of the buffer
+  v=JSON::decodeJSON("12345", 3, keepError, &err);
+  CHECK(isNumber(v, 123));
+  delete v;
+}
+
+static bool inBuffer(JSON::Value *v, const char *buf, size_t len) {
+  return v && v->getType()==JSON::Value::string &&
+    ((JSON::String *)v)->value.data()>=buf &&
+    ((JSON::String *)v)->value.data()<buf+len;
+}
+
+static void testInSitu() {
+  char text[]="{\"plain\": \"abc\", \"esc\\u0041ped\": \"a\\nb\\\"c\\u0041\"}";
+  size_t len=strlen(text);
+  JSON::Document doc;
+  JSON::Value *v=doc.parseInSitu(text, len);
+  // The strings refer to the buffer, with the escapes decoded there
+  CHECK(inBuffer(member(v, "plain"), text, len));
+  CHECK(isString(member(v, "plain"), "abc"));
+  CHECK(inBuffer(member(v, "escAped"), text, len));
+  CHECK(isString(member(v, "escAped"), "a\nb\"cA"));
+  CHECK(v && ((JSON::Object *)v)->value.begin()[1].first==JSON::Str("escAped"));
+
+  char text2[]="[\"x\\ty\", \"\\/\"]";
+  v=JSON::decodeJSONInPlace(text2, strlen(text2));
+  CHECK(isString(element(v, 0), "x\ty"));
+  CHECK(isString(element(v, 1), "/"));
+  delete v;
+}
+
+static void testMembers() {
+  // Members keep the order of the input, also past indexThreshold
+  std::string s="{";
+  char buf[32];
+  int i;
+  for (i=39; i>=0; i--) {
+    sprintf(buf, "\"k%d\": %d%s", i, i, i ? ", " : "}");
+    s+=buf;
+  }
+  JSON::Document doc;
+  JSON::Value *v=doc.parse(s);
+  CHECK(v && ((JSON::Object *)v)->value.size()==40);
+  bool ordered=true, found=true;
+  JSON::Members::iterator I;
+  for (i=39, I=((JSON::Object *)v)->value.begin(); i>=0; i--, I++) {
+    sprintf(buf, "k%d", i);
+    ordered=ordered && I->first==JSON::Str(buf) && isNumber(I->second, i);
+    found=found && isNumber(member(v, buf), i);
+  }
+  CHECK(ordered);
+  CHECK(found);
+  CHECK(!member(v, "k40") && !member(v, "k"));
+
+  // A repeated key keeps its place, and the last value
+  v=doc.parse("{\"a\": 1, \"b\": 2, \"a\": 3}");
+  CHECK(v && ((JSON::Object *)v)->value.size()==2);
+  CHECK(((JSON::Object *)v)->value.begin()->first==JSON::Str("a"));
+  CHECK(isNumber(member(v, "a"), 3));
+
+  JSON::Members m;
+  JSON::Null n(1);
+  for (i=0; i<20; i++) {
+    sprintf(buf, "m%d", i);
+    m[m.copyKey(buf, strlen(buf))]=&n;
+  }
+  CHECK(m.size()==20 && m.count("m7") && !m.count("m20"));
+  CHECK(!m.insert(JSON::Members::value_type("m3", NULL)).second);
+  CHECK(m["m3"]==&n);
+  CHECK(m["new"]==NULL && m.size()==21 && (m.end()-1)->first==JSON::Str("new"));
+}
+
+static void testScanning() {
+  size_t i, j, k;
+
+  // Strings of every length up to past the widest kernel, with an
+  // escape at every place
+  std::string s, expect;
+  bool strings=true;
+  for (i=0; i<150; i++)
+    for (j=0; j<=i; j+=7) {
+      s="\"";
+      expect="";
+      for (k=0; k<i; k++) {
+        if (k==j) {
+          s+="\\n";
+          expect+='\n';
+        }
+        s+='a'+k%26;
+        expect+='a'+k%26;
+      }
+      s+="\"";
+      JSON::Value *v=JSON::decodeJSON(s);
+      strings=strings && isString(v, expect.c_str());
+      delete v;
+    }
+  CHECK(strings);
+
+  // Runs of whitespace and comments of every length, with the lines
+  // they hold counted
+  bool lines=true;
+  for (i=0; i<150; i++) {
+    s="[";
+    s+=std::string(i, ' ');
+    s+="\n\t\r\n";
+    s+=std::string(i, ' ');
+    s+="1, /*";
+    s+=std::string(i, '*');
+    s+="\n*/";
+    s+=std::string(i%3, '\n');
+    s+="2, // ";
+    s+=std::string(i, '/');
+    s+="\n3]";
+    JSON::Document doc;
+    JSON::Value *v=doc.parse(s);
+    lines=lines && isNumber(element(v, 0), 1) && element(v, 0)->lineno==3 &&
+      isNumber(element(v, 1), 2) && element(v, 1)->lineno==4+(int)(i%3) &&
+      isNumber(element(v, 2), 3) && element(v, 2)->lineno==5+(int)(i%3);
+  }
+  CHECK(lines);
+}
+
+static bool parsesAs(const char *text, double d) {
+  JSON::Value *v=JSON::decodeJSON(text, strlen(text));
+  bool ok=isNumber(v, d);
+  delete v;
+  return ok;
+}
+
+// A number generator of our own, so that every run checks the same
+static unsigned long long nextRandom(unsigned long long *state) {
+  *state=*state*6364136223846793005ull+1442695040888963407ull;
+  return *state>>11;
+}
+
+static void testNumbers() {
+  CHECK(parsesAs("0.1", 0.1));
+  CHECK(parsesAs("-0", 0) && parsesAs("0e10", 0));
+  CHECK(parsesAs("1e308", 1e308));
+  CHECK(parsesAs("1.7976931348623157e308", 1.7976931348623157e308));
+  CHECK(parsesAs("2.2250738585072011e-308", 2.2250738585072011e-308));
+  CHECK(parsesAs("4.9e-324", 4.9e-324));
+  CHECK(parsesAs("1e-400", 0));
+  CHECK(parsesAs("9007199254740993", 9007199254740992.0));
+  CHECK(parsesAs("0.1000000000000000055511151231257827021181583404541015625", 0.1));
+  CHECK(parsesAs("123456789012345678901234567890", 1.2345678901234568e29));
+  CHECK(parsesAs("7.2057594037927933e16", 72057594037927936.0));
+
+  // Integers keep their exact value
+  JSON::Document doc;
+  JSON::Value *v=doc.parse("[18446744073709551615, -9223372036854775808, "
+			   "9223372036854775808, 1.0, 18446744073709551616]");
+  unsigned long long u;
+  long long l;
+  JSON::Number *n=(JSON::Number *)element(v, 0);
+  CHECK(n && n->isInteger() && n->getUInt64(&u) && u==18446744073709551615ull);
+  CHECK(!n->getInt64(&l));
+  n=(JSON::Number *)element(v, 1);
+  CHECK(n && n->getInt64(&l) && l==-9223372036854775807ll-1);
+  n=(JSON::Number *)element(v, 2);
+  CHECK(n && !n->getInt64(&l) && n->getUInt64(&u) && u==9223372036854775808ull);
+  n=(JSON::Number *)element(v, 3);
+  CHECK(n && !n->isInteger() && n->value==1);
+  n=(JSON::Number *)element(v, 4);
+  CHECK(n && !n->isInteger() && n->value==18446744073709551616.0);
+
+  // Random doubles, and random digit strings, against strtod
+  unsigned long long state=1;
+  char buf[64];
+  int i, j;
+  bool same=true;
+  for (i=0; i<100000 && same; i++) {
+    double d;
+    unsigned long long bits=nextRandom(&state)<<11 ^ nextRandom(&state);
+    memcpy(&d, &bits, sizeof(d));
+    if (d!=d || d-d!=0)
+      continue;
+    sprintf(buf, "%.17g", d);
+    same=parsesAs(buf, strtod(buf, NULL));
+    int digits=1+nextRandom(&state)%25;
+    for (j=0; j<digits; j++)
+      buf[j]='0'+nextRandom(&state)%10;
+    if (buf[0]=='0')
+      buf[0]='1';
+    sprintf(buf+j, ".%de%d", (int)(nextRandom(&state)%100),
+	    (int)(nextRandom(&state)%700)-350);
+    same=same && parsesAs(buf, strtod(buf, NULL));
+    if (!same)
+      printf("  %s\n", buf);
+  }
+  CHECK(same);
+
+  const char *bad[]={"[-]", "[1e]", "[.5]", "[01]", "[--1]", "[1.5e3x]"};
+  std::string err;
+  bool rejected=true;
+  for (i=0; i<(int)(sizeof(bad)/sizeof(*bad)); i++) {
+    v=JSON::decodeJSON(bad[i], strlen(bad[i]), keepError, &err);
+    rejected=rejected && !v;
+    delete v;
+  }
+  CHECK(rejected);
+}
+
+// A document with every kind of token, for splitting up
+static const char sample[]=
+  "{\"name\": \"caf\\u0041 \\\"quoted\\\"\",\n"
+  " \"values\": [1, -2.5e-3, 12345678901234567890, true, false, null],\n"
+  " /* a comment */ \"nested\": {\"empty\": {}, \"list\": [[], [{}]]},\n"
+  " # another\n"
+  " \"last\": -0.000123}";
+
+static void testPushParser() {
+  JSON::Document whole;
+  JSON::Value *expect=whole.parse(sample);
+  CHECK(expect!=NULL);
+  size_t len=strlen(sample), chunk, i;
+  bool same=true;
+  for (chunk=1; chunk<=len; chunk++) {
+    JSON::Parser p;
+    for (i=0; i<len; i+=chunk)
+      same=same && p.feed(sample+i, len-i<chunk ? len-i : chunk);
+    JSON::Value *v=p.finish();
+    same=same && equal(v, expect);
+    delete v;
+  }
+  CHECK(same);
+
+  // Into a document, a byte at a time from a copy that does not outlive the call
+  JSON::Document doc;
+  JSON::Parser p(&doc);
+  for (i=0; i<len; i++) {
+    char c=sample[i];
+    p.feed(&c, 1);
+  }
+  CHECK(p.finish()==doc.root && equal(doc.root, expect));
+
+  // Errors, and input that ends too soon
+  std::string err;
+  JSON::Parser bad(keepError, &err);
+  CHECK(bad.feed("[1, 2", 5) && !bad.feed(" }", 2) && !err.empty());
+  CHECK(bad.finish()==NULL);
+  err.clear();
+  JSON::Parser cut(keepError, &err);
+  CHECK(cut.feed("{\"a\": [1, 2", 11) && cut.finish()==NULL && !err.empty());
+}
+
+// Writes the events it gets as text, and stops after a given number
+class Recorder : public JSON::Handler {
+public:
+  Recorder(int alimit=-1):limit(alimit) {}
+  bool startObject() {return event("{");}
+  bool key(JSON::Str s) {return event("k:"+(std::string)s);}
+  bool endObject() {return event("}");}
+  bool startArray() {return event("[");}
+  bool endArray() {return event("]");}
+  bool stringValue(JSON::Str s) {return event("s:"+(std::string)s);}
+  bool numberValue(JSON::Number &n) {
+    char buf[32];
+    sprintf(buf, "%g", n.value);
+    return event(std::string("n:")+buf);
+  }
+  bool booleanValue(bool b) {return event(b ? "true" : "false");}
+  bool nullValue() {return event("null");}
+  bool event(const std::string &e) {
+    char buf[16];
+    sprintf(buf, "@%d ", lineno);
+    events+=e+buf;
+    return limit<0 || --limit>0;
+  }
+  std::string events;
+  int limit;
+};
+
+static void testHandler() {
+  Recorder r;
+  CHECK(JSON::decodeJSON(sample, strlen(sample), &r));
+  CHECK(r.events=="{@1 k:name@1 s:cafA \"quoted\"@1 k:values@2 [@2 n:1@2 "
+	"n:-0.0025@2 n:1.23457e+19@2 true@2 false@2 null@2 ]@2 "
+	"k:nested@3 {@3 k:empty@3 {@3 }@3 k:list@3 [@3 [@3 ]@3 [@3 {@3 }@3 "
+	"]@3 ]@3 }@3 k:last@5 n:-0.000123@5 }@5 ");
+
+  // Returning false stops the parse
+  Recorder stop(3);
+  CHECK(!JSON::decodeJSON(std::string(sample), &stop));
+  CHECK(stop.events=="{@1 k:name@1 s:cafA \"quoted\"@1 ");
+
+  std::string err;
+  Recorder bad;
+  CHECK(!JSON::decodeJSON(std::string("[1, 2}"), &bad, keepError, &err) &&
+	!err.empty());
+}
+
+static void testSchema() {
+  const char text[]="[{\"x\": 1.5, \"label\": \"a\\tb\", \"unknown\": {\"deep\": [1, {}]},\n"
+    "  \"weights\": [1, 2, 3], \"visible\": true, \"tags\": {\"p\": 1, \"q\": -2}},\n"
+    " {\"label\": \"second\", \"x\": -0.25, \"weights\": [], \"visible\": false}]";
+  vector<Point> direct, converted;
+  CHECK(decodeJSON(text, strlen(text), pointArray, &direct));
+  JSON::Document doc;
+  CHECK(convertJSON(doc.parse(text), pointArray, &converted, NULL, NULL));
+  CHECK(direct.size()==2 && converted.size()==2);
+  size_t i;
+  for (i=0; i<direct.size() && i<converted.size(); i++)
+    CHECK(direct[i].x==converted[i].x && direct[i].label==converted[i].label &&
+	  direct[i].weights==converted[i].weights &&
+	  direct[i].visible==converted[i].visible && direct[i].tags==converted[i].tags);
+  CHECK(direct[0].x==1.5 && direct[0].label=="a\tb" && direct[0].weights.size()==3 &&
+	direct[0].weights[2]==3 && direct[0].visible && direct[0].tags["q"]==-2);
+  CHECK(direct[1].x==-0.25 && direct[1].label=="second" && direct[1].weights.empty() &&
+	!direct[1].visible);
+
+  // A type error, reported with its line
+  std::string err;
+  Point p;
+  CHECK(!decodeJSON(std::string("{\"x\": 1,\n \"label\": 2}"), pointType, &p,
+		    keepError, &err));
+  CHECK(err.find('2')!=std::string::npos);
+
+  // The pull parser on its own
+  JSON::Reader r(sample, strlen(sample));
+  JSON::Value::type type;
+  JSON::Str key, str;
+  bool more;
+  double d;
+  CHECK(r.peek(&type) && type==JSON::Value::object && r.startObject());
+  CHECK(r.nextMember(&key, &more) && more && key==JSON::Str("name"));
+  CHECK(r.readString(&str) && str==JSON::Str("cafA \"quoted\""));
+  CHECK(r.nextMember(&key, &more) && more && key==JSON::Str("values") && r.startArray());
+  CHECK(r.nextElement(&more) && more && r.readNumber(&d) && d==1);
+  CHECK(r.nextElement(&more) && more && r.skip());
+  CHECK(r.nextElement(&more) && more && r.skip() && r.lineno()==2);
+  CHECK(r.nextElement(&more) && more && r.peek(&type) && type==JSON::Value::boolean);
+  CHECK(r.skip() && r.nextElement(&more) && r.skip());
+  CHECK(r.nextElement(&more) && more && r.readNull());
+  CHECK(r.nextElement(&more) && !more);
+  CHECK(r.nextMember(&key, &more) && more && key==JSON::Str("nested") && r.skip());
+  CHECK(r.nextMember(&key, &more) && more && key==JSON::Str("last") &&
+	r.readNumber(&d) && d==-0.000123);
+  CHECK(r.nextMember(&key, &more) && !more);
+
+  // A key already in a map is replaced, whether it is read, filled or
+  // unpacked, and the last of repeated keys wins
+  const char dup[]="{\"p\": 1, \"q\": 3, \"p\": 2}";
+  const char packedDup[]="\x83\xa1p\x01\xa1q\x03\xa1p\x02";
+  map<string, double> m[4];
+  for (i=0; i<4; i++) {
+    m[i]["p"]=9;
+    m[i]["z"]=5;
+  }
+  CHECK(decodeJSON(std::string(dup), NumberMap, &m[0]));
+  CHECK(convertJSON(doc.parse(dup), NumberMap, &m[1], NULL, NULL));
+  CHECK(decodeMsgPack(packedDup, sizeof(packedDup)-1, NumberMap, &m[2]));
+  typedef Codec<map<string, double> > MapCodec;
+  CHECK(MapCodec::fill(doc.root, &m[3], NULL, NULL));
+  for (i=0; i<4; i++)
+    CHECK(m[i].size()==3 && m[i]["p"]==2 && m[i]["q"]==3 && m[i]["z"]==5);
+}
+
+#ifndef _WIN32
+// Writes text to a FIFO on a thread of its own, as the other end is
+// read
+class FifoWriter {
+public:
+  FifoWriter(const char *path, const char *text) {
+    start(path, text);
+  }
+
+  void start(const char *apath, const char *atext) {
+    path=apath;
+    text=atext;
+    ok=false;
+    pthread_create(&thread, NULL, run, this);
+  }
+
+  bool join() {
+    pthread_join(thread, NULL);
+    return ok;
+  }
+
+private:
+  static void *run(void *data) {
+    FifoWriter *w=(FifoWriter *)data;
+    int fd=open(w->path, O_WRONLY);
+    size_t len=strlen(w->text);
+    w->ok=fd>=0 && write(fd, w->text, len)==(ssize_t)len;
+    if (fd>=0)
+      close(fd);
+    return NULL;
+  }
+
+  const char *path;
+  const char *text;
+  bool ok;
+  pthread_t thread;
+};
+#endif
+
+static void testFile() {
+  const char *path="jsontest.tmp";
+  FILE *f=fopen(path, "w");
+  CHECK(f!=NULL);
+  if (!f)
+    return;
+  fputs(sample, f);
+  fclose(f);
+  JSON::Document whole;
+  JSON::Value *expect=whole.parse(sample);
+  JSON::Value *v=JSON::decodeJSONFile(path);
+  CHECK(equal(v, expect));
+  delete v;
+  JSON::Document doc;
+  CHECK(equal(doc.parseFile(path), expect));
+  JSON::MappedFile m;
+  CHECK(m.open(path) && m.size==strlen(sample) && !memcmp(m.data, sample, m.size));
+  Point p;
+  f=fopen(path, "w");
+  fputs("{\"x\": 4, \"label\": \"from a file\"}", f);
+  fclose(f);
+  CHECK(decodeJSONFile(path, pointType, &p) && p.x==4 && p.label=="from a file");
+  // An empty file is a syntax error
+  f=fopen(path, "w");
+  fclose(f);
+  std::string err;
+  CHECK(!doc.parseFile(path, keepError, &err) && !err.empty());
+  remove(path);
+  err.clear();
+  CHECK(!JSON::decodeJSONFile(path, keepError, &err) && !err.empty());
+
+#ifndef _WIN32
+  // A FIFO has no size, and is read to the end, here longer than the
+  // first buffer
+  std::string text="[";
+  char buf[32];
+  int i;
+  for (i=0; i<20000; i++) {
+    sprintf(buf, "%s{\"x\": %d}", i ? ", " : "", i);
+    text+=buf;
+  }
+  text+="]";
+  JSON::Document big;
+  expect=big.parse(text);
+  CHECK(mkfifo(path, 0600)==0);
+  FifoWriter w(path, text.c_str());
+  v=JSON::decodeJSONFile(path);
+  CHECK(w.join() && equal(v, expect));
+  delete v;
+  w.start(path, text.c_str());
+  CHECK(equal(doc.parseFile(path), expect) && w.join());
+  vector<Point> points;
+  w.start(path, text.c_str());
+  CHECK(decodeJSONFile(path, pointArray, &points) && w.join() &&
+	points.size()==20000 && points[19999].x==19999);
+  remove(path);
+#endif
+}
+
+static void testLines() {
+  std::string text;
+  char buf[64];
+  int i, threads;
+  for (i=0; i<1000; i++) {
+    sprintf(buf, "{\"x\": %d, \"label\": \"line %d\"}\n%s", i, i, i%10 ? "" : "\n");
+    text+=buf;
+  }
+  for (threads=1; threads<=4; threads+=3) {
+    std::vector<JSON::Record> records;
+    CHECK(JSON::decodeJSONLines(text.data(), text.size(), &records, threads));
+    bool ordered=records.size()==1000;
+    for (i=0; i<1000 && ordered; i++) {
+      ordered=isNumber(member(records[i].value, "x"), i) &&
+	records[i].lineno==i+1+(i+9)/10 && records[i].error.empty();
+      delete records[i].value;
+    }
+    CHECK(ordered);
+
+    vector<Point> points;
+    CHECK(decodeJSONLines(text.data(), text.size(), pointType, &points, &records,
+			  threads));
+    ordered=points.size()==1000;
+    for (i=0; i<1000 && ordered; i++) {
+      sprintf(buf, "line %d", i);
+      ordered=points[i].x==i && points[i].label==buf;
+    }
+    CHECK(ordered);
+  }
+
+  // The errors stay with their records
+  const char bad[]="[1]\n[2,\n\n{\"x\": \"no\"}\n";
+  std::vector<JSON::Record> records;
+  CHECK(!JSON::decodeJSONLines(bad, strlen(bad), &records));
+  CHECK(records.size()==3 && isNumber(element(records[0].value, 0), 1));
+  CHECK(records[1].value==NULL && records[1].error.find('2')!=std::string::npos);
+  CHECK(records[2].lineno==4 && records[2].error.empty());
+  for (i=0; i<(int)records.size(); i++)
+    delete records[i].value;
+  vector<Point> points;
+  CHECK(!decodeJSONLines(bad+8, strlen(bad+8), pointType, &points, &records));
+  CHECK(records.size()==1 && records[0].error.find('2')!=std::string::npos);
+
+  // A line holds one value, after which only comments may follow
+  const char two[]="{\"x\": 1} // one\n\n{\"x\": 2} {\"x\": 3}\n{\"x\": 4} /* */ \n";
+  CHECK(!JSON::decodeJSONLines(two, strlen(two), &records));
+  CHECK(records.size()==3 && isNumber(member(records[0].value, "x"), 1));
+  CHECK(records[1].value==NULL && records[1].error.find('3')!=std::string::npos);
+  CHECK(isNumber(member(records[2].value, "x"), 4) && records[2].error.empty());
+  for (i=0; i<(int)records.size(); i++)
+    delete records[i].value;
+  CHECK(!decodeJSONLines(two, strlen(two), pointType, &points, &records));
+  CHECK(points.size()==3 && points[0].x==1 && points[2].x==4);
+  CHECK(records[0].error.empty() && records[2].error.empty() &&
+	records[1].error.find('3')!=std::string::npos);
+}
+
+static void testParallel() {
+  // Large enough to be split, with brackets and commas inside strings
+  std::string text="// points\n[\n";
+  char buf[128];
+  int i;
+  for (i=0; i<20000; i++) {
+    sprintf(buf, "%s{\"x\": %d, \"label\": \"[%d], {\\\"\", \"weights\": [%d]}%s",
+	    i ? ",\n" : "", i, i, i%7, i%100 ? "" : " /* , ] */");
+    text+=buf;
+  }
+  text+="\n]\n";
+  JSON::Document whole;
+  JSON::Value *expect=whole.parse(text);
+  CHECK(expect && ((JSON::Array *)expect)->value.size()==20000);
+  std::vector<JSON::Record> chunks;
+  std::vector<size_t> first;
+  CHECK(JSON::splitArray(text.data(), text.size(), 16, &chunks, &first) &&
+	chunks.size()>1 && first.back()==20000);
+
+  JSON::Value *v=JSON::decodeJSONParallel(text.data(), text.size(), NULL, NULL, 4);
+  CHECK(equal(v, expect));
+  delete v;
+  JSON::Document doc;
+  CHECK(equal(doc.parseParallel(text.data(), text.size()), expect));
+  CHECK(equal(doc.parseParallel(text.data(), text.size(), NULL, NULL, 1), expect));
+
+  vector<Point> points;
+  CHECK(decodeJSONParallel(text.data(), text.size(), pointType, &points, NULL, NULL, 4));
+  bool same=points.size()==20000;
+  for (i=0; i<20000 && same; i++) {
+    sprintf(buf, "[%d], {\"", i);
+    same=points[i].x==i && points[i].label==buf && points[i].weights.size()==1;
+  }
+  CHECK(same);
+
+  // An error in one piece fails the whole, with the line it is on
+  std::string err;
+  text.replace(text.find("\"x\": 15000"), 10, "\"x\": 15000}");
+  v=JSON::decodeJSONParallel(text.data(), text.size(), keepError, &err, 4);
+  CHECK(!v && err.find("15003")!=std::string::npos);
+  err.clear();
+  CHECK(!doc.parseParallel(text.data(), text.size(), keepError, &err, 4) &&
+	err.find("15003")!=std::string::npos);
+  err.clear();
+  CHECK(!decodeJSONParallel(text.data(), text.size(), pointType, &points,
+			    keepError, &err, 4) && !err.empty());
+}
+
+static void testTape() {
+  JSON::Document whole;
+  JSON::Value *expect=whole.parse(sample);
+  JSON::Tape tape;
+  CHECK(tape.parse(sample, strlen(sample)));
+  JSON::Value *v=tape.root().toValue();
+  CHECK(equal(v, expect));
+  delete v;
+  JSON::Arena arena;
+  CHECK(equal(tape.root().toValue(&arena), expect));
+
+  JSON::Tape::Cursor root=tape.root(), c;
+  CHECK(root.getType()==JSON::Value::object);
+  c=root.child();
+  CHECK(c.valid() && c.key()==JSON::Str("name") &&
+	c.getString()==JSON::Str("cafA \"quoted\""));
+  // next steps over a whole container
+  c=c.next();
+  CHECK(c.key()==JSON::Str("values") && c.getType()==JSON::Value::array);
+  c=c.next();
+  CHECK(c.key()==JSON::Str("nested") && c.lineno()==3);
+  c=c.next();
+  CHECK(c.key()==JSON::Str("last") && c.getNumber()==-0.000123 && !c.next().valid());
+
+  c=root.find("values").child();
+  long long l;
+  CHECK(c.isInteger() && c.getInt64(&l) && l==1);
+  c=c.next();
+  CHECK(!c.isInteger() && c.getNumber()==-2.5e-3);
+  c=c.next();
+  CHECK(c.isInteger() && !c.getInt64(&l) && c.getNumber()==12345678901234567890.0);
+  c=c.next();
+  CHECK(c.getType()==JSON::Value::boolean && c.getBoolean());
+  c=c.next().next();
+  CHECK(c.getType()==JSON::Value::null && !c.next().valid());
+  c=root.find("nested").find("list").child();
+  CHECK(c.getType()==JSON::Value::array && !c.child().valid());
+  c=c.next().child();
+  CHECK(c.getType()==JSON::Value::object && !c.child().valid() && !c.next().valid());
+  CHECK(!root.find("missing").valid());
+
+  std::string err;
+  CHECK(!tape.parse("{\"a\": [1, 2}", keepError, &err) && !err.empty());
+  CHECK(tape.parse("\"just a string\"") &&
+	tape.root().getString()==JSON::Str("just a string"));
+}
+
+static void testLazy() {
+  JSON::Document whole;
+  JSON::Value *expect=whole.parse(sample);
+  JSON::LazyDocument doc;
+  JSON::LazyValue *root=doc.parse(sample, strlen(sample));
+  CHECK(root && root->getType()==JSON::Value::object && !root->expanded);
+  CHECK(root->size()==4 && root->expanded);
+  JSON::LazyValue *nested=root->find("nested");
+  CHECK(nested && !nested->expanded && nested->lineno==3);
+  CHECK(root->key(1)==JSON::Str("values"));
+  CHECK(root->key(1).data()[6]==0);
+  JSON::LazyValue *list=nested->find("list");
+  CHECK(list && list->size()==2 && list->at(0)->size()==0 && list->at(1)->size()==1);
+  CHECK(list->at(1)->at(0)->getType()==JSON::Value::object);
+  JSON::LazyValue *values=root->find("values");
+  CHECK(!values->expanded && equal(values->value(), member(expect, "values")));
+  CHECK(values->at(0)->value() && isNumber(values->at(0)->value(), 1));
+  CHECK(equal(root->value(), expect));
+  CHECK(!root->find("missing"));
+
+  // The last of a repeated key wins. An error shows when its container
+  // is opened, also that of the root
+  const char text[]="{\"a\": 1, \"b\": [1, 2}, \"a\": [3]}";
+  std::string err;
+  root=doc.parse(text, strlen(text), keepError, &err);
+  CHECK(root && err.empty() && root->size()==3);
+  CHECK(root->find("a")==root->at(2));
+  CHECK(root->find("b")->size()==0 && !err.empty());
+  CHECK(root->find("b")->value()==NULL);
+  err.clear();
+  CHECK(doc.parse("[1, 2", 5, keepError, &err) && doc.root->size()==0 && !err.empty());
+  err.clear();
+  CHECK(!doc.parse("tru", 3, keepError, &err) && !err.empty());
+}
+
+// Collects what a Query matches, as path number and value
+struct Matches {
+  std::vector<int> paths;
+  std::vector<std::string> texts;
+  int limit;
+};
+
+static bool collect(void *data, int path, JSON::Value *value) {
+  Matches *m=(Matches *)data;
+  std::string text;
+  m->paths.push_back(path);
+  if (value->getType()==JSON::Value::number) {
+    char buf[32];
+    sprintf(buf, "%g", ((JSON::Number *)value)->value);
+    text=buf;
+  } else if (value->getType()==JSON::Value::string) {
+    text=((JSON::String *)value)->value;
+  } else {
+    text=value->getType()==JSON::Value::object ? "object" : "other";
+  }
+  m->texts.push_back(text);
+  return --m->limit!=0;
+}
+
+static void testQuery() {
+  const char text[]="{\"events\": [{\"user\": {\"id\": 7}, \"skip\": [1, {\"id\": 0}]},\n"
+    "  {\"user\": {\"id\": 8, \"name\": \"b\"}}, {\"other\": 1},\n"
+    "  {\"user\": {\"id\": \"nine\"}}], \"0\": \"key zero\", \"a/b\": 3}";
+  JSON::Query q;
+  CHECK(q.add("$.events[*].user.id")==0);
+  CHECK(q.add("/events/1/user")==1);
+  CHECK(q.add("$['events'][0].skip[1]")==2);
+  CHECK(q.add("/0")==3);
+  CHECK(q.add("/a~1b")==4);
+  CHECK(q.add("$.events[")<0);
+  Matches m;
+  m.limit=-1;
+  CHECK(q.run(text, strlen(text), collect, &m));
+  CHECK(m.paths.size()==7);
+  if (m.paths.size()==7) {
+    CHECK(m.paths[0]==0 && m.texts[0]=="7");
+    CHECK(m.paths[1]==2 && m.texts[1]=="object");
+    CHECK(m.paths[2]==1 && m.texts[2]=="object");
+    CHECK(m.paths[3]==0 && m.texts[3]=="8");
+    CHECK(m.paths[4]==0 && m.texts[4]=="nine");
+    CHECK(m.paths[5]==3 && m.texts[5]=="key zero");
+    CHECK(m.paths[6]==4 && m.texts[6]=="3");
+  }
+
+  // Stopping, and errors
+  Matches first;
+  first.limit=1;
+  CHECK(!q.run(text, strlen(text), collect, &first) && first.paths.size()==1);
+  std::string err;
+  Matches none;
+  none.limit=-1;
+  CHECK(!q.run("{\"events\": [", 12, collect, &none, keepError, &err) && !err.empty());
+
+  // Many large matches, one at a time in the arena
+  std::string big="[";
+  int i;
+  for (i=0; i<2000; i++)
+    big+=std::string(i ? "," : "")+"{\"v\": [\""+std::string(1000, 'x')+"\"]}";
+  big+="]";
+  JSON::Query all;
+  all.add("$[*].v");
+  Matches many;
+  many.limit=-1;
+  CHECK(all.run(big.data(), big.size(), collect, &many) && many.paths.size()==2000);
+}
+
+static void testEncoder() {
+  Point p;
+  p.x=2.5;
+  p.label="a label";
+  p.weights.push_back(1);
+  p.weights.push_back(-0.5);
+  p.visible=true;
+  p.tags["k"]=3;
+  const char expect[]="{\"x\":2.5,\"label\":\"a label\",\"weights\":[1,-0.5],"
+    "\"visible\":true,\"tags\":{\"k\":3}}";
+  CHECK(encodeJSON(pointType, &p)==expect);
+
+  // Appending to a string, and to a Writer of its own
+  std::string out="prefix ";
+  encodeJSON(pointType, &p, &out);
+  CHECK(out==std::string("prefix ")+expect);
+  Writer w;
+  encodeJSON(pointType, &p, w);
+  w.clear();
+  encodeJSON(pointType, &p, w);
+  CHECK(std::string(w.data(), w.length())==expect);
+
+  // A fixed buffer, truncated as by snprintf
+  char buf[100];
+  size_t len=strlen(expect);
+  CHECK(encodeJSON(pointType, &p, buf, sizeof(buf))==len && !strcmp(buf, expect));
+  CHECK(encodeJSON(pointType, &p, buf, 11)==len && !strcmp(buf, "{\"x\":2.5,\""));
+  CHECK(encodeJSON(pointType, &p, buf, 0)==len);
+
+  // Decoding what was encoded gives the object back
+  vector<Point> points(3, p);
+  points[1].label="";
+  points[1].weights.clear();
+  points[2].tags.clear();
+  vector<Point> back;
+  CHECK(decodeJSON(encodeJSON(pointArray, &points), pointArray, &back));
+  bool same=back.size()==3;
+  size_t i;
+  for (i=0; i<back.size() && same; i++)
+    same=back[i].x==points[i].x && back[i].label==points[i].label &&
+      back[i].weights==points[i].weights && back[i].visible==points[i].visible &&
+      back[i].tags==points[i].tags;
+  CHECK(same);
+}
+
+static bool formatsAs(double d, const char *text) {
+  char buf[32];
+  int n=JSON::formatNumber(buf, d);
+  return n==(int)strlen(text) && !strcmp(buf, text);
+}
+
+// The number of significant digits in a formatted number
+static int digitsOf(const char *s) {
+  int n=0, zeros=0;
+  for (; *s && *s!='e'; s++)
+    if (*s=='0' && !n)
+      continue;
+    else if (*s=='0')
+      zeros++;
+    else if (*s>'0' && *s<='9') {
+      n+=zeros+1;
+      zeros=0;
+    }
+  return n;
+}
+
+static void testFormat() {
+  CHECK(formatsAs(100, "100"));
+  CHECK(formatsAs(0.001, "0.001"));
+  CHECK(formatsAs(0.000001, "0.000001"));
+  CHECK(formatsAs(1e-7, "1e-7"));
+  CHECK(formatsAs(1e20, "100000000000000000000"));
+  CHECK(formatsAs(1e21, "1e+21"));
+  CHECK(formatsAs(1.5e21, "1.5e+21"));
+  CHECK(formatsAs(0.1, "0.1"));
+  CHECK(formatsAs(-123.456, "-123.456"));
+  CHECK(formatsAs(1.2345678901234568e20, "123456789012345680000"));
+  CHECK(formatsAs(5e-324, "5e-324"));
+  CHECK(formatsAs(1.7976931348623157e308, "1.7976931348623157e+308"));
+  double zero=0;
+  CHECK(formatsAs(zero/zero, "null") && formatsAs(1/zero, "null"));
+
+  // Random doubles read back the same, and no fewer digits would do
+  unsigned long long state=2;
+  char buf[32], shorter[40];
+  int i;
+  bool roundtrip=true, shortest=true;
+  for (i=0; i<100000; i++) {
+    double d;
+    unsigned long long bits=nextRandom(&state)<<11 ^ nextRandom(&state);
+    if (i%2)
+      d=(double)(nextRandom(&state)%1000000)/1000;
+    else
+      memcpy(&d, &bits, sizeof(d));
+    if (d!=d || d-d!=0)
+      continue;
+    JSON::formatNumber(buf, d);
+    roundtrip=roundtrip && strtod(buf, NULL)==d && parsesAs(buf, d);
+    int digits=digitsOf(buf);
+    if (digits>1) {
+      sprintf(shorter, "%.*e", digits-2, d);
+      shortest=shortest && strtod(shorter, NULL)!=d;
+    }
+  }
+  CHECK(roundtrip);
+  CHECK(shortest);
+}
+
+static std::string written(const std::string &s) {
+  Writer w;
+  w.writeString(s);
+  return std::string(w.data(), w.length());
+}
+
+static void testEscaping() {
+  // findEscape at every offset and length, against a plain loop
+  char buf[200];
+  size_t i, j, k;
+  for (i=0; i<sizeof(buf); i++)
+    buf[i]='a'+i%26;
+  bool same=true;
+  const char special[]={'"', '\\', '\n', 0x1f, 0};
+  for (k=0; k<sizeof(special); k++)
+    for (i=0; i<130; i++) {
+      char c=buf[i];
+      buf[i]=special[k];
+      for (j=0; j<=i; j++) {
+        same=same && JSON::findEscape(buf+j, buf+150)==buf+i;
+        same=same && JSON::findEscape(buf+j, buf+i)==buf+i;
+      }
+      same=same && JSON::findEscape(buf+i+1, buf+150)==buf+150;
+      buf[i]=c;
+    }
+  CHECK(same);
+
+  CHECK(written("plain")=="\"plain\"");
+  CHECK(written("a\"b\\c/d")=="\"a\\\"b\\\\c/d\"");
+  CHECK(written("\b\f\n\r\t")=="\"\\b\\f\\n\\r\\t\"");
+  CHECK(written(std::string("\0\x01\x1f", 3))=="\"\\u0000\\u0001\\u001f\"");
+  CHECK(written("caf\xc3\xa9 \x7f")=="\"caf\xc3\xa9 \x7f\"");
+
+  // Every byte, at every place in strings longer than a vector, reads
+  // back as it was
+  int c;
+  same=true;
+  for (c=0; c<256; c++)
+    for (i=0; i<100; i+=3) {
+      std::string s(100, 'x');
+      s[i]=(char)c;
+      s[99-i/2]=(char)c;
+      std::string text=written(s);
+      JSON::Value *v=JSON::decodeJSON(text.data(), text.size());
+      same=same && v && v->getType()==JSON::Value::string &&
+	((JSON::String *)v)->value==JSON::Str(s);
+      delete v;
+    }
+  CHECK(same);
+
+  // Keys are escaped too
+  map<string, double> m;
+  m["a\"b"]=1;
+  m["\n"]=2;
+  CHECK(encodeJSON(NumberMap, &m)=="{\"\\n\":2,\"a\\\"b\":1}");
+  map<string, double> back;
+  CHECK(decodeJSON(encodeJSON(NumberMap, &m), NumberMap, &back) && back==m);
+}
+
+static bool sameOuter(const Outer &a, const Outer &b) {
+  bool same=a.number==b.number && a.text==b.text && a.flag==b.flag &&
+    a.inner.v==b.inner.v && a.inner.s==b.inner.s && a.list.size()==b.list.size() &&
+    a.table==b.table && a.bits==b.bits && a.words==b.words;
+  size_t i;
+  for (i=0; same && i<a.list.size(); i++)
+    same=a.list[i].v==b.list[i].v && a.list[i].s==b.list[i].s;
+  return same;
+}
+
+static void testDescribed() {
+  const char text[]="{\"number\": 1.25, \"text\": \"t\", \"ignored\": [1, {\"a\": 2}],\n"
+    " \"flag\": true, \"inner\": {\"s\": \"in\", \"v\": -1},\n"
+    " \"list\": [{\"v\": 1}, {\"s\": \"two\", \"v\": 2}], \"table\": {\"a\": 1, \"b\": 2},\n"
+    " \"bits\": [true, false, true], \"words\": [\"x\", \"y\"]}";
+  Outer o;
+  CHECK(decodeJSON(text, strlen(text), &o));
+  CHECK(o.number==1.25 && o.text=="t" && o.flag && o.inner.v==-1 && o.inner.s=="in");
+  CHECK(o.list.size()==2 && o.list[1].s=="two" && o.list[1].v==2);
+  CHECK(o.table.size()==2 && o.table["b"]==2);
+  CHECK(o.bits.size()==3 && o.bits[0] && !o.bits[1] && o.words[1]=="y");
+
+  // The text encoded reads back as the same object
+  std::string encoded=encodeJSON(o);
+  CHECK(encoded=="{\"number\":1.25,\"text\":\"t\",\"flag\":true,\"inner\":{\"v\":-1,\"s\":\"in\"},"
+	"\"list\":[{\"v\":1,\"s\":\"\"},{\"v\":2,\"s\":\"two\"}],\"table\":{\"a\":1,\"b\":2},"
+	"\"bits\":[true,false,true],\"words\":[\"x\",\"y\"]}");
+  Outer back;
+  CHECK(decodeJSON(encoded, &back) && sameOuter(o, back));
+
+  // Through a Type, from text and from a tree
+  Described<Outer> type;
+  Outer viaType, viaTree;
+  CHECK(decodeJSON(text, strlen(text), &type, &viaType) && sameOuter(o, viaType));
+  JSON::Document doc;
+  CHECK(convertJSON(doc.parse(text), &type, &viaTree, NULL, NULL) && sameOuter(o, viaTree));
+  vector<Outer> many;
+  CHECK(decodeJSON("[" + encoded + "," + encoded + "]", &many) && many.size()==2 &&
+	sameOuter(many[1], o));
+
+  // Type errors, from text and from a tree
+  std::string err;
+  const char bad[]="{\"inner\": {\"v\": \"not a number\"}}";
+  CHECK(!decodeJSON(bad, strlen(bad), &back, keepError, &err) && !err.empty());
+  err.clear();
+  CHECK(!convertJSON(doc.parse(bad), &type, &back, keepError, &err) && !err.empty());
+}
+
+static void testMemberIndex() {
+  std::vector<std::string> names;
+  char buf[64];
+  int i;
+  for (i=0; i<200; i++) {
+    sprintf(buf, "member_with_a_long_common_prefix_%d", i);
+    names.push_back(buf);
+    names.push_back(buf+1+i%30);
+  }
+  names.push_back("");
+  names.push_back("x");
+  names.push_back("member_with_a_long_common_prefix_7");
+  MemberIndex index;
+  CHECK(!index.ready());
+  index.build(names);
+  CHECK(index.ready());
+  bool found=true;
+  for (i=0; i<(int)names.size()-1; i++)
+    found=found && index.find(names[i])==i;
+  CHECK(found);
+  // The first of a repeated name wins
+  CHECK(index.find(names.back())==14);
+  CHECK(index.find("y")<0 && index.find("member_with_a_long_common_prefix_")<0 &&
+	index.find("member_with_a_long_common_prefix_2000")<0);
+  CHECK(index.find(JSON::Str("xx", 1))==(int)names.size()-2);
+
+  const char *few[]={"b", "a"};
+  MemberIndex small;
+  small.build(few, 2);
+  CHECK(small.find("a")==1 && small.find("b")==0 && small.find("c")<0);
+}
+
+static void testNumberArrays() {
+  // Longer than a block of the readers, with comments and lines between
+  std::string text="[";
+  std::vector<double> expect;
+  char buf[64];
+  int i;
+  for (i=0; i<1000; i++) {
+    double d=i%3 ? i*0.5 : -i;
+    sprintf(buf, "%s%.17g%s", i ? "," : "", d, i%100 ? "" : " /* c */\n");
+    text+=buf;
+    expect.push_back(d);
+  }
+  text+="]";
+  vector<double> direct, converted;
+  CHECK(decodeJSON(text, NumberArray, &direct) && direct==expect);
+  JSON::Document doc;
+  CHECK(convertJSON(doc.parse(text), NumberArray, &converted, NULL, NULL) &&
+	converted==expect);
+  CHECK(decodeJSON(std::string("[]"), NumberArray, &direct) && direct.empty());
+
+  // The reader a few at a time, and stopping at what is not a number
+  JSON::Reader r(text.data(), text.size());
+  double some[7];
+  size_t n, total=0;
+  bool more=true, same=true;
+  CHECK(r.startArray());
+  while (more && same) {
+    same=r.readNumbers(some, 7, &n, &more);
+    for (i=0; i<(int)n; i++)
+      same=same && some[i]==expect[total+i];
+    total+=n;
+  }
+  CHECK(same && total==1000);
+  const char mixed[]="[1, 2, \"three\", 4]";
+  JSON::Reader m(mixed, strlen(mixed));
+  std::vector<double> got;
+  JSON::Str str;
+  CHECK(m.startArray() && m.readNumbers(&got, &more) && more && got.size()==2);
+  CHECK(m.readString(&str) && str==JSON::Str("three"));
+  CHECK(m.readNumbers(&got, &more) && !more && got.size()==3 && got[2]==4);
+  std::string err;
+  CHECK(!decodeJSON(mixed, strlen(mixed), NumberArray, &direct, keepError, &err) &&
+	!err.empty());
+
+  // Other number types, and fixed sizes
+  const char numeric[]="{\"doubles\": [0.1, 2], \"floats\": [0.1, 1e3], "
+    "\"ints\": [-5, 2147483647], \"fixed\": [1, 2, 3], \"pair\": [7, 8], "
+    "\"array\": [0.5, 1.5]}";
+  Numeric v;
+  CHECK(decodeJSON(numeric, strlen(numeric), &v));
+  CHECK(v.doubles.size()==2 && v.doubles[0]==0.1);
+  CHECK(v.floats.size()==2 && v.floats[0]==0.1f && v.floats[1]==1000);
+  CHECK(v.ints.size()==2 && v.ints[0]==-5 && v.ints[1]==2147483647);
+  CHECK(v.fixed[2]==3 && v.pair[0]==7 && v.pair[1]==8);
+#if __cplusplus>=201103L
+  CHECK(v.array[1]==1.5f);
+#endif
+  Numeric back;
+  CHECK(decodeJSON(encodeJSON(v), &back) && back.floats==v.floats && back.ints==v.ints &&
+	back.fixed[0]==1 && back.pair[1]==8);
+  const char *bad[]={
+    "{\"ints\": [1.5]}",
+    "{\"ints\": [2147483648]}",
+    "{\"fixed\": [1, 2]}",
+    "{\"fixed\": [1, 2, 3, 4]}",
+    "{\"pair\": [1, \"2\"]}"
+  };
+  bool rejected=true;
+  for (i=0; i<(int)(sizeof(bad)/sizeof(*bad)); i++) {
+    err.clear();
+    rejected=rejected && !decodeJSON(bad[i], strlen(bad[i]), &back, keepError, &err) &&
+      !err.empty();
+  }
+  CHECK(rejected);
+
+  // Into a buffer of the caller's
+  int ints[4];
+  float floats[2];
+  CHECK(decodeNumbers("[3, 1, 2]", 9, ints, 4, &n) && n==3 && ints[2]==2);
+  CHECK(!decodeNumbers("[3, 1, 2]", 9, floats, 2, &n, keepError, &err));
+  CHECK(decodeNumbers("[]", 2, floats, 2, &n) && n==0);
+}
+
+static std::string packed(double d) {
+  Writer w;
+  packNumber(w, d);
+  return std::string(w.data(), w.length());
+}
+
+static void testMsgPack() {
+  // Numbers in the smallest form that holds them exactly
+  CHECK(packed(1)==std::string("\x01", 1));
+  CHECK(packed(0)==std::string("\x00", 1));
+  CHECK(packed(-1)=="\xff");
+  CHECK(packed(-33)=="\xd0\xdf");
+  CHECK(packed(200)=="\xcc\xc8");
+  CHECK(packed(65536)==std::string("\xce\x00\x01\x00\x00", 5));
+  CHECK(packed(-0x80000001LL)==std::string("\xd3\xff\xff\xff\xff\x7f\xff\xff\xff", 9));
+  CHECK(packed(1.5)==std::string("\xca\x3f\xc0\x00\x00", 5));
+  CHECK(packed(0.1)=="\xcb\x3f\xb9\x99\x99\x99\x99\x99\x9a");
+  CHECK(packed(-0.0)==std::string("\xca\x80\x00\x00\x00", 5));
+
+  // Random numbers come back the same
+  unsigned long long state=3;
+  int i;
+  bool same=true;
+  for (i=0; i<100000 && same; i++) {
+    double d, back;
+    unsigned long long bits=nextRandom(&state)<<11 ^ nextRandom(&state);
+    if (i%3==0)
+      d=(double)(long long)bits/(double)(1ULL<<(i%40));
+    else if (i%3==1)
+      d=(float)(nextRandom(&state)%100000)/7;
+    else
+      memcpy(&d, &bits, sizeof(d));
+    if (d!=d)
+      continue;
+    std::string s=packed(d);
+    Unpacker u(s.data(), s.size());
+    same=u.readNumber(&back) && back==d && signbit(back)==signbit(d) &&
+      u.offset()==s.size();
+  }
+  CHECK(same);
+
+  // Objects, with the same Types as for JSON
+  const char text[]="[{\"x\": 1.5, \"label\": \"a\", \"weights\": [1, 0.1, -300], "
+    "\"visible\": true, \"tags\": {\"t\": 65536}}, {\"x\": -1e300, \"label\": \"\", "
+    "\"weights\": [], \"visible\": false, \"tags\": {}}]";
+  vector<Point> points, back;
+  CHECK(decodeJSON(text, strlen(text), pointArray, &points));
+  std::string data=encodeMsgPack(pointArray, &points);
+  CHECK(decodeMsgPack(data.data(), data.size(), pointArray, &back));
+  CHECK(encodeJSON(pointArray, &back)==encodeJSON(pointArray, &points));
+  CHECK(data.size()<strlen(text));
+
+  // Described classes, with their members in another order
+  const char outer[]="{\"number\": 3, \"text\": \"t\", \"flag\": true, "
+    "\"inner\": {\"v\": 2, \"s\": \"in\"}, \"list\": [{\"v\": 1, \"s\": \"\"}], "
+    "\"table\": {\"k\": 0.5}, \"bits\": [false, true], \"words\": [\"w\"]}";
+  Outer o, ob;
+  CHECK(decodeJSON(outer, strlen(outer), &o));
+  data=encodeMsgPack(o);
+  CHECK(decodeMsgPack(data.data(), data.size(), &ob) && sameOuter(o, ob));
+  Writer w;
+  packMap(w, 3);
+  packString(w, "unknown");
+  packArray(w, 2);
+  packNumber(w, 1);
+  packBoolean(w, true);
+  packString(w, "text");
+  packString(w, "reordered");
+  packString(w, "number");
+  packNumber(w, 4);
+  CHECK(decodeMsgPack(w.data(), w.length(), &ob) && ob.text=="reordered" && ob.number==4);
+  Numeric n, nb;
+  const char numeric[]="{\"doubles\": [0.1], \"floats\": [0.25], \"ints\": [-7], "
+    "\"fixed\": [1, 2, 3], \"pair\": [4, 5], \"array\": [6, 7]}";
+  CHECK(decodeJSON(numeric, strlen(numeric), &n));
+  data=encodeMsgPack(n);
+  CHECK(decodeMsgPack(data.data(), data.size(), &nb) && encodeJSON(nb)==encodeJSON(n));
+
+  // Data that is cut short, or of the wrong type
+  std::string err;
+  bool rejected=true;
+  data=encodeMsgPack(o);
+  size_t k;
+  for (k=0; k<data.size(); k++) {
+    err.clear();
+    rejected=rejected && !decodeMsgPack(data.data(), k, &ob, keepError, &err) &&
+      !err.empty();
+  }
+  CHECK(rejected);
+  data=encodeMsgPack(pointArray, &points);
+  CHECK(!decodeMsgPack(data.data(), data.size(), &ob, keepError, &err));
+}
+
+static bool sampleCounts(const JSON::Stats &s, int times) {
+  return s.bytes==times*strlen(sample) &&
+    s.nodes[JSON::Value::object]==times*4u && s.nodes[JSON::Value::array]==times*4u &&
+    s.nodes[JSON::Value::string]==times*1u && s.nodes[JSON::Value::number]==times*4u &&
+    s.nodes[JSON::Value::boolean]==times*2u && s.nodes[JSON::Value::null]==times*1u &&
+    s.strings==times*7u && s.stringBytes==times*42u && s.escapes==times*3u &&
+    s.comments==times*2u && s.maxDepth==5;
+}
+
+static void testStats() {
+  JSON::Stats stats;
+  JSON::Value *v=JSON::decodeJSON(sample, strlen(sample), NULL, NULL, &stats);
+  CHECK(v!=NULL);
+  delete v;
+  JSON::Document doc;
+  CHECK(doc.parse(sample, strlen(sample), NULL, NULL, &stats));
+  if (!JSON::Stats::enabled) {
+    // Nothing is counted
+    JSON::Stats zero;
+    CHECK(!memcmp(&stats, &zero, sizeof(stats)));
+    return;
+  }
+  CHECK(sampleCounts(stats, 2));
+  CHECK(stats.allocations>=16 && stats.allocatedBytes>=16*sizeof(JSON::Null));
+  CHECK(stats.parseTime>0 && stats.freeTime==0);
+
+  // Freeing a large tree takes time, with a Document or on the heap
+  std::string big="[";
+  int i;
+  for (i=0; i<100000; i++)
+    big+=i ? ", {\"a\": [1, \"x\"]}" : "{\"a\": [1, \"x\"]}";
+  big+="]";
+  CHECK(doc.parse(big));
+  doc.clear(&stats);
+  CHECK(stats.freeTime>0 && doc.root==NULL);
+  stats.clear();
+  v=JSON::decodeJSON(big);
+  CHECK(v!=NULL);
+  JSON::release(v, &stats);
+  CHECK(stats.freeTime>0 && stats.parseTime==0);
+
+  // The reader counts the same, with nothing allocated
+  stats.clear();
+  {
+    JSON::Reader r(sample, strlen(sample), NULL, NULL, 1, &stats);
+    CHECK(r.skip());
+  }
+  CHECK(sampleCounts(stats, 1) && stats.allocations==0);
+
+  stats.clear();
+  Point p;
+  const char text[]="{\"x\": 1, \"label\": \"l\", \"other\": [true]}";
+  CHECK(decodeJSON(text, strlen(text), pointType, &p, NULL, NULL, &stats));
+  CHECK(stats.bytes==strlen(text) && stats.nodes[JSON::Value::number]==1 &&
+	stats.nodes[JSON::Value::boolean]==1 && stats.convertTime>0);
+}
+
+static void testCustomType() {
+  // A type with only fill is read through a tree of each value
+  const char text[]="{\"name\": \"sky\", \"color\": \"87ceeb\",\n"
+    "\"shades\": [\"000080\", \"4169e1\"]}";
+  Swatch s;
+  CHECK(decodeJSON(std::string(text), swatchType, &s));
+  CHECK(s.name=="sky" && s.color==0x87ceeb && s.shades.size()==2 &&
+	s.shades[0]==0x80 && s.shades[1]==0x4169e1);
+  Swatch t;
+  JSON::Document doc;
+  CHECK(convertJSON(doc.parse(text), swatchType, &t, NULL, NULL));
+  CHECK(t.name==s.name && t.color==s.color && t.shades==s.shades);
+  std::string err;
+  CHECK(!decodeJSON(std::string("{\"name\": \"x\",\n\"shades\": [\"12\", \"zz\"]}"),
+		    swatchType, &t, keepError, &err));
+  CHECK(err.find('2')!=std::string::npos);
+  err.clear();
+  CHECK(!decodeJSON(std::string("{\"color\": \"12\" \"x\"}"), swatchType, &t,
+		    keepError, &err));
+  CHECK(err.find("Syntax")!=std::string::npos);
+
+  // Reader::readValue builds what a tree would, on the same lines
+  const char values[]="[1, {\"a\": [true, null],\n \"b\": \"c\"}, , \"x\"]";
+  JSON::Document expect;
+  JSON::Value *v=expect.parse(values);
+  JSON::Reader r(values, strlen(values));
+  JSON::Arena arena;
+  bool more;
+  size_t i;
+  CHECK(r.startArray());
+  for (i=0; r.nextElement(&more) && more; i++)
+    CHECK(equal(r.readValue(&arena), element(v, i)));
+  CHECK(i==4 && !more);
+
+  // And it is encoded through its string, also in a Writer
+  const char encoded[]="{\"name\":\"sky\",\"color\":\"87ceeb\","
+    "\"shades\":[\"000080\",\"4169e1\"]}";
+  CHECK(encodeJSON(swatchType, &s)==encoded);
+  char buf[16];
+  CHECK(encodeJSON(swatchType, &s, buf, sizeof(buf))==strlen(encoded) &&
+	!strcmp(buf, "{\"name\":\"sky\",\""));
+
+  // It cannot be unpacked, which is a type error at its offset
+  const char packedSwatch[]="\x81\xa5" "color\xa6" "87ceeb";
+  err.clear();
+  CHECK(!decodeMsgPack(packedSwatch, sizeof(packedSwatch)-1, swatchType, &t,
+		       keepError, &err));
+  CHECK(err.find("offset 7")!=std::string::npos);
+}
+
+int main() {
+  testDocument();
+  testBuffer();
+  testInSitu();
+  testMembers();
+  testScanning();
+  testNumbers();
+  testPushParser();
+  testHandler();
+  testSchema();
+  testFile();
+  testLines();
+  testParallel();
+  testTape();
+  testLazy();
+  testQuery();
+  testEncoder();
+  testFormat();
+  testEscaping();
+  testDescribed();
+  testMemberIndex();
+  testNumberArrays();
+  testMsgPack();
+  testStats();
+  testCustomType();
+  printf("%d checks, %d failed\n", checks, failures);
+  return failures ? 1 : 0;
+}